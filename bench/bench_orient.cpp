@@ -0,0 +1,166 @@
+// bench_orient.cpp - exif::apply_orientation gegen den alten per-pixel loop
+// prüft erst dass alle orientierungen byte-identisch sind, dann zeiten
+// bauen: cmake -DSQUISH_BUILD_BENCH=ON, dann ./bench_orient [megapixel]
+
+#include "exif_orient.hpp"
+#include "buffer_pool.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+using namespace imgview;
+
+namespace {
+
+// die formeln vom alten switch in apply_orientation, ziel pixel pro quell pixel.
+// absichtlich nix aus exif::detail, sonst prüft sich der code gegen sich selbst
+void orient_reference(ConstView src, View dst, int orientation) {
+    const int width = src.width;
+    const int height = src.height;
+    const int channels = src.channels;
+
+    if (orientation < 2 || orientation > 8) {
+        copy(src, dst);
+        return;
+    }
+    for (int y = 0; y < height; y++) {
+        const uint8_t* in = src.row(y);
+        for (int x = 0; x < width; x++) {
+            int nx = x, ny = y;
+            switch (orientation) {
+                case 2: nx = width - 1 - x; ny = y; break;                // flip horizontal
+                case 3: nx = width - 1 - x; ny = height - 1 - y; break;   // rotate 180
+                case 4: nx = x; ny = height - 1 - y; break;               // flip vertical
+                case 5: nx = y; ny = x; break;                            // transpose
+                case 6: nx = height - 1 - y; ny = x; break;               // rotate 90 cw
+                case 7: nx = height - 1 - y; ny = width - 1 - x; break;   // transverse
+                case 8: nx = y; ny = width - 1 - x; break;                // rotate 270 cw
+            }
+            uint8_t* out = dst.row(ny) + static_cast<ptrdiff_t>(nx) * channels;
+            for (int c = 0; c < channels; c++) out[c] = in[c];
+            in += channels;
+        }
+    }
+}
+
+struct Image {
+    bufpool::Buffer storage;
+    View view;
+};
+
+Image make_image(int w, int h, int channels) {
+    Image img;
+    ptrdiff_t stride = static_cast<ptrdiff_t>(aligned_stride(static_cast<size_t>(w) * channels));
+    img.storage = bufpool::Buffer(static_cast<size_t>(stride) * h);
+    img.view = {img.storage.data(), w, h, channels, stride, 0, Layout::Interleaved};
+    return img;
+}
+
+Image rotated_for(const Image& src, int orientation) {
+    bool swap = exif::swaps_dimensions(orientation);
+    return make_image(swap ? src.view.height : src.view.width,
+                      swap ? src.view.width : src.view.height, src.view.channels);
+}
+
+bool same_pixels(ConstView a, ConstView b) {
+    if (a.width != b.width || a.height != b.height) return false;
+    for (int y = 0; y < a.height; y++) {
+        if (std::memcmp(a.row(y), b.row(y), a.row_bytes()) != 0) return false;
+    }
+    return true;
+}
+
+void fill_random(View v, std::mt19937& rng) {
+    for (int y = 0; y < v.height; y++) {
+        uint8_t* row = v.row(y);
+        for (size_t i = 0; i < v.row_bytes(); i++) row[i] = static_cast<uint8_t>(rng());
+    }
+}
+
+// krumme größen damit die ränder neben den simd blöcken mitgetestet werden
+bool check_correctness() {
+    std::mt19937 rng(42);
+    const int sizes[][2] = {{1, 1}, {3, 7}, {5, 5}, {37, 23}, {64, 64}, {129, 65}, {333, 71}};
+    bool ok = true;
+    for (int channels = 1; channels <= 4; channels++) {
+        for (auto& s : sizes) {
+            Image src = make_image(s[0], s[1], channels);
+            fill_random(src.view, rng);
+            for (int o = 1; o <= 8; o++) {
+                Image a = rotated_for(src, o);
+                Image b = rotated_for(src, o);
+                exif::apply_orientation(src.view, a.view, o);
+                orient_reference(src.view, b.view, o);
+                if (!same_pixels(a.view, b.view)) {
+                    std::printf("MISMATCH: %dx%d ch=%d orientation=%d\n", s[0], s[1], channels, o);
+                    ok = false;
+                }
+            }
+            // gepackte quelle ohne padding (stbi output), 16 byte loads dürfen nicht drüber lesen
+            bufpool::Buffer packed(static_cast<size_t>(s[0]) * s[1] * channels);
+            View pv = packed_view(packed.data(), s[0], s[1], channels);
+            copy(src.view, pv);
+            for (int o = 2; o <= 8; o++) {
+                Image a = rotated_for(src, o);
+                Image b = rotated_for(src, o);
+                exif::apply_orientation(pv, a.view, o);
+                orient_reference(src.view, b.view, o);
+                if (!same_pixels(a.view, b.view)) {
+                    std::printf("MISMATCH (packed): %dx%d ch=%d orientation=%d\n", s[0], s[1], channels, o);
+                    ok = false;
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+template<typename F>
+double best_ms(int reps, F&& fn) {
+    double best = 1e30;
+    for (int i = 0; i < reps; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        auto t1 = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        if (ms < best) best = ms;
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double megapixels = argc > 1 ? std::atof(argv[1]) : 12.0;
+    if (megapixels <= 0) megapixels = 12.0;
+
+    if (!check_correctness()) {
+        std::printf("correctness check FAILED\n");
+        return 1;
+    }
+    std::printf("correctness: all orientations identical to reference\n\n");
+
+    // 4:3 wie eine handykamera
+    int w = static_cast<int>(std::sqrt(megapixels * 1e6 * 4.0 / 3.0));
+    int h = static_cast<int>(megapixels * 1e6 / w);
+    std::mt19937 rng(1);
+
+    std::printf("%dx%d (%.1f MP), best of 5\n", w, h, w * static_cast<double>(h) / 1e6);
+    std::printf("%-4s %-12s %12s %12s %8s\n", "ch", "orientation", "reference", "tiled", "speedup");
+    const char* names[] = {"", "normal", "flip-h", "rot180", "flip-v", "transpose", "rot90", "transverse", "rot270"};
+    for (int channels : {3, 4}) {
+        Image src = make_image(w, h, channels);
+        fill_random(src.view, rng);
+        for (int o : {2, 3, 6, 8}) {
+            Image dst = rotated_for(src, o);
+            double ref = best_ms(5, [&] { orient_reference(src.view, dst.view, o); });
+            double fast = best_ms(5, [&] { exif::apply_orientation(src.view, dst.view, o); });
+            std::printf("%-4d %-12s %9.1f ms %9.1f ms %7.2fx\n", channels, names[o], ref, fast, ref / fast);
+        }
+    }
+    return 0;
+}
@@ -2,20 +2,56 @@
 // cli parsing und so
 
 #include "image_processor.hpp"
+#include "dir_walker.hpp"
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <functional>
+#include <ostream>
 
 namespace squish {
 
 struct CLIConfig {
     std::vector<std::filesystem::path> input_paths;
+    std::filesystem::path files_from;  // --files-from: liste statt scannen, "-" = stdin
+    bool null_separated = false;       // -0: einträge der liste enden mit \0 statt \n
     std::filesystem::path output_dir;  // leer = "optimized" subfolder
     int quality = 80;                  // guter default
     int max_width = 0;                 // 0 = kein resize
     int max_height = 0;                // 0 = kein resize
     bool verbose = false;
     bool use_gpu = false;              // GPU acceleration
+    bool huge_pages = true;            // huge pages für große frame buffer
+    std::filesystem::path cost_log;    // csv mit geschätzten vs echten kosten pro file
+    int threads = 0;                   // 0 = ein worker pro physischem kern
+    bool pin = false;                  // worker auf kerne pinnen
+    bool adaptive = true;              // worker zahl zur laufzeit anpassen (aus bei --threads)
+    uint64_t max_memory = 0;           // speicherbudget in bytes, 0 = 3/4 vom freien beim start
+    int io_threads = 4;                // lese-/schreib threads der pipeline, 0 = worker machen io selber
+    bool io_uring = true;              // pipeline io über io_uring (linux), sonst mmap/rename einzeln
+    uint64_t prefetch = 64ull << 20;   // read-ahead budget in bytes, 0 = aus
+    bool hardlink = false;             // unveränderte originale hardlinken statt kopieren
+    bool fsync = false;                // outputs erst nach sync einhängen (group commit)
+    bool syncfs = false;               // dabei syncfs pro gruppe statt fdatasync pro file
+    bool direct_io = false;            // outputs mit O_DIRECT schreiben
+    InputOrder order = InputOrder::Stream;  // largest-first (schon beim scan) oder nach lage auf der platte
+};
+
+// ergebnisse werden beim fertigwerden hier aufsummiert, statt bis zum ende ein
+// ProcessingResult (zwei pfade + fehlertext) pro file zu halten
+struct RunTotals {
+    size_t images = 0;
+    size_t succeeded = 0;
+    size_t failed = 0;
+    uint64_t original_bytes = 0;    // nur erfolgreiche
+    uint64_t compressed_bytes = 0;
+    size_t kept[5] = {};            // pro atomicfile::CopyMethod
+    double job_ms = 0, read_ms = 0, decode_ms = 0, transform_ms = 0, encode_ms = 0;
+    double write_ms = 0, compute_ms = 0, cpu_ms = 0, runqueue_ms = 0;
+    // kostenmodell: summen für die korrelation geschätzt vs gemessen
+    double model_n = 0, model_x = 0, model_y = 0, model_xx = 0, model_yy = 0, model_xy = 0;
+
+    void add(const ProcessingResult& r);
 };
 
 class CLI {
@@ -26,10 +62,20 @@ public:
     static int run(const CLIConfig& config);
 
 private:
-    static std::vector<std::filesystem::path> collect_files(
-        const std::vector<std::filesystem::path>& paths
+    // argumente einteilen: verzeichnisse nach roots (scannt danach der walker),
+    // einzelne unterstützte files nach direct. warnt für den rest
+    static void collect_files(
+        const std::vector<std::filesystem::path>& paths,
+        std::vector<std::filesystem::path>& roots,
+        DirWalker::Batch& direct
     );
-    static void print_summary(const std::vector<ProcessingResult>& results, double total_time);
+    // --files-from: liste lesen und in schüben weitergeben, ohne scan und ohne stat.
+    // overrides[i] gehört zu batch[i]. false = liste nicht lesbar
+    using ListSink = std::function<void(DirWalker::Batch&& batch, std::vector<FileOverrides>&& overrides)>;
+    static bool read_file_list(const CLIConfig& config, const ListSink& found);
+    static void print_summary(const RunTotals& totals, double total_time);
+    static void print_cost_model(const RunTotals& totals);
+    static void write_cost_row(std::ostream& out, const ProcessingResult& r, const JobEstimate& e);
 };
 
 } // namespace squish
@@ -0,0 +1,55 @@
+#pragma once
+// passt die zahl aktiver worker zur laufzeit an (hill climbing auf den durchsatz)
+// ob wir an der platte (nfs, hdd) oder an der cpu hängen ändert sich von lauf zu lauf,
+// eine feste thread zahl ist also immer irgendwo falsch. die beste zahl wird pro
+// input ordner gemerkt und beim nächsten lauf als startwert genommen
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <map>
+
+namespace squish {
+
+class ConcurrencyController {
+public:
+    // ein messfenster, summiert über alle jobs die darin fertig wurden
+    struct Sample {
+        double window_ms = 0;  // wall zeit des fensters
+        double work_ms = 0;    // geschätzte kosten der fertigen jobs (JobEstimate::cost_ms)
+        double job_ms = 0;     // deren processing_time_ms
+        double cpu_ms = 0;     // deren cpu zeit
+        double runqueue_ms = 0;  // deren wartezeit auf eine cpu (zählt nicht als io)
+        size_t images = 0;
+    };
+
+    ConcurrencyController(size_t initial, size_t max_workers);
+
+    // neues fenster auswerten, gibt die worker zahl fürs nächste fenster zurück
+    size_t update(const Sample& sample);
+
+    size_t workers() const { return workers_; }
+    size_t max_workers() const { return max_workers_; }
+    size_t windows() const { return windows_; }
+    size_t changes() const { return changes_; }
+    double io_wait() const { return io_wait_; }  // anteil blockierter job zeit, letztes fenster
+
+    // worker zahl mit dem besten geglätteten durchsatz (oder der startwert ohne messung)
+    size_t best() const;
+
+    // gemerkte worker zahl pro input (liegt in ~/.cache/squish/workers)
+    static std::optional<size_t> load(const std::string& key);
+    static bool save(const std::string& key, size_t workers);
+
+private:
+    const size_t max_workers_;
+    size_t workers_;
+    int direction_ = 0;
+    double last_rate_ = 0;
+    double io_wait_ = 0;
+    size_t windows_ = 0;
+    size_t changes_ = 0;
+    std::map<size_t, double> rates_;  // geglätteter durchsatz pro worker zahl
+};
+
+} // namespace squish
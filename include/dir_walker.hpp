@@ -0,0 +1,64 @@
+#pragma once
+// verzeichnisse parallel durchlaufen und gefundene bilder schon während des scans
+// weitergeben. auf nfs ist jeder readdir/lookup ein roundtrip, ein einzelner
+// recursive_directory_iterator wartet da minutenlang während alle kerne nix tun.
+// linux: openat + getdents64 mit großem buffer, d_type spart das stat pro eintrag.
+// mehrere threads holen sich verzeichnisse von einem gemeinsamen stapel.
+// symlinks im baum werden nie verfolgt (weder auf dateien noch auf verzeichnisse),
+// nur ein root darf selber ein symlink sein - den hat der user ja so angegeben
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace squish {
+
+class DirWalker {
+public:
+    using Batch = std::vector<std::filesystem::path>;
+    // bekommt gefundene bilder in schüben, aus den walker threads (muss thread safe sein)
+    using Sink = std::function<void(Batch&&)>;
+
+    DirWalker(size_t threads, Sink sink);
+
+    DirWalker(const DirWalker&) = delete;
+    DirWalker& operator=(const DirWalker&) = delete;
+
+    // alle roots (verzeichnisse) durchlaufen, kommt zurück wenn alles gescannt
+    // und an den sink gegangen ist. fehler mittendrin gibts als warnung auf stderr
+    void walk(const std::vector<std::filesystem::path>& roots);
+
+    uint64_t dirs() const noexcept { return dirs_.load(std::memory_order_relaxed); }
+    uint64_t files() const noexcept { return files_.load(std::memory_order_relaxed); }
+    size_t threads() const noexcept { return threads_; }
+
+private:
+    struct Pending {
+        std::filesystem::path dir;
+        bool root;  // von der kommandozeile, symlink ok
+    };
+
+    void run();
+    void scan(const std::filesystem::path& dir, bool root, Batch& batch, std::vector<std::filesystem::path>& subdirs);
+    void take(Batch& batch, std::filesystem::path file);
+    void flush(Batch& batch);
+    void warn(const std::filesystem::path& dir, int error);
+
+    const size_t threads_;
+    Sink sink_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<Pending> pending_;                // stapel: tief zuerst, hält den stapel klein
+    size_t busy_ = 0;                             // threads die gerade ein verzeichnis lesen
+
+    std::atomic<uint64_t> dirs_{0};
+    std::atomic<uint64_t> files_{0};
+};
+
+} // namespace squish
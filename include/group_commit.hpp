@@ -0,0 +1,81 @@
+#pragma once
+// --fsync: outputs erst sichtbar machen wenn ihre daten auf der platte sind, aber nicht
+// ein fsync pro file (das killt jeden batch). writer/worker geben fertige outputs ab
+// und warten auf ihr ticket, ein commit thread macht pro gruppe:
+//   daten syncen -> alle linkat/renames -> jedes verzeichnis einmal syncen
+// was während eines commits reinkommt ist die nächste gruppe. je mehr gleichzeitig
+// warten, desto größer die gruppen - bei vielen files kostet das fast nix
+//
+// Mode::File:   fdatasync pro file, alle einer gruppe auf einmal über io_uring
+//               (das journal committet sie zusammen), sonst nacheinander
+// Mode::Syncfs: ein syncfs pro dateisystem vor und nach dem publish, egal wie
+//               viele files. flusht aber auch fremde dirty daten auf dem fs
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "atomic_file.hpp"
+#include "io_ring.hpp"
+
+namespace squish {
+
+class GroupCommit {
+public:
+    enum class Mode { File, Syncfs };
+    using Ticket = uint64_t;  // 0 = kein ticket
+
+    explicit GroupCommit(Mode mode);
+    ~GroupCommit();
+
+    GroupCommit(const GroupCommit&) = delete;
+    GroupCommit& operator=(const GroupCommit&) = delete;
+
+    // file (fertig geschrieben, noch ohne namen) wird mit der nächsten gruppe unter
+    // seinem target publiziert. leeres file = nur das verzeichnis von target syncen
+    // (hardlinks, die haben keine neuen daten)
+    Ticket stage(atomicfile::File file, const std::filesystem::path& target);
+    // bis die gruppe mit diesem ticket durch ist. fehler von sync oder publish
+    std::error_code wait(Ticket ticket);
+    // schon durch? wartet nicht, fehler holt trotzdem erst wait() ab
+    bool committed(Ticket ticket) const;
+
+    Mode mode() const noexcept { return mode_; }
+    uint64_t groups() const;
+    uint64_t files() const;
+    uint64_t data_syncs() const;  // fdatasync/syncfs aufrufe (io_uring fsyncs einzeln gezählt)
+    uint64_t dir_syncs() const;
+
+private:
+    struct Entry {
+        Ticket ticket = 0;
+        atomicfile::File file;
+        std::string dir;
+        std::error_code error;
+    };
+
+    void run();
+    void sync_data(std::vector<Entry>& group);
+
+    const Mode mode_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable committed_;
+    std::vector<Entry> pending_;
+    std::unordered_map<Ticket, std::error_code> errors_;  // nur fehlgeschlagene, wait() holt sie ab
+    Ticket next_ticket_ = 1;
+    Ticket done_upto_ = 0;
+    bool stop_ = false;
+    uint64_t groups_ = 0;
+    uint64_t files_ = 0;
+    uint64_t data_syncs_ = 0;
+    uint64_t dir_syncs_ = 0;
+    ioring::Ring ring_;  // fdatasyncs einer gruppe, nur der commit thread fasst ihn an
+    std::thread thread_;
+};
+
+} // namespace squish
@@ -6,9 +6,22 @@
 #include <cstdint>
 #include <filesystem>
 #include <optional>
+#include <algorithm>
+#include <cstring>
+#include "buffer_pool.hpp"
+#include "image_view.hpp"
+#include "image_probe.hpp"
+#include "mmap_file.hpp"
+#include "path_list.hpp"
+#include "io_ring.hpp"
+#include "atomic_file.hpp"
+#include "memory_budget.hpp"
 
 namespace squish {
 
+class Prefetcher;
+class GroupCommit;
+
 enum class OutputFormat {
     JPEG,
     PNG,
@@ -23,6 +36,17 @@ enum class Quality {
     LOSSLESS = 100
 };
 
+// abarbeitungsreihenfolge (--order): stream = largest-first unter dem was schon geprobt
+// ist, läuft während dem scan an. cost = largest-first über alle (wartet auf den scan),
+// inode/disk = nach lage auf der platte, damit eine hdd am stück lesen kann statt für
+// jedes file zu seeken
+enum class InputOrder {
+    Stream,
+    Cost,
+    Inode,
+    Disk  // physischer offset per FIEMAP, wo es keinen gibt nach inode
+};
+
 struct ProcessingOptions {
     OutputFormat format = OutputFormat::AUTO;
     int quality = 85;
@@ -31,13 +55,49 @@ struct ProcessingOptions {
     bool preserve_aspect = true;
     bool strip_metadata = true;
     bool use_gpu = false;  // GPU acceleration for large images
+    MemoryBudget* memory_budget = nullptr;  // nullptr = keine admission, alles läuft sofort
+    Prefetcher* prefetcher = nullptr;       // nullptr = kein read-ahead über die warteschlange
+    bool hardlink_unchanged = false;  // unveränderte originale hardlinken statt kopieren (gleiches fs)
+    GroupCommit* group_commit = nullptr;    // --fsync: outputs erst nach sync einhängen, gruppenweise
+    bool direct_io = false;  // outputs mit O_DIRECT schreiben (am page cache vorbei)
+    InputOrder order = InputOrder::Stream;  // bei inode/disk holt estimate() auch die lage
 };
 
+// bild mit eigenem speicher aus dem per-thread pool
+// neue bilder (create) haben 64 byte aligned zeilen, stride != width*channels ist also normal.
+// vom decoder übernommene bilder bleiben gepackt wie stbi sie liefert
+// für crops/tiles/kernels view() nehmen, das kopiert nix
 struct ImageData {
-    std::vector<uint8_t> pixels;
+    bufpool::Buffer storage;
     int width = 0;
     int height = 0;
     int channels = 0;
+    ptrdiff_t stride = 0;        // bytes pro zeile (pro plane bei planar)
+    ptrdiff_t plane_stride = 0;  // 0 bei interleaved
+    imgview::Layout layout = imgview::Layout::Interleaved;
+    // exif orientation die noch NICHT angewendet ist, pixel liegen so wie dekodiert.
+    // oriented() liefert die gedrehte sicht, resize/encoder lesen da direkt durch
+    int orientation = 1;
+
+    // neues bild mit aligned zeilen, wirft std::bad_alloc wenn der pool nix hergibt
+    static ImageData create(int width, int height, int channels,
+                            imgview::Layout layout = imgview::Layout::Interleaved);
+
+    uint8_t* data() { return storage.data(); }
+    const uint8_t* data() const { return storage.data(); }
+    bool empty() const { return storage.data() == nullptr; }
+
+    imgview::View view() {
+        return {storage.data(), width, height, channels, stride, plane_stride, layout};
+    }
+    imgview::ConstView view() const {
+        return {storage.data(), width, height, channels, stride, plane_stride, layout};
+    }
+
+    // maße/pixel so wie das bild angezeigt werden soll (orientation angewendet)
+    int oriented_width() const { return (orientation >= 5 && orientation <= 8) ? height : width; }
+    int oriented_height() const { return (orientation >= 5 && orientation <= 8) ? width : height; }
+    imgview::ConstView oriented() const;
 };
 
 struct ProcessingResult {
@@ -48,6 +108,19 @@ struct ProcessingResult {
     bool success = false;
     std::string error_message;
     double processing_time_ms = 0;
+    double predicted_ms = 0;  // was das kostenmodell vorher geschätzt hat (0 = nicht geschätzt)
+    // wo die zeit hinging, für den concurrency controller und -v
+    double read_ms = 0;       // öffnen + mappen + seiten einlesen (io stufe)
+    double decode_ms = 0;     // dekodieren
+    double transform_ms = 0;  // drehen + resize
+    double encode_ms = 0;     // kodieren in die tmp datei
+    double write_ms = 0;      // rename bzw. kopieren (io stufe)
+    atomicfile::CopyMethod kept = atomicfile::CopyMethod::None;  // original übernommen (skip/größer geworden): wie
+    // cpu zeit der compute stufe (decode bis encode). der rest davon = blockiert (faults, writeback)
+    double cpu_ms = 0;
+    double runqueue_ms = 0;   // lauffähig, aber keine cpu frei
+
+    double compute_ms() const { return decode_ms + transform_ms + encode_ms; }
 
     double compression_ratio() const {
         if (original_size == 0) return 0;
@@ -55,31 +128,139 @@ struct ProcessingResult {
     }
 };
 
+// kodiertes bild im speicher (pool block). compute kodiert hier rein und fasst das
+// dateisystem nicht an, open/write/publish macht danach die write stufe
+struct EncodedImage {
+    bufpool::Buffer data;
+    size_t size = 0;
+
+    // hinten dran, wächst verdoppelnd. false = kein speicher mehr
+    bool append(const void* bytes, size_t count) {
+        if (size + count > data.size()) {
+            bufpool::Buffer grown(std::max(size + count, data.size() * 2));
+            if (!grown) return false;
+            if (size) std::memcpy(grown.data(), data.data(), size);
+            data = std::move(grown);
+        }
+        std::memcpy(data.data() + size, bytes, count);
+        size += count;
+        return true;
+    }
+    void reset() {
+        data = bufpool::Buffer();
+        size = 0;
+    }
+};
+
+// vorab-schätzung eines jobs aus header + dateigröße, für largest-first scheduling
+struct JobEstimate {
+    imgprobe::Header header;
+    size_t file_size = 0;
+    double cost_ms = 0;  // vorhergesagte laufzeit von process(), nur relativ wirklich sinnvoll
+    uint64_t memory_bytes = 0;  // was process() fürs budget reserviert (0 = nur kopieren)
+    mmapfile::Location location;  // nur bei --order inode/disk
+};
+
+// ein bild auf dem weg durch die pipeline: read (io) -> compute -> write (io).
+// jede stufe macht nix mehr sobald done gesetzt ist (fehler, ergebnis steht schon fest)
+struct PipelineJob {
+    size_t index = 0;  // position in der input liste
+    const JobEstimate* estimate = nullptr;     // aus der probe, für budget und Done
+    const FileOverrides* overrides = nullptr;  // --files-from zeile mit eigenen optionen/output
+    ProcessingResult result;
+    // input bytes, compute gibt sie nach dem dekodieren frei: gemappt (read) oder per
+    // io_uring schon gelesen (read_batch), in einen fixed buffer des rings oder den pool
+    mmapfile::MappedFile mapped;
+    ioring::FixedBuffer fixed;
+    bufpool::Buffer buffer;
+    size_t buffered = 0;
+    imgprobe::Header header;
+    bool copy = false;   // schon gut komprimiert, write kopiert nur
+    bool done = false;
+    EncodedImage encoded;     // compute kodiert hier rein, flush schreibt es ins output file
+    // pipeline: vom reader vor dem lesen (footprint + input), nach compute nur noch encoded
+    MemoryBudget::Reservation reservation;
+    atomicfile::File output;  // geschrieben aber noch ohne namen, write macht es sichtbar
+    bool published = false;   // publish_batch hat schon eingehängt + compressed_size eingetragen
+    uint64_t ticket = 0;      // --fsync: output liegt beim group commit, settle() wartet drauf
+
+    bool has_input() const { return mapped.is_open() || buffered > 0; }
+    const uint8_t* input_data() const {
+        return mapped.is_open() ? mapped.data() : fixed ? fixed.data() : buffer.data();
+    }
+    size_t input_size() const { return mapped.is_open() ? mapped.size() : buffered; }
+    void release_input() {
+        mapped.close();
+        fixed.reset();
+        buffer = bufpool::Buffer();
+        buffered = 0;
+    }
+};
+
 class ImageProcessor {
 public:
     ImageProcessor() = default;
 
-    // einzelnes bild verarbeiten
+    // einzelnes bild verarbeiten (read + compute + write hintereinander auf diesem thread)
     ProcessingResult process(
         const std::filesystem::path& input,
         const std::filesystem::path& output_dir,
-        const ProcessingOptions& options
+        const ProcessingOptions& options,
+        const FileOverrides* overrides = nullptr
     );
 
-    // bild laden
+    // optionen vom lauf mit dem was eine --files-from zeile anders will
+    static ProcessingOptions with_overrides(const ProcessingOptions& options, const FileOverrides& overrides);
+
+    // die drei stufen einzeln, für die pipeline (siehe pipeline.hpp)
+    // read: öffnen, header, skip entscheiden, seiten einlesen. nur io, kein dekodieren
+    static void read(PipelineJob& job, const std::filesystem::path& input, const ProcessingOptions& options);
+    // read für einen ganzen schwung über io_uring: opens+statx, dann reads+closes, je ein
+    // syscall. result.input_path muss gesetzt sein. große/komische files gehen über read()
+    static void read_batch(const std::vector<PipelineJob*>& jobs, ioring::Ring& ring,
+                           const ProcessingOptions& options);
+    // compute: budget reservieren, dekodieren, drehen/resizen, in job.encoded kodieren
+    void compute(PipelineJob& job, const std::filesystem::path& output_dir, const ProcessingOptions& options);
+    // write: job.encoded rausschreiben (falls flush_batch das nicht schon hat), unter seinem
+    // namen einhängen (bzw. original kopieren), größen + gesamtzeit eintragen
+    static void write(PipelineJob& job, const std::filesystem::path& output_dir, const ProcessingOptions& options);
+    // --fsync: warten bis der group commit den output durch hat (write() gibt ihn nur ab).
+    // mehrere writes vor den settles = die landen in einer gruppe
+    static void settle(PipelineJob& job, const ProcessingOptions& options);
+    // output files eines schwungs anlegen und alle writes in einem submit, danach ist
+    // nur noch publish dran. was nicht klappt macht write() einzeln
+    static void flush_batch(const std::vector<PipelineJob*>& jobs, ioring::Ring& ring, const ProcessingOptions& options);
+    // linkat/renames eines schwungs über io_uring vorziehen, write()
+    // macht danach nur noch den rest. was nicht klappt bleibt für den normalen weg liegen
+    static void publish_batch(const std::vector<PipelineJob*>& jobs, ioring::Ring& ring);
+
+    // datei kurz mappen, header lesen und schätzen wie teuer process() wird.
+    // geht die gleichen entscheidungen durch (skip, resize, drehung) ohne zu dekodieren
+    static JobEstimate estimate(const std::filesystem::path& input, const ProcessingOptions& options);
+
+    // bild laden, exif orientation wird nur gemerkt (ImageData::orientation)
     std::optional<ImageData> load_image(const std::filesystem::path& path);
 
-    // bild speichern
+    // schon gemappte/gelesene datei dekodieren, header kommt von imgprobe::probe
+    std::optional<ImageData> decode_image(const uint8_t* bytes, size_t size, const imgprobe::Header& header);
+
+    // bild in speicher kodieren (beliebiger view, crops und gedrehte views gehen
+    // direkt). output_path entscheidet bei AUTO über das format
     bool save_image(
-        const ImageData& image,
-        const std::filesystem::path& path,
+        imgview::ConstView image,
+        const std::filesystem::path& output_path,
+        EncodedImage& out,
         OutputFormat format,
         int quality,
         bool use_gpu = false
     );
 
-    // Resize image
-    ImageData resize(const ImageData& image, int new_width, int new_height);
+    // Resize image (view rein, neues aligned bild raus)
+    // gedrehte views (ImageData::oriented) werden beim samplen gedreht
+    ImageData resize(imgview::ConstView image, int new_width, int new_height);
+
+    // exif orientation anwenden, gibt neues bild mit ggf. getauschten maßen zurück
+    ImageData apply_orientation(imgview::ConstView image, int orientation);
 
     // welche extensions gehen
     static const std::vector<std::string>& supported_extensions();
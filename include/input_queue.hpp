@@ -0,0 +1,66 @@
+#pragma once
+// warteschlange zwischen header probe und verarbeitung. geprobte files kommen schubweise
+// rein während der scan noch läuft, reader/worker nehmen sie sofort raus - vorher hat
+// kein bild angefangen bevor der ganze baum durch war.
+// largest-first: heap über alles was schon geprobt aber noch nicht genommen ist (LPT
+// im fenster statt global). sonst fifo, für reihenfolgen die schon fertig sortiert
+// reinkommen (--order cost/inode/disk nach dem scan).
+// jeder pop kriegt eine laufende position, über die der prefetcher vorausschaut: peek
+// legt die nächsten positionen fest, die kommen dann in genau der reihenfolge raus
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace squish {
+
+struct JobEstimate;
+
+class InputQueue {
+public:
+    struct Item {
+        size_t index;                  // position in der input liste
+        const JobEstimate* estimate;   // lebt bis zum ende vom lauf
+    };
+
+    explicit InputQueue(bool largest_first) : largest_first_(largest_first) {}
+
+    InputQueue(const InputQueue&) = delete;
+    InputQueue& operator=(const InputQueue&) = delete;
+
+    void push(const std::vector<Item>& items);
+    // kommt nix mehr dazu, pop gibt danach false sobald leer
+    void close();
+
+    // blockiert bis was da ist. position = wievieltes genommenes. false = zu und leer
+    bool pop(Item& item, size_t& position);
+    // wie pop, wartet aber nicht
+    bool try_pop(Item& item, size_t& position);
+
+    // was an position kommen wird, blockiert bis es feststeht. schon genommene
+    // positionen überspringt es (position wird hochgesetzt). false = gibt es nie
+    // oder interrupt()
+    bool peek(size_t& position, Item& item);
+    // peek wartet nicht mehr (prefetcher stop)
+    void interrupt();
+
+    size_t pushed() const;
+
+private:
+    bool take(Item& item, size_t& position);  // unter mutex_
+    void fix_next();                          // heap top nach fixed_, unter mutex_
+
+    const bool largest_first_;
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<Item> heap_;   // largest-first, noch nicht festgelegt
+    std::deque<Item> fixed_;   // kommen als nächstes raus, in der reihenfolge
+    size_t taken_ = 0;         // positionen davor sind schon raus
+    size_t pushed_ = 0;
+    bool closed_ = false;
+    bool interrupted_ = false;
+};
+
+} // namespace squish
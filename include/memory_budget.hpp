@@ -0,0 +1,81 @@
+#pragma once
+// globales speicherbudget für alle jobs (weighted semaphore)
+// jeder job reserviert vor dem dekodieren genau das was er braucht (aus den header maßen)
+// und wartet wenn das budget voll ist, statt pro bild /proc/meminfo zu lesen und zu raten
+
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+
+namespace squish {
+
+class MemoryBudget {
+public:
+    static constexpr uint64_t UNLIMITED = UINT64_MAX;
+
+    explicit MemoryBudget(uint64_t capacity);
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    // gibt beim zerstören frei, movable damit man sie aus funktionen rausgeben kann
+    class Reservation {
+    public:
+        Reservation() = default;
+        Reservation(Reservation&& other) noexcept : budget_(other.budget_), bytes_(other.bytes_) {
+            other.budget_ = nullptr;
+            other.bytes_ = 0;
+        }
+        Reservation& operator=(Reservation&& other) noexcept;
+        ~Reservation() { reset(); }
+
+        Reservation(const Reservation&) = delete;
+        Reservation& operator=(const Reservation&) = delete;
+
+        void reset();
+        // nur noch bytes behalten, den rest sofort zurückgeben (nach dem kodieren hängt
+        // am job nur noch der output buffer)
+        void shrink(uint64_t bytes);
+        uint64_t bytes() const noexcept { return bytes_; }
+        bool held() const noexcept { return budget_ != nullptr; }
+
+    private:
+        friend class MemoryBudget;
+        Reservation(MemoryBudget* budget, uint64_t bytes) : budget_(budget), bytes_(bytes) {}
+
+        MemoryBudget* budget_ = nullptr;
+        uint64_t bytes_ = 0;
+    };
+
+    // blockiert bis bytes frei sind. wer zuerst kommt wird zuerst bedient (kein verhungern
+    // großer jobs hinter lauter kleinen). mehr als capacity wird auf capacity gekappt,
+    // so ein job läuft dann eben allein statt abgelehnt zu werden
+    Reservation reserve(uint64_t bytes);
+    // wie reserve, aber nie warten: false wenn es nicht sofort passt oder schon wer
+    // ansteht (der soll nicht überholt werden). für wer schon was hält und nicht
+    // blockieren darf, sonst wartet er evtl. auf sich selber
+    bool try_reserve(uint64_t bytes, Reservation& out);
+
+    uint64_t capacity() const noexcept { return capacity_; }
+    uint64_t in_use() const;
+    uint64_t peak() const;
+    uint64_t waits() const;  // wie oft ein job warten musste (für -v)
+
+    // freier speicher jetzt: MemAvailable, im container höchstens memory.max - current.
+    // UNLIMITED wenn sich nix rausfinden lässt
+    static uint64_t system_available();
+
+private:
+    void release(uint64_t bytes);
+
+    const uint64_t capacity_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    uint64_t in_use_ = 0;
+    uint64_t peak_ = 0;
+    uint64_t waits_ = 0;
+    uint64_t next_ticket_ = 0;  // fifo: tickets werden in reihenfolge bedient
+    uint64_t serving_ = 0;
+};
+
+} // namespace squish
@@ -0,0 +1,115 @@
+#pragma once
+// input liste ohne ein std::filesystem::path pro file: bei millionen files sind das
+// 32 byte + eigene heap allokation mit dem vollen pfad, gigabytes nur für namen.
+// hier steht jedes verzeichnis einmal drin, die dateinamen liegen hintereinander in
+// 1 MB blöcken (arena) und pro file bleiben 16 byte index. der volle pfad wird erst
+// zusammengebaut wenn ihn jemand braucht (lesen, fehlermeldung)
+//
+// der scan hängt noch an während reader und worker schon lesen: add/set_overrides
+// nehmen den lock exklusiv, lesen geteilt. namen aus name() bleiben gültig, die
+// arena blöcke wandern nicht. overrides (--files-from) gibts nur für files deren
+// zeile was eigenes will
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace squish {
+
+// --files-from: was eine zeile für ihr file anders will als der rest vom lauf
+struct FileOverrides {
+    std::filesystem::path output;  // leer = wie sonst unter -o
+    int quality = 0;               // 0 = -q vom lauf
+    int max_width = -1;            // -1 = vom lauf, 0 = kein resize
+    int max_height = -1;
+
+    bool empty() const { return output.empty() && quality == 0 && max_width < 0 && max_height < 0; }
+};
+
+class PathList {
+public:
+    using Char = std::filesystem::path::value_type;
+    using String = std::filesystem::path::string_type;
+
+    PathList() = default;
+    PathList(const PathList&) = delete;
+    PathList& operator=(const PathList&) = delete;
+
+    // hängt file hinten dran, gibt den index zurück
+    size_t add(const std::filesystem::path& file);
+    void reserve(size_t n) {
+        std::unique_lock lock(mutex_);
+        entries_.reserve(n);
+    }
+
+    size_t size() const {
+        std::shared_lock lock(mutex_);
+        return entries_.size();
+    }
+    bool empty() const { return size() == 0; }
+    size_t dirs() const {
+        std::shared_lock lock(mutex_);
+        return dirs_.size();
+    }
+    // belegt insgesamt (arena + index + verzeichnisse), für -v
+    size_t bytes() const;
+
+    std::filesystem::path path(size_t i) const;
+    std::filesystem::path filename(size_t i) const { return std::filesystem::path(name(i)); }
+    // nur der name, zeigt in die arena
+    std::basic_string_view<Char> name(size_t i) const {
+        std::shared_lock lock(mutex_);
+        return name_locked(i);
+    }
+    // index des verzeichnisses von file i (gleiche nummer = gleiches verzeichnis)
+    uint32_t dir_of(size_t i) const {
+        std::shared_lock lock(mutex_);
+        return entries_[i].dir;
+    }
+
+    void set_overrides(size_t i, FileOverrides overrides) {
+        std::unique_lock lock(mutex_);
+        overrides_[i] = std::move(overrides);
+    }
+    // nullptr = file läuft mit den optionen vom lauf. der eintrag selber bleibt stehen
+    const FileOverrides* overrides(size_t i) const {
+        std::shared_lock lock(mutex_);
+        if (overrides_.empty()) return nullptr;
+        auto it = overrides_.find(i);
+        return it == overrides_.end() ? nullptr : &it->second;
+    }
+
+private:
+    struct Entry {
+        uint32_t dir;
+        uint32_t block;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    uint32_t intern_dir(const String& dir);
+    std::basic_string_view<Char> name_locked(size_t i) const {
+        const Entry& e = entries_[i];
+        return {blocks_[e.block].get() + e.offset, e.length};
+    }
+
+    mutable std::shared_mutex mutex_;
+
+    std::vector<Entry> entries_;
+    std::vector<std::unique_ptr<Char[]>> blocks_;
+    size_t block_used_ = 0;  // im letzten block
+    // verzeichnis -> nummer. die keys sind gleichzeitig der speicher, dirs_ zeigt auf sie
+    // (knoten einer unordered_map wandern nicht)
+    std::unordered_map<String, uint32_t> dir_index_;
+    std::vector<const String*> dirs_;
+    uint32_t last_dir_ = UINT32_MAX;  // files kommen meistens verzeichnisweise
+    std::unordered_map<size_t, FileOverrides> overrides_;
+};
+
+} // namespace squish
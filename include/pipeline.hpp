@@ -0,0 +1,100 @@
+#pragma once
+// batch als pipeline: read (io threads) -> compute (thread pool) -> write (io threads)
+// vorher hat jeder worker lesen, dekodieren, kodieren und schreiben hintereinander
+// gemacht - hängt er an der platte, rechnet der kern nix. jetzt lesen/schreiben eigene
+// threads, dazwischen BoundedQueues. volle queue = der davor wartet (backpressure),
+// es wird also nie mehr als queue_depth bilder vorgelesen bzw. liegen gelassen.
+// auf linux holen sich reader und writer ihre files schubweise über io_uring
+// (ein ring pro io thread), sonst einzeln über mmap wie process().
+// die reader nehmen ihre files aus der InputQueue, die füllt der scan noch während
+// schon gelesen wird. pro gelesenem bild geht ein compute task an den pool - worker
+// warten also nie blockierend auf input, sie proben solange weiter
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "image_processor.hpp"
+#include "input_queue.hpp"
+#include "path_list.hpp"
+#include "thread_pool.hpp"
+
+namespace squish {
+
+class Pipeline {
+public:
+    // im writer thread aufgerufen sobald ein bild ganz fertig ist
+    using Done = std::function<void(size_t index, const JobEstimate& estimate, ProcessingResult&& result)>;
+
+    // readers/writers: io threads pro richtung, depth: plätze pro queue.
+    // io_uring = false oder kernel kann es nicht -> mmap/rename einzeln
+    Pipeline(ThreadPool& pool, size_t readers, size_t writers, size_t depth, bool io_uring = true);
+    ~Pipeline();
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    // startet alles und kehrt sofort zurück. inputs werden in der reihenfolge gelesen in
+    // der sie aus queue kommen, die referenzen müssen bis wait() leben. nur einmal aufrufen.
+    // mit budget reserviert der reader vor dem lesen was der job braucht (estimate),
+    // vorgelesene bilder zählen also mit
+    void start(const PathList& inputs, InputQueue& queue, const std::filesystem::path& output_dir,
+               const ProcessingOptions& options, Done done);
+
+    // true = queue zu und alles daraus geschrieben (threads aufräumen macht dann wait)
+    bool wait_for(std::chrono::milliseconds timeout);
+    // bis queue zu und alles durch ist, io threads beenden. wirft exceptions aus der compute
+    // stufe oder von einem reader
+    void wait();
+
+    size_t readers() const noexcept { return readers_; }
+    size_t writers() const noexcept { return writers_; }
+    size_t depth() const noexcept { return depth_; }
+    // wie oft die reader compute leer angetroffen haben (io oder scan zu langsam) bzw.
+    // reader und compute vor einer vollen queue standen (die stufe danach zu langsam)
+    uint64_t compute_starved() const noexcept { return starved_.load(std::memory_order_relaxed); }
+    uint64_t read_blocked() const noexcept { return to_compute_.full_waits(); }
+    uint64_t write_blocked() const noexcept { return to_write_.full_waits(); }
+    // io_uring: wieviele io threads einen ring haben, files darüber, io_uring_enter aufrufe
+    size_t rings() const noexcept;
+    uint64_t uring_files() const noexcept { return uring_files_.load(std::memory_order_relaxed); }
+    uint64_t uring_submits() const noexcept;
+
+private:
+    using JobPtr = std::unique_ptr<PipelineJob>;
+
+    void read_loop(const PathList& inputs, InputQueue& queue, const std::filesystem::path& output_dir,
+                   const ProcessingOptions& options, ioring::Ring* ring);
+    // ein gelesenes bild an compute geben, plus den task der es rechnet
+    void hand_off(JobPtr job, const std::filesystem::path& output_dir, const ProcessingOptions& options);
+    void write_loop(const std::filesystem::path& output_dir, const ProcessingOptions& options, const Done& done,
+                    ioring::Ring* ring);
+
+    ThreadPool& pool_;
+    const size_t readers_;
+    const size_t writers_;
+    const size_t depth_;
+    const bool io_uring_;
+    std::vector<std::unique_ptr<ioring::Ring>> rings_;  // [readers..., writers...], nullptr = ohne
+    std::atomic<uint64_t> uring_files_{0};
+    BoundedQueue<JobPtr> to_compute_;
+    BoundedQueue<JobPtr> to_write_;  // nullptr = writer soll aufhören
+    std::atomic<size_t> queued_{0};    // in to_compute_, noch von keinem task geholt
+    std::atomic<uint64_t> starved_{0};
+    Latch read_;      // reader die noch laufen
+    Latch computed_;
+    Latch written_;   // gelesen aber noch nicht geschrieben
+    Done done_;
+    std::mutex error_mutex_;
+    std::exception_ptr read_error_;  // reader ist rausgeflogen, wirft wait()
+    std::vector<std::thread> threads_;
+    bool joined_ = true;
+};
+
+} // namespace squish
@@ -0,0 +1,74 @@
+#pragma once
+// read-ahead fenster über die warteschlange: ein thread läuft den workers/readern
+// in der abarbeitungsreihenfolge voraus und lässt den kernel die nächsten files schon
+// in den page cache lesen (fadvise WILLNEED). ohne das faultet der decoder bei kalten
+// files jede seite einzeln synchron rein. wieviel vorgeholt sein darf begrenzt ein
+// byte budget, sonst verdrängt man bei großen batches das was gleich gebraucht wird.
+// was als nächstes kommt sagt die InputQueue (peek), die läuft auch während dem scan
+
+#include <condition_variable>
+#include <deque>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include "input_queue.hpp"
+#include "path_list.hpp"
+
+namespace squish {
+
+class Prefetcher {
+public:
+    // referenzen müssen leben bis stop()
+    Prefetcher(const PathList& inputs, InputQueue& queue, uint64_t budget);
+    ~Prefetcher();
+
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    void start();
+    void stop();
+
+    // position k (vom pop aus der queue) wird jetzt gelesen. thread safe
+    void claim(size_t k);
+
+    uint64_t budget() const noexcept { return budget_; }
+    // fadvise war schon durch als das file abgeholt wurde. heißt nur dass der kernel die
+    // readahead angestoßen hat, nicht dass alles schon im page cache liegt - das sagt
+    // WILLNEED einem nicht
+    uint64_t issued_ahead() const;
+    // abgeholt bevor das fadvise raus war (prefetcher hinten dran oder budget voll)
+    uint64_t not_ahead() const;
+    uint64_t bytes() const;  // insgesamt vorgeholt
+
+private:
+    void run();
+
+    // WARMING = im budget, fadvise läuft noch. ISSUED = fadvise ist zurück
+    enum : uint8_t { QUEUED, WARMING, ISSUED, CLAIMED };
+    struct Slot {
+        uint8_t state = QUEUED;
+        uint64_t size = 0;  // was beim vorholen draufgerechnet wurde
+    };
+    Slot& slot(size_t k);  // unter mutex_, k >= base_
+
+    const PathList& inputs_;
+    InputQueue& queue_;
+    const uint64_t budget_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<Slot> slots_;       // ab position base_, vorne fällt weg was abgeholt ist
+    size_t base_ = 0;
+    size_t front_ = 0;             // alles davor ist schon beim lesen, nicht mehr vorholen
+    uint64_t ahead_bytes_ = 0;     // vorgeholt aber noch nicht abgeholt
+    size_t ahead_files_ = 0;
+    uint64_t issued_ahead_ = 0;
+    uint64_t not_ahead_ = 0;
+    uint64_t bytes_ = 0;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+} // namespace squish
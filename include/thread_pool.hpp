@@ -1,68 +1,423 @@
-// thread_pool.hpp - standard threadpool implementation
-// nix besonderes, copy paste aus nem alten projekt von mir
+// thread_pool.hpp - work stealing threadpool
+// jeder worker hat seine eigene Chase-Lev deque (push/pop unten, andere klauen oben),
+// tasks von außen gehen lock-free in eine injection queue. worker spinnen kurz
+// bevor sie schlafen gehen, damit kleine icons nicht jedes mal nen futex wake kosten
 #pragma once
 
 #include <vector>
-#include <queue>
+#include <memory>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
 #include <future>
 #include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <exception>
+#include <algorithm>
+#include <type_traits>
+#include <chrono>
+#include <optional>
 
 namespace squish {
 
+// zähler auf den man warten kann - ein latch pro batch statt einem future pro item.
+// die erste exception aus dem batch wird gemerkt und beim warten geworfen
+class Latch {
+public:
+    explicit Latch(size_t count = 0) : count_(count) {}
+
+    Latch(const Latch&) = delete;
+    Latch& operator=(const Latch&) = delete;
+
+    void add(size_t n = 1) { count_.fetch_add(n, std::memory_order_relaxed); }
+    void count_down(size_t n = 1);
+    void set_error(std::exception_ptr error);
+
+    bool ready() const noexcept { return count_.load(std::memory_order_acquire) == 0; }
+
+    // blockiert bis 0, wirft dann die gemerkte exception (falls eine)
+    void wait();
+
+    // wie wait, gibt aber nach timeout auf. true = fertig (exception holt dann wait())
+    bool wait_for(std::chrono::milliseconds timeout);
+
+private:
+    std::atomic<size_t> count_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::exception_ptr error_;  // nur unter mutex_
+};
+
+// feste größe, viele producer + viele consumer, zwischen den pipeline stufen.
+// ticket pro push/pop (ein fetch_add), jeder slot hat einen turn zähler: gerade = frei
+// für den push dieser runde, ungerade = belegt. voll/leer -> kurz spinnen, dann futex
+// (atomic wait) auf genau diesen slot. so staut sich vorne nix auf wenn hinten wer hängt
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(std::max<size_t>(capacity, 1)), slots_(new Slot[capacity_]) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // blockiert solange voll (backpressure)
+    void push(T value) {
+        const size_t ticket = head_.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots_[ticket % capacity_];
+        const uint32_t turn = static_cast<uint32_t>(ticket / capacity_) * 2;
+        if (!await(slot, turn)) full_waits_.fetch_add(1, std::memory_order_relaxed);
+        slot.value.emplace(std::move(value));
+        slot.turn.store(turn + 1, std::memory_order_release);
+        slot.turn.notify_all();
+    }
+
+    // blockiert solange leer
+    T pop() {
+        const size_t ticket = tail_.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots_[ticket % capacity_];
+        const uint32_t turn = static_cast<uint32_t>(ticket / capacity_) * 2 + 1;
+        if (!await(slot, turn)) empty_waits_.fetch_add(1, std::memory_order_relaxed);
+        T value = std::move(*slot.value);
+        slot.value.reset();
+        slot.turn.store(turn + 1, std::memory_order_release);
+        slot.turn.notify_all();
+        return value;
+    }
+
+    // nicht blockierend: false wenn grad nix fertig drin liegt
+    bool try_pop(T& out) {
+        size_t ticket = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[ticket % capacity_];
+            const uint32_t turn = static_cast<uint32_t>(ticket / capacity_) * 2 + 1;
+            if (slot.turn.load(std::memory_order_acquire) == turn) {
+                if (tail_.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed)) {
+                    out = std::move(*slot.value);
+                    slot.value.reset();
+                    slot.turn.store(turn + 1, std::memory_order_release);
+                    slot.turn.notify_all();
+                    return true;
+                }
+            } else {
+                size_t current = tail_.load(std::memory_order_relaxed);
+                if (current == ticket) return false;
+                ticket = current;
+            }
+        }
+    }
+
+    size_t capacity() const noexcept { return capacity_; }
+    // wie oft ein push auf platz bzw. ein pop auf daten warten musste (für -v)
+    uint64_t full_waits() const noexcept { return full_waits_.load(std::memory_order_relaxed); }
+    uint64_t empty_waits() const noexcept { return empty_waits_.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> turn{0};
+        std::optional<T> value;
+    };
+
+    // true = sofort dran, false = musste warten
+    static bool await(Slot& slot, uint32_t turn) {
+        for (int spin = 0; spin < 64; spin++) {
+            if (slot.turn.load(std::memory_order_acquire) == turn) return true;
+        }
+        uint32_t seen;
+        while ((seen = slot.turn.load(std::memory_order_acquire)) != turn) {
+            slot.turn.wait(seen, std::memory_order_acquire);
+        }
+        return false;
+    }
+
+    const size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    std::atomic<uint64_t> full_waits_{0};
+    std::atomic<uint64_t> empty_waits_{0};
+};
+
+namespace detail {
+
+// ein task = eine allokation (callable + promise zusammen), kein
+// shared_ptr<packaged_task> + std::function mehr. next ist für die injection queue
+struct Task {
+    std::atomic<Task*> next{nullptr};
+    virtual ~Task() = default;
+    virtual void run() = 0;
+};
+
+template<typename R, typename Fn>
+struct FutureTask final : Task {
+    Fn fn;
+    std::promise<R> promise;
+
+    explicit FutureTask(Fn&& f) : fn(std::move(f)) {}
+
+    void run() override {
+        try {
+            if constexpr (std::is_void_v<R>) {
+                fn();
+                promise.set_value();
+            } else {
+                promise.set_value(fn());
+            }
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+    }
+};
+
+// bulk job: ein paar helfer-tasks holen sich stücke aus [next, end) per fetch_add
+// bis nix mehr da ist. der letzte helfer löscht den job und zählt den latch runter
+struct RangeJob {
+    std::atomic<size_t> next;
+    const size_t end;
+    const size_t grain;
+    std::atomic<size_t> helpers;
+    Latch* latch;
+    // parallel_for aus einem worker: der wartet in wait() und holt nix aus der injection
+    // queue, ein dorthin verschobener helfer würde seinen latch nie runterzählen
+    const bool nested;
+
+    RangeJob(size_t begin, size_t e, size_t g, Latch* l, bool n)
+        : next(begin), end(e), grain(g), helpers(0), latch(l), nested(n) {}
+    virtual ~RangeJob() = default;
+    virtual void run_range(size_t lo, size_t hi) = 0;
+
+    bool work();  // false = abgebrochen weil der worker abgeschaltet wurde, rest ist noch offen
+    void release();
+};
+
+template<typename Fn>
+struct RangeJobFn final : RangeJob {
+    Fn fn;
+
+    RangeJobFn(size_t begin, size_t e, size_t g, Latch* l, bool n, Fn&& f)
+        : RangeJob(begin, e, g, l, n), fn(std::move(f)) {}
+
+    void run_range(size_t lo, size_t hi) override { fn(lo, hi); }
+};
+
+struct RangeTask final : Task {
+    RangeJob* job;
+
+    explicit RangeTask(RangeJob* j) : job(j) {}
+
+    void run() override;
+};
+
+bool worker_switched_off();
+void requeue(RangeJob* job);  // neuer helfer für den rest, ersetzt den abgebrochenen
+
+// Chase-Lev deque (Lê et al. 2013, C11 atomics variante)
+// nur der besitzer darf push/pop, steal geht von jedem thread
+// wächst bei bedarf, alte arrays bleiben bis zum ende liegen (thieves könnten noch lesen)
+class WorkDeque {
+public:
+    WorkDeque();
+    ~WorkDeque();
+
+    WorkDeque(const WorkDeque&) = delete;
+    WorkDeque& operator=(const WorkDeque&) = delete;
+
+    void push(Task* task);
+    Task* pop();
+    Task* steal();
+
+    bool empty() const {
+        return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Ring {
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<Task*>[]> slots;
+
+        explicit Ring(int64_t cap)
+            : capacity(cap), mask(cap - 1), slots(new std::atomic<Task*>[static_cast<size_t>(cap)]) {}
+
+        Task* get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, Task* t) { slots[i & mask].store(t, std::memory_order_relaxed); }
+    };
+
+    Ring* grow(Ring* old, int64_t bottom, int64_t top);
+
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<Ring*> ring_;
+    std::vector<std::unique_ptr<Ring>> rings_;  // alle je benutzten arrays, nur besitzer fasst das an
+};
+
+// multi-producer queue für tasks von außerhalb des pools (Vyukov, intrusive)
+// push ist ein einziges xchg, lock-free. pop ist single-consumer -> worker
+// holen sich kurz das consumer lock (try_lock, bei konflikt halt woanders klauen)
+class InjectionQueue {
+public:
+    InjectionQueue() : head_(&stub_), tail_(&stub_) {}
+
+    void push(Task* task);
+    Task* try_pop();  // nullptr wenn leer oder grad ein anderer worker dran ist
+    bool empty() const;
+
+private:
+    Task* pop_locked();
+
+    struct Stub final : Task {
+        void run() override {}
+    };
+
+    alignas(64) std::atomic<Task*> head_;  // producer seite
+    alignas(64) Task* tail_;               // consumer seite, nur mit consumer_lock_
+    std::atomic_flag consumer_lock_ = ATOMIC_FLAG_INIT;
+    std::atomic<int64_t> count_{0};        // nur für empty(), eher zu groß als zu klein
+    Stub stub_;
+};
+
+} // namespace detail
+
 class ThreadPool {
 public:
-    explicit ThreadPool(size_t num_threads = 0);
+    // pin_cpus: worker i läuft nur auf pin_cpus[i % size], leer = scheduler entscheidet
+    explicit ThreadPool(size_t num_threads = 0, std::vector<int> pin_cpus = {});
     ~ThreadPool();
 
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
     // Enqueue a task and get a future for the result
     template<typename F, typename... Args>
     auto enqueue(F&& f, Args&&... args) -> std::future<decltype(f(args...))>;
 
+    // [begin, end) in stücken von grain an fn(lo, hi) verteilen, ohne future pro item.
+    // es gehen höchstens size() helfer-tasks raus, die sich die stücke selber holen.
+    // latch wird um 1 erhöht und runtergezählt sobald alles durch ist
+    template<typename Fn>
+    void enqueue_bulk(size_t begin, size_t end, size_t grain, Fn&& fn, Latch& latch);
+
+    // enqueue_bulk + wait. geht auch aus einem worker heraus (z.b. zeilen eines bildes),
+    // der aufrufer arbeitet dann selber mit statt zu blockieren
+    template<typename Fn>
+    void parallel_for(size_t begin, size_t end, size_t grain, Fn&& fn);
+
+    // auf einen latch warten. im worker: tasks abarbeiten bis er fertig ist
+    void wait(Latch& latch);
+
+    // pool des aktuellen worker threads, nullptr außerhalb
+    static ThreadPool* current() noexcept;
+
     // wieviele threads laufen
     size_t size() const noexcept { return workers_.size(); }
 
     // Wait for all tasks to complete
     void wait_all();
 
-    // wieviele tasks noch in der queue
+    // wieviele tasks noch nicht fertig sind (queued + laufend)
     size_t pending() const noexcept { return pending_tasks_.load(); }
 
+    // wie oft ein worker sich arbeit von nem anderen geholt hat (für -v)
+    uint64_t steals() const noexcept { return steals_.load(std::memory_order_relaxed); }
+
+    // nur die ersten n worker holen sich neue tasks, der rest schläft (min 1, max size()).
+    // laufende tasks werden fertig gemacht. für den concurrency controller
+    void set_active(size_t n);
+    size_t active() const noexcept { return active_.load(std::memory_order_relaxed); }
+
+    // wieviele worker wirklich festgepinnt sind (pinnen kann fehlschlagen)
+    size_t pinned() const noexcept { return pinned_.load(std::memory_order_relaxed); }
+
 private:
+    friend void detail::requeue(detail::RangeJob* job);
+
+    struct Worker {
+        detail::WorkDeque deque;
+    };
+
+    void submit(detail::Task* task);
+    void submit_injected(detail::Task* task);
+    void submit_range(detail::RangeJob* job);
+    // nested = parallel_for aus einem worker, siehe RangeJob
+    template<typename Fn>
+    void submit_bulk(size_t begin, size_t end, size_t grain, Fn&& fn, Latch& latch, bool nested);
+    void worker_loop(size_t index);
+    detail::Task* find_task(size_t index, uint64_t& rng, bool take_injected = true);
+    bool has_work() const;
+    void park();
+    void wake_one();
+    void finish_task();
+
     std::vector<std::thread> workers_;
-    std::queue<std::function<void()>> tasks_;
-    
-    mutable std::mutex queue_mutex_;
-    std::condition_variable condition_;
+    std::vector<std::unique_ptr<Worker>> queues_;
+    detail::InjectionQueue injection_;
+
+    // parken: eventcount, epoch wird bei jedem submit hochgezählt
+    std::mutex park_mutex_;
+    std::condition_variable park_cv_;
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<uint32_t> sleepers_{0};
+    std::condition_variable inactive_cv_;  // abgeschaltete worker, eigener cv damit sie kein notify_one schlucken
+    std::atomic<size_t> active_{0};
+
+    std::mutex done_mutex_;
     std::condition_variable done_condition_;
     std::atomic<bool> stop_{false};
     std::atomic<size_t> pending_tasks_{0};
+    std::atomic<uint64_t> steals_{0};
+    std::vector<int> pin_cpus_;
+    std::atomic<size_t> pinned_{0};
 };
 
 template<typename F, typename... Args>
 auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<decltype(f(args...))> {
     using return_type = decltype(f(args...));
-    
-    auto task = std::make_shared<std::packaged_task<return_type()>>(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-    );
-    
-    std::future<return_type> result = task->get_future();
-    
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        if (stop_) {
-            throw std::runtime_error("enqueue on stopped ThreadPool");
-        }
-        pending_tasks_++;
-        tasks_.emplace([task]() { (*task)(); });
+    auto bound = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
+    using task_type = detail::FutureTask<return_type, decltype(bound)>;
+
+    if (stop_) {
+        throw std::runtime_error("enqueue on stopped ThreadPool");
     }
-    
-    condition_.notify_one();
+
+    auto* task = new task_type(std::move(bound));
+    std::future<return_type> result = task->promise.get_future();
+    submit(task);
     return result;
 }
 
+template<typename Fn>
+void ThreadPool::enqueue_bulk(size_t begin, size_t end, size_t grain, Fn&& fn, Latch& latch) {
+    submit_bulk(begin, end, grain, std::forward<Fn>(fn), latch, false);
+}
+
+template<typename Fn>
+void ThreadPool::submit_bulk(size_t begin, size_t end, size_t grain, Fn&& fn, Latch& latch, bool nested) {
+    if (begin >= end) return;
+    if (stop_) {
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+    }
+    using job_type = detail::RangeJobFn<std::decay_t<Fn>>;
+    latch.add(1);
+    submit_range(new job_type(begin, end, std::max<size_t>(grain, 1), &latch, nested,
+                              std::decay_t<Fn>(std::forward<Fn>(fn))));
+}
+
+template<typename Fn>
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, Fn&& fn) {
+    if (begin >= end) return;
+    grain = std::max<size_t>(grain, 1);
+    // im worker mit nur einem stück (oder als einziger worker): direkt hier, ohne tasks.
+    // von außen geht immer alles in den pool, dann laufen auch verschachtelte
+    // parallel_for (zeilen im bild) auf den workern
+    if (current() == this && (end - begin <= grain || size() == 1)) {
+        fn(begin, end);
+        return;
+    }
+    Latch latch;
+    submit_bulk(begin, end, grain, [&fn](size_t lo, size_t hi) { fn(lo, hi); }, latch, current() == this);
+    wait(latch);
+}
+
 } // namespace squish
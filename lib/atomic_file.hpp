@@ -0,0 +1,384 @@
+// atomic_file.hpp - output datei die erst beim publish() unter ihrem namen auftaucht
+// linux: anonymes O_TMPFILE inode im zielordner, publish() hängt es per linkat ein.
+// kein umbenennen, kein extra verzeichniseintrag, und nach einem crash liegt kein
+// .tmp müll rum (das inode verschwindet mit dem letzten fd).
+// sonst (windows, macos, fs ohne O_TMPFILE): <ziel>.<pid>-<n>.tmp + rename wie früher,
+// aber mit eindeutigem namen - zwei inputs mit gleichem namen aus verschiedenen
+// ordnern haben sich vorher dasselbe .tmp geteilt
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace atomicfile {
+
+// wie ein unverändertes original (skip oder output größer geworden) im output landet.
+// reflink/copy_file_range kosten fast kein io, hardlink gar keins
+enum class CopyMethod : uint8_t {
+    None,
+    Reflink,    // FICLONE: btrfs, xfs, bcachefs - teilt die extents
+    CopyRange,  // copy_file_range: im kernel (nfs/smb: auf dem server)
+    Buffered,   // read/write durch userspace
+    Hardlink,   // --hardlink: gleiches inode wie der input
+};
+
+inline const char* copy_method_name(CopyMethod method) {
+    switch (method) {
+        case CopyMethod::Reflink: return "reflinked";
+        case CopyMethod::CopyRange: return "copy_file_range";
+        case CopyMethod::Buffered: return "copied";
+        case CopyMethod::Hardlink: return "hardlinked";
+        default: return "none";
+    }
+}
+
+class File {
+public:
+    File() = default;
+    ~File() { discard(); }
+
+    File(File&& other) noexcept
+        : fd_(other.fd_), anonymous_(other.anonymous_), target_(std::move(other.target_)),
+          temp_path_(std::move(other.temp_path_)) {
+        other.fd_ = -1;
+        other.temp_path_.clear();
+    }
+    File& operator=(File&& other) noexcept {
+        if (this != &other) {
+            discard();
+            fd_ = other.fd_;
+            anonymous_ = other.anonymous_;
+            target_ = std::move(other.target_);
+            temp_path_ = std::move(other.temp_path_);
+            other.fd_ = -1;
+            other.temp_path_.clear();
+        }
+        return *this;
+    }
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    // leeres file anlegen das später target wird. false = nicht mal das temp ging
+    bool open(const std::string& target) {
+        discard();
+        target_ = target;
+#if defined(__linux__) && defined(O_TMPFILE)
+        std::filesystem::path dir = std::filesystem::path(target).parent_path();
+        if (dir.empty()) dir = ".";
+        // EOPNOTSUPP/EISDIR/EINVAL: fs kann das nicht (nfs, fuse, alte kernel) -> mit namen
+        fd_ = ::open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0644);
+        if (fd_ >= 0) {
+            anonymous_ = true;
+            return true;
+        }
+#endif
+        anonymous_ = false;
+        temp_path_ = unique_temp_name(target);
+#ifdef _WIN32
+        fd_ = ::_open(temp_path_.c_str(), _O_RDWR | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        fd_ = ::open(temp_path_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+#endif
+        if (fd_ < 0) {
+            temp_path_.clear();
+            return false;
+        }
+        return true;
+    }
+
+    int fd() const { return fd_; }
+    bool is_open() const { return fd_ >= 0; }
+    bool anonymous() const { return anonymous_; }          // O_TMPFILE, hat noch keinen namen
+    const std::string& target() const { return target_; }
+    const std::string& temp_path() const { return temp_path_; }  // leer bei anonymous
+
+    // hinten dran schreiben (für encoder die in einen callback/speicher schreiben)
+    bool write(const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+#ifdef _WIN32
+            int n = ::_write(fd_, p, static_cast<unsigned>(size > (1u << 30) ? (1u << 30) : size));
+#else
+            ssize_t n = ::write(fd_, p, size);
+#endif
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // page cache umgehen (O_DIRECT, macOS F_NOCACHE). dann müssen buffer, offset und länge
+    // auf DIRECT_ALIGN liegen. false = geht hier nicht (tmpfs, windows), bleibt gepuffert
+    static constexpr size_t DIRECT_ALIGN = 4096;
+    bool set_direct(bool on) {
+#if defined(__linux__) && defined(O_DIRECT)
+        int flags = ::fcntl(fd_, F_GETFL);
+        if (flags < 0) return false;
+        flags = on ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+        return ::fcntl(fd_, F_SETFL, flags) == 0;
+#elif defined(__APPLE__)
+        return ::fcntl(fd_, F_NOCACHE, on ? 1 : 0) == 0;
+#else
+        (void)on;
+        return false;
+#endif
+    }
+
+    // wie groß das file gerade ist (nach encoder + truncate), 0 wenn unbekannt
+    uint64_t size() const {
+#ifdef _WIN32
+        long long n = ::_filelengthi64(fd_);
+        return n > 0 ? static_cast<uint64_t>(n) : 0;
+#else
+        struct stat st;
+        return ::fstat(fd_, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+#endif
+    }
+
+    // kompletten inhalt von src reinkopieren (file muss noch leer sein). erst reflink,
+    // dann copy_file_range, zuletzt read/write. None + ec = ging gar nicht
+    CopyMethod copy_from(const std::string& src, std::error_code& ec) {
+        ec.clear();
+#ifdef _WIN32
+        int in = ::_open(src.c_str(), _O_RDONLY | _O_BINARY);
+#else
+        int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+        if (in < 0) {
+            ec = std::error_code(errno, std::generic_category());
+            return CopyMethod::None;
+        }
+        CopyMethod method = CopyMethod::None;
+#if defined(__linux__) && defined(FICLONE)
+        // EXDEV/EOPNOTSUPP/EINVAL: anderes fs oder kann kein reflink
+        if (::ioctl(fd_, FICLONE, in) == 0) method = CopyMethod::Reflink;
+#endif
+#if defined(__linux__)
+        if (method == CopyMethod::None) {
+            bool any = false;
+            while (true) {
+                ssize_t n = ::copy_file_range(in, nullptr, fd_, nullptr, 1 << 30, 0);
+                if (n > 0) {
+                    any = true;
+                    continue;
+                }
+                if (n == 0) {
+                    method = CopyMethod::CopyRange;
+                } else if (errno == EINTR) {
+                    continue;
+                } else if (any) {
+                    // mittendrin kaputt: alles nochmal durch userspace
+                    ::lseek(in, 0, SEEK_SET);
+                    rewind();
+                }
+                break;
+            }
+        }
+#endif
+        if (method == CopyMethod::None) {
+            char buf[64 * 1024];
+            while (true) {
+#ifdef _WIN32
+                int n = ::_read(in, buf, sizeof(buf));
+#else
+                ssize_t n = ::read(in, buf, sizeof(buf));
+#endif
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 || (n > 0 && !write(buf, static_cast<size_t>(n)))) {
+                    ec = std::error_code(errno, std::generic_category());
+                    break;
+                }
+                if (n == 0) {
+                    method = CopyMethod::Buffered;
+                    break;
+                }
+            }
+        }
+#ifdef _WIN32
+        ::_close(in);
+#else
+        ::close(in);
+#endif
+        return method;
+    }
+
+    // daten (nicht unbedingt metadaten wie mtime) auf die platte, bevor der name kommt
+    bool sync_data() {
+#ifdef _WIN32
+        return ::_commit(fd_) == 0;
+#elif defined(__linux__)
+        return ::fdatasync(fd_) == 0;
+#else
+        return ::fsync(fd_) == 0;
+#endif
+    }
+
+    // verzeichnis syncen, damit neue namen (linkat/rename) einen stromausfall überleben.
+    // windows: NTFS journalt das selber, da gibts nix zu tun
+    static bool sync_dir(const std::string& dir) {
+#ifdef _WIN32
+        (void)dir;
+        return true;
+#else
+        int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) return false;
+        bool ok = ::fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+#endif
+    }
+
+    // alles geschriebene wegwerfen, wieder bei offset 0
+    bool rewind() {
+#ifdef _WIN32
+        return ::_chsize_s(fd_, 0) == 0 && ::_lseeki64(fd_, 0, SEEK_SET) == 0;
+#else
+        return ::ftruncate(fd_, 0) == 0 && ::lseek(fd_, 0, SEEK_SET) == 0;
+#endif
+    }
+
+    // unter target sichtbar machen und fd schließen. ein vorhandenes target wird ersetzt
+    // (linkat kann nicht überschreiben: dann unter temp namen einhängen + rename).
+    // bei fehler bleibt alles wie es war, discard() räumt auf
+    bool publish(std::error_code& ec) {
+        ec.clear();
+        if (fd_ < 0) {
+            ec = std::make_error_code(std::errc::bad_file_descriptor);
+            return false;
+        }
+        if (anonymous_) {
+#if defined(__linux__)
+            if (link_to(target_, ec)) {
+                close_fd();
+                return true;
+            }
+            if (ec != std::errc::file_exists) return false;
+            std::string temp = unique_temp_name(target_);
+            if (!link_to(temp, ec)) return false;
+            std::filesystem::rename(temp, target_, ec);
+            if (ec) {
+                std::error_code rm_ec;
+                std::filesystem::remove(temp, rm_ec);
+                return false;
+            }
+            close_fd();
+            return true;
+#endif
+        }
+        close_fd();
+        std::filesystem::rename(temp_path_, target_, ec);
+        if (ec) {
+            // rename ging nicht (cross-device?), dann kopieren
+            std::filesystem::copy_file(temp_path_, target_, std::filesystem::copy_options::overwrite_existing, ec);
+            if (ec) return false;
+            std::error_code rm_ec;
+            std::filesystem::remove(temp_path_, rm_ec);
+        }
+        temp_path_.clear();
+        return true;
+    }
+
+    // jemand anders (io_uring renameat/linkat) hat schon publiziert, nur noch fd zu
+    void published() {
+        close_fd();
+        temp_path_.clear();
+    }
+
+    // nicht publiziert: fd zu, benanntes temp löschen (anonymes verschwindet von selbst)
+    void discard() {
+        close_fd();
+        if (!temp_path_.empty()) {
+            std::error_code ec;
+            std::filesystem::remove(temp_path_, ec);
+            temp_path_.clear();
+        }
+    }
+
+    // pfad unter dem das offene fd per linkat(AT_SYMLINK_FOLLOW) erreichbar ist
+    static std::string proc_path(int fd) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "/proc/self/fd/%d", fd);
+        return buf;
+    }
+
+    // target als hardlink auf src (ersetzt ein vorhandenes target atomar).
+    // geht nur auf dem gleichen fs - EXDEV & co landen in ec, dann halt kopieren
+    static bool hardlink(const std::string& src, const std::string& target, std::error_code& ec) {
+        std::filesystem::create_hard_link(src, target, ec);
+        if (!ec) return true;
+        if (ec != std::errc::file_exists) return false;
+        std::string temp = unique_temp_name(target);
+        std::filesystem::create_hard_link(src, temp, ec);
+        if (ec) return false;
+        std::filesystem::rename(temp, target, ec);
+        // rename zwischen zwei links aufs gleiche inode macht nix (target war schon src)
+        std::error_code rm_ec;
+        std::filesystem::remove(temp, rm_ec);
+        return !ec;
+    }
+
+private:
+    static std::string unique_temp_name(const std::string& target) {
+        static std::atomic<uint64_t> counter{0};
+#ifdef _WIN32
+        long pid = static_cast<long>(::_getpid());
+#else
+        long pid = static_cast<long>(::getpid());
+#endif
+        return target + "." + std::to_string(pid) + "-" +
+               std::to_string(counter.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+    }
+
+#if defined(__linux__)
+    // über /proc darf jeder, AT_EMPTY_PATH braucht CAP_DAC_READ_SEARCH (ohne /proc aber die einzige wahl)
+    bool link_to(const std::string& name, std::error_code& ec) {
+        if (::linkat(AT_FDCWD, proc_path(fd_).c_str(), AT_FDCWD, name.c_str(), AT_SYMLINK_FOLLOW) == 0) return true;
+        int err = errno;
+        if (err == ENOENT && ::linkat(fd_, "", AT_FDCWD, name.c_str(), AT_EMPTY_PATH) == 0) return true;
+        if (err == ENOENT) err = errno;
+        ec = std::error_code(err, std::generic_category());
+        return false;
+    }
+#endif
+
+    void close_fd() {
+        if (fd_ < 0) return;
+#ifdef _WIN32
+        ::_close(fd_);
+#else
+        ::close(fd_);
+#endif
+        fd_ = -1;
+    }
+
+    int fd_ = -1;
+    bool anonymous_ = false;
+    std::string target_;
+    std::string temp_path_;
+};
+
+} // namespace atomicfile
@@ -0,0 +1,482 @@
+// buffer_pool.hpp - per-thread buffer pool mit size classes
+// bei tausenden kleinen bildern pro sekunde war malloc/free + page faults
+// plötzlich im profil ganz oben, also werden die buffer jetzt recycled
+// jeder thread hat seinen eigenen cache, kein lock im hot path
+// große blöcke (>= 4MB) kommen auf linux von huge pages wenns geht
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <bit>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace bufpool {
+
+// alle blöcke sind 64 byte aligned (cacheline + reicht für avx2/avx512)
+constexpr size_t ALIGNMENT = 64;
+constexpr size_t HEADER_SIZE = 64;
+
+// size classes: 64 byte, dann 4 stufen pro zweierpotenz (max 25% verschnitt)
+// bis 2GB, alles drüber geht direkt ans system
+constexpr size_t MIN_CLASS_SIZE = 64;
+constexpr int MIN_CLASS_SHIFT = 6;
+constexpr int MAX_CLASS_SHIFT = 30;
+constexpr int NUM_CLASSES = 1 + (MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1) * 4;
+constexpr uint32_t UNPOOLED_CLASS = 0xFFFFFFFFu;
+constexpr uint32_t BLOCK_MAGIC = 0x5351504Cu;  // "SQPL"
+
+// pro size class nicht mehr als das cachen, sonst hortet ein thread alles
+constexpr size_t MAX_BLOCKS_PER_CLASS = 8;
+
+// große frames (100MP = 300MB) mit 4K pages sind zehntausende page faults
+// + tlb misses in resize/dct, ab hier gibts huge pages wenn das system will
+constexpr size_t HUGE_PAGE_SIZE = 2ull * 1024 * 1024;
+constexpr size_t HUGE_THRESHOLD = 4ull * 1024 * 1024;
+constexpr size_t SMALL_PAGE_SIZE = 4096;
+
+// woher der block kommt, bestimmt wie er freigegeben wird
+enum class Backing : uint32_t {
+    Heap = 0,       // posix_memalign / _aligned_malloc
+    HugeTLB = 1,    // explizite hugetlbfs pages (MAP_HUGETLB)
+    THP = 2,        // anonymous mmap + madvise(MADV_HUGEPAGE)
+};
+
+inline uint32_t size_class(size_t size) {
+    if (size <= MIN_CLASS_SIZE) return 0;
+    // size-1 liegt in [2^p, 2^(p+1)), klasse = welches viertel davon
+    int p = static_cast<int>(std::bit_width(size - 1)) - 1;
+    if (p > MAX_CLASS_SHIFT) return UNPOOLED_CLASS;
+    size_t step = size_t(1) << (p - 2);
+    size_t k = ((size - 1) - (size_t(1) << p)) / step;
+    return static_cast<uint32_t>(1 + (p - MIN_CLASS_SHIFT) * 4 + k);
+}
+
+inline size_t class_size(uint32_t cls) {
+    if (cls == 0) return MIN_CLASS_SIZE;
+    int p = MIN_CLASS_SHIFT + static_cast<int>((cls - 1) / 4);
+    size_t k = (cls - 1) % 4;
+    return (size_t(1) << p) + (k + 1) * (size_t(1) << (p - 2));
+}
+
+// liegt direkt vor den nutzdaten, damit free() ohne größe auskommt (stbi braucht das)
+struct alignas(HEADER_SIZE) BlockHeader {
+    size_t capacity;      // nutzbare bytes hinter dem header
+    uint32_t size_class;
+    uint32_t magic;
+    BlockHeader* next;    // freelist link, nur gültig solange im cache
+    void* map_base;       // nur bei mmap backing: was munmap bekommt
+    size_t map_len;
+    const void* owner;    // thread cache der den block ausgegeben hat
+    Backing backing;
+};
+static_assert(sizeof(BlockHeader) == HEADER_SIZE, "header must be exactly one cacheline");
+
+inline BlockHeader* header_of(void* p) {
+    return reinterpret_cast<BlockHeader*>(static_cast<uint8_t*>(p) - HEADER_SIZE);
+}
+
+inline void* payload_of(BlockHeader* h) {
+    return reinterpret_cast<uint8_t*>(h) + HEADER_SIZE;
+}
+
+// ============================================================================
+// Stats - global aggregiert, relaxed atomics reichen für reporting
+// ============================================================================
+
+struct Stats {
+    uint64_t allocations = 0;   // alle anfragen
+    uint64_t hits = 0;          // aus dem thread cache bedient
+    uint64_t misses = 0;        // frisch vom system geholt
+    uint64_t bytes_reused = 0;  // summe der recycelten block größen
+    uint64_t releases = 0;      // blöcke die ans system zurück gingen (cache voll)
+    uint64_t hugetlb_allocs = 0;  // blöcke auf expliziten huge pages
+    uint64_t thp_allocs = 0;      // blöcke mit MADV_HUGEPAGE
+    uint64_t huge_bytes = 0;      // summe der huge page backed bytes
+    uint64_t foreign_frees = 0;   // von einem anderen thread freigegeben, am cache vorbei
+
+    double hit_rate() const {
+        return allocations ? static_cast<double>(hits) / allocations : 0.0;
+    }
+};
+
+namespace detail {
+
+inline std::atomic<uint64_t> g_allocations{0};
+inline std::atomic<uint64_t> g_hits{0};
+inline std::atomic<uint64_t> g_misses{0};
+inline std::atomic<uint64_t> g_bytes_reused{0};
+inline std::atomic<uint64_t> g_releases{0};
+inline std::atomic<uint64_t> g_hugetlb_allocs{0};
+inline std::atomic<uint64_t> g_thp_allocs{0};
+inline std::atomic<uint64_t> g_huge_bytes{0};
+inline std::atomic<uint64_t> g_foreign_frees{0};
+
+// obergrenze was ein thread im cache behalten darf
+inline std::atomic<size_t> g_thread_cache_limit{256ull * 1024 * 1024};
+
+// --no-huge-pages zum vergleichen
+inline std::atomic<bool> g_huge_pages_enabled{true};
+
+inline BlockHeader* init_header(void* mem, size_t capacity, Backing backing, void* map_base, size_t map_len) {
+    auto* h = static_cast<BlockHeader*>(mem);
+    h->capacity = capacity;
+    h->magic = BLOCK_MAGIC;
+    h->next = nullptr;
+    h->map_base = map_base;
+    h->map_len = map_len;
+    h->backing = backing;
+    return h;
+}
+
+#ifndef _WIN32
+// einmal nachschauen was der kernel kann, danach nur noch flags lesen
+struct HugePageSupport {
+    bool hugetlb = false;  // reservierte hugetlbfs pages vorhanden
+    bool thp = false;      // THP auf "always" oder "madvise"
+
+    HugePageSupport() {
+        char buf[128] = {};
+        int fd = ::open("/sys/kernel/mm/hugepages/hugepages-2048kB/free_hugepages", O_RDONLY);
+        if (fd >= 0) {
+            ssize_t n = ::read(fd, buf, sizeof(buf) - 1);
+            ::close(fd);
+            hugetlb = n > 0 && std::strtoul(buf, nullptr, 10) > 0;
+        }
+        std::memset(buf, 0, sizeof(buf));
+        fd = ::open("/sys/kernel/mm/transparent_hugepage/enabled", O_RDONLY);
+        if (fd >= 0) {
+            ssize_t n = ::read(fd, buf, sizeof(buf) - 1);
+            ::close(fd);
+            thp = n > 0 && (std::strstr(buf, "[always]") || std::strstr(buf, "[madvise]"));
+        }
+    }
+};
+
+inline const HugePageSupport& huge_page_support() {
+    static const HugePageSupport support;
+    return support;
+}
+
+inline size_t round_up(size_t v, size_t a) { return (v + a - 1) / a * a; }
+
+// explizite huge pages: schon 2MB aligned, schlägt sofort fehl wenn der pool leer ist.
+// größe fest auf 2MB, nicht die default hugepage größe: ist die 1GB, passen len und
+// munmap sonst nicht (EINVAL, mapping bleibt liegen) und support schaut eh auf den 2MB pool
+#if defined(MAP_HUGETLB) && !defined(MAP_HUGE_2MB) && defined(MAP_HUGE_SHIFT)
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+inline BlockHeader* hugetlb_alloc(size_t capacity) {
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_2MB)
+    size_t len = round_up(HEADER_SIZE + capacity, HUGE_PAGE_SIZE);
+    void* mem = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+    if (mem == MAP_FAILED) return nullptr;
+    g_hugetlb_allocs.fetch_add(1, std::memory_order_relaxed);
+    g_huge_bytes.fetch_add(len, std::memory_order_relaxed);
+    return init_header(mem, capacity, Backing::HugeTLB, mem, len);
+#else
+    (void)capacity;
+    return nullptr;
+#endif
+}
+
+// THP: 2MB aligned anonymous mapping, überstand vorne/hinten wieder abschneiden
+// damit khugepaged bzw. der fault handler direkt ganze huge pages nehmen kann
+inline BlockHeader* thp_alloc(size_t capacity) {
+    size_t need = round_up(HEADER_SIZE + capacity, SMALL_PAGE_SIZE);
+    size_t len = need + HUGE_PAGE_SIZE;
+    void* raw = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+
+    uintptr_t base = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = round_up(base, HUGE_PAGE_SIZE);
+    if (aligned > base) munmap(raw, aligned - base);
+    uintptr_t end = base + len;
+    if (end > aligned + need) munmap(reinterpret_cast<void*>(aligned + need), end - (aligned + need));
+
+    void* mem = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+    if (madvise(mem, need, MADV_HUGEPAGE) == 0) {
+        g_thp_allocs.fetch_add(1, std::memory_order_relaxed);
+        g_huge_bytes.fetch_add(need, std::memory_order_relaxed);
+    }
+#endif
+    return init_header(mem, capacity, Backing::THP, mem, need);
+}
+#endif
+
+inline BlockHeader* system_alloc(size_t capacity) {
+    size_t total = HEADER_SIZE + capacity;
+#ifndef _WIN32
+    // Windows large pages brauchen SeLockMemoryPrivilege, lohnt nicht - nur linux
+    if (total >= HUGE_THRESHOLD && g_huge_pages_enabled.load(std::memory_order_relaxed)) {
+        const auto& support = huge_page_support();
+        if (support.hugetlb) {
+            if (BlockHeader* h = hugetlb_alloc(capacity)) return h;
+        }
+        if (support.thp) {
+            if (BlockHeader* h = thp_alloc(capacity)) return h;
+        }
+        // sonst ganz normal vom heap, fallback ohne drama
+    }
+#endif
+#ifdef _WIN32
+    void* mem = _aligned_malloc(total, ALIGNMENT);
+#else
+    void* mem = nullptr;
+    if (posix_memalign(&mem, ALIGNMENT, total) != 0) mem = nullptr;
+#endif
+    if (!mem) return nullptr;
+    return init_header(mem, capacity, Backing::Heap, nullptr, 0);
+}
+
+inline void system_free(BlockHeader* h) {
+    h->magic = 0;
+#ifdef _WIN32
+    _aligned_free(h);
+#else
+    if (h->backing != Backing::Heap) {
+        munmap(h->map_base, h->map_len);
+        return;
+    }
+    free(h);
+#endif
+}
+
+struct ThreadCache {
+    BlockHeader* free_lists[NUM_CLASSES] = {};
+    uint32_t counts[NUM_CLASSES] = {};
+    size_t cached_bytes = 0;
+
+    ThreadCache() = default;
+    ThreadCache(const ThreadCache&) = delete;
+    ThreadCache& operator=(const ThreadCache&) = delete;
+
+    ~ThreadCache() { trim(); }
+
+    BlockHeader* pop(uint32_t cls) {
+        BlockHeader* h = free_lists[cls];
+        if (!h) return nullptr;
+        free_lists[cls] = h->next;
+        counts[cls]--;
+        cached_bytes -= h->capacity;
+        h->next = nullptr;
+        return h;
+    }
+
+    bool push(BlockHeader* h) {
+        uint32_t cls = h->size_class;
+        if (counts[cls] >= MAX_BLOCKS_PER_CLASS ||
+            cached_bytes + h->capacity > g_thread_cache_limit.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        h->next = free_lists[cls];
+        free_lists[cls] = h;
+        counts[cls]++;
+        cached_bytes += h->capacity;
+        return true;
+    }
+
+    void trim() {
+        for (int c = 0; c < NUM_CLASSES; c++) {
+            while (BlockHeader* h = free_lists[c]) {
+                free_lists[c] = h->next;
+                system_free(h);
+            }
+            counts[c] = 0;
+        }
+        cached_bytes = 0;
+    }
+};
+
+inline ThreadCache& thread_cache() {
+    thread_local ThreadCache cache;
+    return cache;
+}
+
+} // namespace detail
+
+// ============================================================================
+// malloc-artige API (auch als STBI_MALLOC/STBI_FREE benutzt)
+// ============================================================================
+
+inline void* allocate(size_t size) {
+    detail::g_allocations.fetch_add(1, std::memory_order_relaxed);
+    uint32_t cls = size_class(size);
+    detail::ThreadCache& cache = detail::thread_cache();
+
+    if (cls != UNPOOLED_CLASS) {
+        if (BlockHeader* h = cache.pop(cls)) {
+            detail::g_hits.fetch_add(1, std::memory_order_relaxed);
+            detail::g_bytes_reused.fetch_add(h->capacity, std::memory_order_relaxed);
+            return payload_of(h);
+        }
+    }
+
+    detail::g_misses.fetch_add(1, std::memory_order_relaxed);
+    size_t capacity = (cls != UNPOOLED_CLASS) ? class_size(cls) : size;
+    BlockHeader* h = detail::system_alloc(capacity);
+    if (!h) return nullptr;
+    h->size_class = cls;
+    h->owner = &cache;
+    return payload_of(h);
+}
+
+// nur der thread der den block geholt hat cached ihn wieder. in der pipeline geben
+// writer die kodierten bilder der worker frei und worker die input buffer der reader -
+// die würden im cache vom falschen thread liegen, der solche größen nie anfragt
+inline void deallocate(void* p) {
+    if (!p) return;
+    BlockHeader* h = header_of(p);
+    detail::ThreadCache& cache = detail::thread_cache();
+    if (h->size_class != UNPOOLED_CLASS && h->owner == &cache && cache.push(h)) {
+        return;
+    }
+    if (h->owner != &cache) detail::g_foreign_frees.fetch_add(1, std::memory_order_relaxed);
+    detail::g_releases.fetch_add(1, std::memory_order_relaxed);
+    detail::system_free(h);
+}
+
+// realloc semantik: passt es noch in den block bleibt der pointer gleich
+inline void* reallocate(void* p, size_t new_size) {
+    if (!p) return allocate(new_size);
+    BlockHeader* h = header_of(p);
+    if (new_size <= h->capacity) return p;
+    void* fresh = allocate(new_size);
+    if (!fresh) return nullptr;  // altes bleibt gültig, wie bei realloc
+    std::memcpy(fresh, p, h->capacity);
+    deallocate(p);
+    return fresh;
+}
+
+inline size_t capacity_of(const void* p) {
+    return p ? header_of(const_cast<void*>(p))->capacity : 0;
+}
+
+inline Stats stats() {
+    Stats s;
+    s.allocations = detail::g_allocations.load(std::memory_order_relaxed);
+    s.hits = detail::g_hits.load(std::memory_order_relaxed);
+    s.misses = detail::g_misses.load(std::memory_order_relaxed);
+    s.bytes_reused = detail::g_bytes_reused.load(std::memory_order_relaxed);
+    s.releases = detail::g_releases.load(std::memory_order_relaxed);
+    s.hugetlb_allocs = detail::g_hugetlb_allocs.load(std::memory_order_relaxed);
+    s.thp_allocs = detail::g_thp_allocs.load(std::memory_order_relaxed);
+    s.huge_bytes = detail::g_huge_bytes.load(std::memory_order_relaxed);
+    s.foreign_frees = detail::g_foreign_frees.load(std::memory_order_relaxed);
+    return s;
+}
+
+// wieviel ein einzelner thread maximal im cache halten darf
+inline void set_thread_cache_limit(size_t bytes) {
+    detail::g_thread_cache_limit.store(bytes, std::memory_order_relaxed);
+}
+
+// huge page backing für große blöcke an/aus (default an, fällt sauber auf heap zurück)
+inline void set_huge_pages(bool enabled) {
+    detail::g_huge_pages_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+// cache vom aktuellen thread ans system zurückgeben
+inline void trim_thread_cache() {
+    detail::thread_cache().trim();
+}
+
+// ============================================================================
+// RAII block für scratch speicher (encoder blöcke etc)
+// ============================================================================
+
+class Buffer {
+public:
+    Buffer() = default;
+    explicit Buffer(size_t size) : data_(static_cast<uint8_t*>(allocate(size))), size_(data_ ? size : 0) {}
+    ~Buffer() { deallocate(data_); }
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    Buffer(Buffer&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+    Buffer& operator=(Buffer&& other) noexcept {
+        if (this != &other) {
+            deallocate(data_);
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    // pointer der schon aus dem pool kommt übernehmen (z.b. stbi decode output)
+    static Buffer adopt(void* pool_ptr, size_t size) {
+        Buffer b;
+        b.data_ = static_cast<uint8_t*>(pool_ptr);
+        b.size_ = pool_ptr ? size : 0;
+        return b;
+    }
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    explicit operator bool() const { return data_ != nullptr; }
+
+    template<typename T>
+    T* as(size_t byte_offset = 0) { return reinterpret_cast<T*>(data_ + byte_offset); }
+
+private:
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// ============================================================================
+// std allocator - default-init statt zero-fill, die pixel werden eh überschrieben
+// ============================================================================
+
+template<typename T>
+struct Allocator {
+    using value_type = T;
+
+    Allocator() noexcept = default;
+    template<typename U>
+    Allocator(const Allocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        void* p = bufpool::allocate(n * sizeof(T));
+        if (!p) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t) noexcept { bufpool::deallocate(p); }
+
+    template<typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new (static_cast<void*>(p)) U;
+    }
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template<typename U>
+    bool operator==(const Allocator<U>&) const noexcept { return true; }
+    template<typename U>
+    bool operator!=(const Allocator<U>&) const noexcept { return false; }
+};
+
+template<typename T>
+using Vector = std::vector<T, Allocator<T>>;
+
+} // namespace bufpool
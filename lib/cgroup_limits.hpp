@@ -0,0 +1,321 @@
+// cgroup_limits.hpp - cpu/speicher limits vom container statt vom host
+// hardware_concurrency und /proc/meminfo sehen im pod den ganzen host: zu viele threads
+// -> CFS throttling, und MemAvailable sagt "genug da" obwohl memory.max gleich erreicht
+// ist -> OOM kill. hier wird cgroup v2 gelesen (cpu.max, cpuset.cpus.effective,
+// memory.max/current), v1 als fallback. was fehlt oder nicht lesbar ist = kein limit
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace cgroup {
+
+constexpr uint64_t UNLIMITED = UINT64_MAX;
+
+struct CpuLimits {
+    unsigned host = 0;       // hardware_concurrency
+    unsigned affinity = 0;   // sched_getaffinity, 0 = unbekannt
+    unsigned cpuset = 0;     // cpuset.cpus.effective, 0 = kein cpuset
+    double quota = 0.0;      // cpu.max quota/period in cpus, 0 = keine quota
+    unsigned effective = 1;  // minimum von allem, mind. 1
+    bool quota_bound = false; // effective kommt von der quota (nicht von cpus die's wirklich gibt)
+
+    bool limited() const { return effective < host; }
+};
+
+struct MemoryLimits {
+    uint64_t max = UNLIMITED;  // engstes memory.max auf dem weg zur wurzel
+    uint64_t current = 0;      // verbrauch in genau dieser cgroup
+    uint64_t reclaimable = 0;  // inactive_file, page cache den der kernel vorm OOM killer wegwirft
+
+    bool limited() const { return max != UNLIMITED; }
+
+    // was man noch allokieren kann bevor der OOM killer kommt
+    uint64_t available() const {
+        if (!limited()) return UNLIMITED;
+        uint64_t used = current > reclaimable ? current - reclaimable : 0;
+        return used < max ? max - used : 0;
+    }
+};
+
+namespace detail {
+
+// ab hier heißt v1 "kein limit" (LONG_MAX auf seitengröße abgerundet)
+constexpr uint64_t V1_UNLIMITED_THRESHOLD = 1ull << 62;
+
+struct Dirs {
+    std::string v2;       // leere strings = controller nicht gefunden
+    std::string v2_root;  // mountpoint, bis hier hoch werden eltern durchsucht
+    std::string cpu;      // v1
+    std::string cpuset;   // v1
+    std::string memory;   // v1
+};
+
+inline bool read_line(const std::string& path, std::string& out) {
+    std::ifstream f(path);
+    return f && std::getline(f, out);
+}
+
+// "max" (v2) -> UNLIMITED
+inline bool read_u64(const std::string& path, uint64_t& out) {
+    std::string line;
+    if (!read_line(path, line)) return false;
+    if (line.compare(0, 3, "max") == 0) { out = UNLIMITED; return true; }
+    try { out = std::stoull(line); } catch (...) { return false; }
+    return true;
+}
+
+// "key value" zeilen (memory.stat)
+inline bool read_stat(const std::string& path, const char* key, uint64_t& out) {
+    std::ifstream f(path);
+    std::string k;
+    uint64_t v;
+    while (f >> k >> v) {
+        if (k == key) { out = v; return true; }
+    }
+    return false;
+}
+
+// "0-3,8,10-11" -> 7
+inline unsigned count_cpu_list(const std::string& list) {
+    unsigned n = 0;
+    std::stringstream ss(list);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        if (part.empty()) continue;
+        try {
+            size_t dash = part.find('-');
+            if (dash == std::string::npos) {
+                std::stoul(part);
+                n += 1;
+            } else {
+                unsigned long lo = std::stoul(part.substr(0, dash));
+                unsigned long hi = std::stoul(part.substr(dash + 1));
+                if (hi >= lo) n += static_cast<unsigned>(hi - lo + 1);
+            }
+        } catch (...) {
+            return 0;
+        }
+    }
+    return n;
+}
+
+// cpu.max: "quota period" -> quota/period cpus. "max period" oder kaputt -> false
+inline bool parse_cpu_max(const std::string& line, double& cpus) {
+    std::istringstream in(line);
+    std::string quota;
+    double period = 0;
+    if (!(in >> quota >> period) || quota == "max" || period <= 0) return false;
+    try { cpus = std::stod(quota) / period; } catch (...) { return false; }
+    return cpus > 0;
+}
+
+inline bool has_token(const std::string& csv, const std::string& token) {
+    std::stringstream ss(csv);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        if (part == token) return true;
+    }
+    return false;
+}
+
+// mountpoint + pfad der cgroup relativ zur mount-wurzel. ohne cgroup namespace
+// sieht man im container den host pfad, der unter dem mountpoint nicht existiert -
+// dann ist der mountpoint selbst die eigene cgroup
+inline std::string join_cgroup(const std::string& mount_root, const std::string& mount_point,
+                               const std::string& path) {
+    std::string rel = path;
+    if (mount_root != "/" && rel.compare(0, mount_root.size(), mount_root) == 0) {
+        rel = rel.substr(mount_root.size());
+    }
+    std::string dir = mount_point;
+    if (!rel.empty() && rel != "/") dir += rel;
+    if (dir != mount_point && !std::ifstream(dir + "/cgroup.procs")) return mount_point;
+    return dir;
+}
+
+inline Dirs find_dirs() {
+    Dirs d;
+#ifdef __linux__
+    // /proc/self/cgroup: "id:controller,liste:pfad", v2 ist "0::pfad"
+    std::string v2_path;
+    std::vector<std::pair<std::string, std::string>> v1_paths;
+    {
+        std::ifstream f("/proc/self/cgroup");
+        std::string line;
+        while (std::getline(f, line)) {
+            size_t a = line.find(':');
+            size_t b = a == std::string::npos ? a : line.find(':', a + 1);
+            if (b == std::string::npos) continue;
+            std::string controllers = line.substr(a + 1, b - a - 1);
+            std::string path = line.substr(b + 1);
+            if (controllers.empty()) v2_path = path;
+            else v1_paths.emplace_back(controllers, path);
+        }
+    }
+
+    // mountinfo: "id parent maj:min root mountpoint opts... - fstype source superopts"
+    std::ifstream f("/proc/self/mountinfo");
+    std::string line;
+    while (std::getline(f, line)) {
+        size_t sep = line.find(" - ");
+        if (sep == std::string::npos) continue;
+        std::istringstream pre(line.substr(0, sep));
+        std::istringstream post(line.substr(sep + 3));
+        std::string id, parent, dev, root, mount_point, fstype, source, super_opts;
+        if (!(pre >> id >> parent >> dev >> root >> mount_point)) continue;
+        if (!(post >> fstype >> source >> super_opts)) continue;
+
+        if (fstype == "cgroup2" && d.v2.empty()) {
+            d.v2_root = mount_point;
+            d.v2 = join_cgroup(root, mount_point, v2_path.empty() ? "/" : v2_path);
+        } else if (fstype == "cgroup") {
+            for (const auto& [controllers, path] : v1_paths) {
+                auto take = [&](const char* name, std::string& dir) {
+                    if (dir.empty() && has_token(controllers, name) && has_token(super_opts, name)) {
+                        dir = join_cgroup(root, mount_point, path);
+                    }
+                };
+                take("cpu", d.cpu);
+                take("cpuset", d.cpuset);
+                take("memory", d.memory);
+            }
+        }
+    }
+#endif
+    return d;
+}
+
+// pfade ändern sich zur laufzeit nicht, einmal suchen reicht
+inline const Dirs& dirs() {
+    static const Dirs d = find_dirs();
+    return d;
+}
+
+// von der eigenen cgroup bis zum mountpoint hoch, fn(dir) für jede ebene
+template<typename Fn>
+inline void for_each_level(const Dirs& d, Fn&& fn) {
+    std::string dir = d.v2;
+    while (!dir.empty()) {
+        fn(dir);
+        if (dir.size() <= d.v2_root.size()) break;
+        size_t slash = dir.rfind('/');
+        if (slash == std::string::npos || slash < d.v2_root.size()) break;
+        dir.resize(slash);
+    }
+}
+
+} // namespace detail
+
+inline CpuLimits cpu_limits() {
+    CpuLimits c;
+    c.host = std::thread::hardware_concurrency();
+    if (c.host == 0) c.host = 4;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        c.affinity = static_cast<unsigned>(CPU_COUNT(&set));
+    }
+
+    const auto& d = detail::dirs();
+    std::string line;
+    bool have_quota = false;
+    if (!d.v2.empty()) {
+        // cpu.max: "quota period" oder "max period", engste ebene gewinnt
+        detail::for_each_level(d, [&](const std::string& dir) {
+            std::string l;
+            if (!detail::read_line(dir + "/cpu.max", l)) return;
+            have_quota = true;
+            double cpus;
+            if (detail::parse_cpu_max(l, cpus) && (c.quota == 0.0 || cpus < c.quota)) c.quota = cpus;
+        });
+        if (detail::read_line(d.v2 + "/cpuset.cpus.effective", line)) {
+            c.cpuset = detail::count_cpu_list(line);
+        }
+    }
+    if (!have_quota && !d.cpu.empty()) {
+        std::string q, p;
+        if (detail::read_line(d.cpu + "/cpu.cfs_quota_us", q) &&
+            detail::read_line(d.cpu + "/cpu.cfs_period_us", p)) {
+            try {
+                double quota = std::stod(q), period = std::stod(p);
+                if (quota > 0 && period > 0) c.quota = quota / period;
+            } catch (...) {}
+        }
+    }
+    if (c.cpuset == 0 && !d.cpuset.empty()) {
+        if (detail::read_line(d.cpuset + "/cpuset.effective_cpus", line) ||
+            detail::read_line(d.cpuset + "/cpuset.cpus", line)) {
+            c.cpuset = detail::count_cpu_list(line);
+        }
+    }
+#endif
+
+    unsigned cpus = c.host;
+    if (c.affinity) cpus = std::min(cpus, c.affinity);
+    if (c.cpuset) cpus = std::min(cpus, c.cpuset);
+    // angefangene cpu aufrunden wie die go/jvm runtimes, 1.5 cpus -> 2 threads
+    if (c.quota > 0.0) {
+        unsigned q = std::max(1u, static_cast<unsigned>(std::ceil(c.quota - 1e-9)));
+        if (q < cpus) {
+            cpus = q;
+            c.quota_bound = true;
+        }
+    }
+    c.effective = std::max(1u, cpus);
+    return c;
+}
+
+// jedes mal neu lesen, current ändert sich ja ständig (2-3 kleine reads aus sysfs)
+inline MemoryLimits memory_limits() {
+    MemoryLimits m;
+#ifdef __linux__
+    const auto& d = detail::dirs();
+    bool have_v2 = false;
+    if (!d.v2.empty()) {
+        // die ebene mit am wenigsten luft zählt (pod limit kann enger sein als container)
+        uint64_t best = UNLIMITED;
+        detail::for_each_level(d, [&](const std::string& dir) {
+            uint64_t max;
+            if (!detail::read_u64(dir + "/memory.max", max)) return;
+            have_v2 = true;
+            if (max == UNLIMITED) return;
+            MemoryLimits level;
+            level.max = max;
+            detail::read_u64(dir + "/memory.current", level.current);
+            detail::read_stat(dir + "/memory.stat", "inactive_file", level.reclaimable);
+            if (level.available() < best) {
+                best = level.available();
+                m = level;
+            }
+        });
+    }
+    if (!have_v2 && !d.memory.empty()) {
+        uint64_t max = UNLIMITED, hier = UNLIMITED;
+        detail::read_u64(d.memory + "/memory.limit_in_bytes", max);
+        // v1 rechnet eltern limits schon zusammen
+        detail::read_stat(d.memory + "/memory.stat", "hierarchical_memory_limit", hier);
+        max = std::min(max, hier);
+        if (max < detail::V1_UNLIMITED_THRESHOLD) {
+            m.max = max;
+            detail::read_u64(d.memory + "/memory.usage_in_bytes", m.current);
+            detail::read_stat(d.memory + "/memory.stat", "total_inactive_file", m.reclaimable);
+        }
+    }
+#endif
+    return m;
+}
+
+} // namespace cgroup
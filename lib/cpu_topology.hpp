@@ -0,0 +1,208 @@
+// cpu_topology.hpp - physische kerne, SMT geschwister, cache domains, P/E kerne
+// statt "75% der logischen cores" raten: aus /sys/devices/system/cpu lesen wieviele
+// echte kerne wir haben (nur die, auf denen der prozess laufen darf) und in welcher
+// reihenfolge man worker drauf pinnen sollte. ohne sysfs (windows, mac) = unbekannt
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+namespace cputopo {
+
+struct Cpu {
+    int id = 0;
+    int core = 0;              // kleinste cpu id im selben physischen kern (SMT geschwister)
+    int cache = 0;             // kleinste cpu id die sich den last level cache teilt
+    bool efficiency = false;   // E-core (intel hybrid) bzw. LITTLE (arm)
+};
+
+struct Topology {
+    std::vector<Cpu> cpus;     // nur erlaubte cpus (affinity/cpuset), nach id sortiert
+    unsigned cores = 0;        // physische kerne darunter
+    unsigned efficiency_cores = 0;
+    unsigned cache_domains = 0;
+
+    bool known() const { return !cpus.empty(); }
+    unsigned logical() const { return static_cast<unsigned>(cpus.size()); }
+    bool smt() const { return logical() > cores; }
+
+    // reihenfolge für worker pinning: erst ein thread pro physischem kern
+    // (P vor E, reihum über die cache domains damit jeder worker möglichst viel
+    // L3 für sich hat), danach die SMT geschwister
+    std::vector<int> pin_order() const {
+        struct Core {
+            std::vector<int> threads;
+            int id = 0;
+            int cache = 0;
+            bool efficiency = false;
+            int slot = 0;  // wievielter kern in seiner cache domain
+        };
+        std::map<int, Core> by_core;
+        for (const Cpu& c : cpus) {
+            Core& core = by_core[c.core];
+            core.id = c.core;
+            core.cache = c.cache;
+            core.efficiency = core.efficiency || c.efficiency;
+            core.threads.push_back(c.id);
+        }
+        std::map<int, int> per_cache;
+        std::vector<Core> list;
+        size_t max_threads = 0;
+        for (auto& [id, core] : by_core) {
+            core.slot = per_cache[core.cache]++;
+            max_threads = std::max(max_threads, core.threads.size());
+            list.push_back(core);
+        }
+        std::sort(list.begin(), list.end(), [](const Core& a, const Core& b) {
+            if (a.efficiency != b.efficiency) return !a.efficiency;
+            if (a.slot != b.slot) return a.slot < b.slot;
+            if (a.cache != b.cache) return a.cache < b.cache;
+            return a.id < b.id;
+        });
+
+        std::vector<int> order;
+        order.reserve(cpus.size());
+        for (size_t rank = 0; rank < max_threads; rank++) {
+            for (const Core& core : list) {
+                if (rank < core.threads.size()) order.push_back(core.threads[rank]);
+            }
+        }
+        return order;
+    }
+};
+
+namespace detail {
+
+// "0-3,8,10-11" -> {0,1,2,3,8,10,11}
+inline std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> ids;
+    std::stringstream ss(list);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        if (part.empty() || part == "\n") continue;
+        try {
+            size_t dash = part.find('-');
+            int lo = std::stoi(part.substr(0, dash));
+            int hi = dash == std::string::npos ? lo : std::stoi(part.substr(dash + 1));
+            for (int i = lo; i <= hi; i++) ids.push_back(i);
+        } catch (...) {
+            return {};
+        }
+    }
+    return ids;
+}
+
+inline bool read_line(const std::string& path, std::string& out) {
+    std::ifstream f(path);
+    return f && std::getline(f, out);
+}
+
+inline int min_of_list(const std::string& path, int fallback) {
+    std::string line;
+    if (!read_line(path, line)) return fallback;
+    std::vector<int> ids = parse_cpu_list(line);
+    return ids.empty() ? fallback : *std::min_element(ids.begin(), ids.end());
+}
+
+} // namespace detail
+
+inline Topology detect() {
+    Topology t;
+#ifdef __linux__
+    const std::string base = "/sys/devices/system/cpu/";
+    std::string line;
+    if (!detail::read_line(base + "online", line)) return t;
+    std::vector<int> online = detail::parse_cpu_list(line);
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool have_affinity = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    // intel hybrid: E-cores stehen in cpu_atom/cpus. arm: kleinere cpu_capacity = LITTLE
+    std::vector<int> atoms;
+    if (detail::read_line("/sys/devices/cpu_atom/cpus", line)) atoms = detail::parse_cpu_list(line);
+    std::map<int, long> capacity;
+    long max_capacity = 0;
+
+    for (int id : online) {
+        if (have_affinity && (id >= CPU_SETSIZE || !CPU_ISSET(id, &allowed))) continue;
+        const std::string dir = base + "cpu" + std::to_string(id) + "/";
+        Cpu c;
+        c.id = id;
+        // core_cpus_list ist der neue name, thread_siblings_list gibts überall
+        c.core = detail::min_of_list(dir + "topology/core_cpus_list",
+                 detail::min_of_list(dir + "topology/thread_siblings_list", id));
+        // höchstes cache level das unified ist = LLC
+        c.cache = id;
+        int best_level = 0;
+        for (int index = 0; index < 8; index++) {
+            const std::string cache = dir + "cache/index" + std::to_string(index) + "/";
+            std::string level, type;
+            if (!detail::read_line(cache + "level", level)) break;
+            if (!detail::read_line(cache + "type", type) || type == "Instruction") continue;
+            int lvl = std::atoi(level.c_str());
+            if (lvl > best_level) {
+                best_level = lvl;
+                c.cache = detail::min_of_list(cache + "shared_cpu_list", id);
+            }
+        }
+        c.efficiency = std::find(atoms.begin(), atoms.end(), id) != atoms.end();
+        if (detail::read_line(dir + "cpu_capacity", line)) {
+            long cap = std::atol(line.c_str());
+            capacity[id] = cap;
+            max_capacity = std::max(max_capacity, cap);
+        }
+        t.cpus.push_back(c);
+    }
+    for (Cpu& c : t.cpus) {
+        auto it = capacity.find(c.id);
+        if (atoms.empty() && it != capacity.end() && it->second < max_capacity) c.efficiency = true;
+    }
+
+    std::map<int, bool> cores;
+    std::map<int, bool> caches;
+    for (const Cpu& c : t.cpus) {
+        cores[c.core] = c.efficiency;
+        caches[c.cache] = true;
+    }
+    t.cores = static_cast<unsigned>(cores.size());
+    for (const auto& [core, efficiency] : cores) {
+        if (efficiency) t.efficiency_cores++;
+    }
+    t.cache_domains = static_cast<unsigned>(caches.size());
+#endif
+    return t;
+}
+
+// aktuellen thread auf eine cpu festnageln. false wenns nicht geht (z.b. cpu weg)
+inline bool pin_current_thread(int cpu) {
+#ifdef _WIN32
+    if (cpu < 0 || cpu >= 64) return false;
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+} // namespace cputopo
@@ -6,7 +6,26 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
-#include <vector>
+#include "image_view.hpp"
+
+// ssse3 reicht für die 3/4 kanal shuffles (baseline ist eh x86-64-v2 / -msse4.1)
+// avx2 8x8 transpose nur per runtime check, wie in fast_jpeg
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__SSSE3__) || defined(_MSC_VER))
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+    #define EXIF_ORIENT_SIMD 1
+    #if defined(__GNUC__) || defined(__clang__)
+        #define EXIF_AVX2_TARGET __attribute__((target("avx2")))
+    #else
+        #define EXIF_AVX2_TARGET
+    #endif
+#else
+    #define EXIF_ORIENT_SIMD 0
+#endif
 
 namespace exif {
 
@@ -167,133 +186,355 @@ inline int read_jpeg_orientation(const char* filename) {
     return read_jpeg_orientation_mem(buf, len);
 }
 
-// Apply orientation transform to pixel data
-// Returns true if dimensions were swapped (90/270 rotation)
-// For 3-channel RGB only
-inline bool apply_orientation(
-    std::vector<uint8_t>& pixels,
-    int& width, int& height,
-    int orientation,
-    int channels = 3
-) {
-    if (orientation == 1 || orientation < 1 || orientation > 8) {
-        return false;  // Normal or invalid - no transform needed
+// 5-8 tauschen breite und höhe
+inline bool swaps_dimensions(int orientation) {
+    return orientation >= 5 && orientation <= 8;
+}
+
+// gedrehte sicht auf ein ungedrehtes bild, ohne kopie
+// (x,y) im view = pixel nach anwenden der orientation. stride/pixel_step
+// können negativ sein bzw. bei 5-8 vertauscht (pixel_step = zeile, stride = pixel).
+// resize und jpeg encoder lesen da direkt durch, dann spart man den dreh-pass
+inline imgview::ConstView oriented_view(imgview::ConstView stored, int orientation) {
+    if (orientation < 2 || orientation > 8) return stored;
+
+    const int w = stored.width;
+    const int h = stored.height;
+    const ptrdiff_t pb = stored.step();
+    const ptrdiff_t s = stored.stride;
+
+    imgview::ConstView v = stored;
+    if (swaps_dimensions(orientation)) {
+        v.width = h;
+        v.height = w;
     }
-    
-    size_t pixel_size = channels;
-    size_t row_size = width * pixel_size;
-    std::vector<uint8_t> temp;
-    
-    auto get_pixel = [&](int x, int y) -> const uint8_t* {
-        return pixels.data() + y * row_size + x * pixel_size;
-    };
-    
-    auto set_pixel = [&](uint8_t* dst, const uint8_t* src) {
-        for (int c = 0; c < channels; c++) dst[c] = src[c];
-    };
-    
+    ptrdiff_t origin = 0;
     switch (orientation) {
-        case 2: {  // Flip horizontal
-            for (int y = 0; y < height; y++) {
-                for (int x = 0; x < width / 2; x++) {
-                    int x2 = width - 1 - x;
-                    uint8_t* p1 = pixels.data() + y * row_size + x * pixel_size;
-                    uint8_t* p2 = pixels.data() + y * row_size + x2 * pixel_size;
-                    for (int c = 0; c < channels; c++) {
-                        std::swap(p1[c], p2[c]);
-                    }
-                }
-            }
-            return false;
+        case 2: origin = (w - 1) * pb;                v.pixel_step = -pb; v.stride = s;   break;
+        case 3: origin = (h - 1) * s + (w - 1) * pb;  v.pixel_step = -pb; v.stride = -s;  break;
+        case 4: origin = (h - 1) * s;                 v.pixel_step = pb;  v.stride = -s;  break;
+        case 5: origin = 0;                           v.pixel_step = s;   v.stride = pb;  break;
+        case 6: origin = (h - 1) * s;                 v.pixel_step = -s;  v.stride = pb;  break;
+        case 7: origin = (h - 1) * s + (w - 1) * pb;  v.pixel_step = -s;  v.stride = -pb; break;
+        case 8: origin = (w - 1) * pb;                v.pixel_step = s;   v.stride = -pb; break;
+    }
+    v.data = stored.data + origin;
+    return v;
+}
+
+namespace detail {
+
+// kachelgröße in pixeln. 32x32 x 4 bytes = 4kb pro seite, src und dst kachel
+// passen zusammen locker in L1. ohne kacheln läuft 90/270 grad spaltenweise
+// durchs ziel und jeder pixel ist ein cache miss
+constexpr int ORIENT_TILE = 32;
+
+// zielpixel von src (x,y) = origin + x*step_x + y*step_y (in bytes)
+struct OrientMap {
+    ptrdiff_t origin = 0;
+    ptrdiff_t step_x = 0;
+    ptrdiff_t step_y = 0;
+};
+
+inline OrientMap orient_map(int orientation, int width, int height, ptrdiff_t pb, ptrdiff_t ds) {
+    OrientMap m;
+    switch (orientation) {
+        case 2:  // Flip horizontal
+            m.origin = (width - 1) * pb; m.step_x = -pb; m.step_y = ds; break;
+        case 3:  // Rotate 180
+            m.origin = (height - 1) * ds + (width - 1) * pb; m.step_x = -pb; m.step_y = -ds; break;
+        case 4:  // Flip vertical
+            m.origin = (height - 1) * ds; m.step_x = pb; m.step_y = -ds; break;
+        case 5:  // Transpose (flip H + rotate 270)
+            m.origin = 0; m.step_x = ds; m.step_y = pb; break;
+        case 6:  // Rotate 90 CW
+            m.origin = (height - 1) * pb; m.step_x = ds; m.step_y = -pb; break;
+        case 7:  // Transverse (flip H + rotate 90)
+            m.origin = (width - 1) * ds + (height - 1) * pb; m.step_x = -ds; m.step_y = -pb; break;
+        case 8:  // Rotate 270 CW (90 CCW)
+            m.origin = (width - 1) * ds; m.step_x = -ds; m.step_y = pb; break;
+    }
+    return m;
+}
+
+// skalarer pfad für ein rechteck [x0,x1) x [y0,y1) der quelle
+// für 1/2 kanäle und die ränder die nicht in einen simd block passen
+template<int CH>
+inline void orient_rect_scalar(imgview::ConstView src, uint8_t* dst, const OrientMap& m,
+                               int x0, int x1, int y0, int y1) {
+    for (int y = y0; y < y1; y++) {
+        const uint8_t* in = src.row(y) + x0 * CH;
+        uint8_t* out = dst + m.origin + x0 * m.step_x + y * m.step_y;
+        for (int x = x0; x < x1; x++) {
+            std::memcpy(out, in, CH);
+            in += CH;
+            out += m.step_x;
         }
-        
-        case 3: {  // Rotate 180
-            size_t size = pixels.size();
-            for (size_t i = 0; i < size / 2; i += pixel_size) {
-                size_t j = size - pixel_size - i;
-                for (int c = 0; c < channels; c++) {
-                    std::swap(pixels[i + c], pixels[j + c]);
+    }
+}
+
+inline void orient_rect_scalar_any(imgview::ConstView src, uint8_t* dst, const OrientMap& m,
+                                   int x0, int x1, int y0, int y1) {
+    switch (src.channels) {
+        case 1: orient_rect_scalar<1>(src, dst, m, x0, x1, y0, y1); break;
+        case 2: orient_rect_scalar<2>(src, dst, m, x0, x1, y0, y1); break;
+        case 3: orient_rect_scalar<3>(src, dst, m, x0, x1, y0, y1); break;
+        case 4: orient_rect_scalar<4>(src, dst, m, x0, x1, y0, y1); break;
+        default: {
+            const int ch = src.channels;
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* in = src.row(y) + x0 * ch;
+                uint8_t* out = dst + m.origin + x0 * m.step_x + y * m.step_y;
+                for (int x = x0; x < x1; x++) {
+                    for (int c = 0; c < ch; c++) out[c] = in[c];
+                    in += ch;
+                    out += m.step_x;
                 }
             }
-            return false;
-        }
-        
-        case 4: {  // Flip vertical
-            temp.resize(row_size);
-            for (int y = 0; y < height / 2; y++) {
-                int y2 = height - 1 - y;
-                uint8_t* row1 = pixels.data() + y * row_size;
-                uint8_t* row2 = pixels.data() + y2 * row_size;
-                memcpy(temp.data(), row1, row_size);
-                memcpy(row1, row2, row_size);
-                memcpy(row2, temp.data(), row_size);
-            }
-            return false;
         }
-        
-        case 5: {  // Transpose (flip H + rotate 270)
-            temp.resize(height * width * pixel_size);
-            for (int y = 0; y < height; y++) {
-                for (int x = 0; x < width; x++) {
-                    set_pixel(temp.data() + x * height * pixel_size + y * pixel_size,
-                              get_pixel(x, y));
+    }
+}
+
+#if EXIF_ORIENT_SIMD
+
+inline bool orient_cpu_has_avx2() {
+    static const bool has = [] {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+        return (ebx & (1 << 5)) != 0;
+#endif
+    }();
+    return has;
+}
+
+// 3 byte pixel <-> 32 bit lanes, dann sind 3 und 4 kanäle derselbe transpose
+inline __m128i rgb_expand(__m128i v) {
+    const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    return _mm_shuffle_epi8(v, mask);
+}
+
+inline __m128i rgb_compact(__m128i v) {
+    const __m128i mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    return _mm_shuffle_epi8(v, mask);
+}
+
+inline void store_rgb4(uint8_t* p, __m128i v) {
+    v = rgb_compact(v);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(p), v);
+    uint32_t tail = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+    std::memcpy(p + 8, &tail, 4);
+}
+
+inline __m128i reverse_px4(__m128i v) {
+    return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+// 4x4 pixel block transponieren, CH = 3 oder 4
+// quelle: 4 zeilen ab (x,y), ziel: spalte x+j landet als 4 pixel am stück
+// bei step_y < 0 läuft y im ziel rückwärts -> lanes umdrehen
+template<int CH>
+inline void orient_block4(imgview::ConstView src, uint8_t* dst, const OrientMap& m, int x, int y) {
+    __m128i r[4];
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.row(y + i) + x * CH));
+        r[i] = CH == 3 ? rgb_expand(v) : v;
+    }
+    __m128i t0 = _mm_unpacklo_epi32(r[0], r[1]);
+    __m128i t1 = _mm_unpacklo_epi32(r[2], r[3]);
+    __m128i t2 = _mm_unpackhi_epi32(r[0], r[1]);
+    __m128i t3 = _mm_unpackhi_epi32(r[2], r[3]);
+    __m128i c[4] = {
+        _mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1),
+        _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)
+    };
+    const bool rev = m.step_y < 0;
+    const ptrdiff_t base = m.origin + (rev ? (y + 3) : y) * m.step_y;
+    for (int j = 0; j < 4; j++) {
+        __m128i v = rev ? reverse_px4(c[j]) : c[j];
+        uint8_t* out = dst + base + (x + j) * m.step_x;
+        if (CH == 3) store_rgb4(out, v);
+        else _mm_storeu_si128(reinterpret_cast<__m128i*>(out), v);
+    }
+}
+
+// 8x8 block mit avx2, nur 4 kanäle (rgba) - 8 pixel = genau ein ymm register
+EXIF_AVX2_TARGET
+inline void orient_block8_rgba_avx2(imgview::ConstView src, uint8_t* dst, const OrientMap& m, int x, int y) {
+    __m256i r[8];
+    for (int i = 0; i < 8; i++) {
+        r[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src.row(y + i) + x * 4));
+    }
+    __m256i t[8], u[8];
+    for (int i = 0; i < 8; i += 2) {
+        t[i]     = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        u[i]     = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    __m256i c[8];
+    for (int i = 0; i < 4; i++) {
+        c[i]     = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+        c[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+    const bool rev = m.step_y < 0;
+    const __m256i rev_idx = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const ptrdiff_t base = m.origin + (rev ? (y + 7) : y) * m.step_y;
+    for (int j = 0; j < 8; j++) {
+        __m256i v = rev ? _mm256_permutevar8x32_epi32(c[j], rev_idx) : c[j];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + base + (x + j) * m.step_x), v);
+    }
+}
+
+// 90/270/transpose: kachelweise, innen 4x4 (sse) bzw 8x8 (avx2) blöcke
+// bei 3 kanälen liest der 16 byte load 4 bytes über den block hinaus,
+// deshalb simd nur solange noch 6 pixel in der zeile sind
+// [y_begin, y_end) = quellzeilen, y_begin auf ORIENT_TILE ausgerichtet. jede kachelzeile
+// landet in eigenen zielspalten, bänder können also parallel laufen
+template<int CH>
+inline void orient_transpose_tiled(imgview::ConstView src, uint8_t* dst, const OrientMap& m,
+                                   int y_begin, int y_end) {
+    const int width = src.width;
+    const int height = y_end;
+    const bool avx2 = CH == 4 && orient_cpu_has_avx2();
+    const int blk = avx2 ? 8 : 4;
+    const int simd_w = CH == 3 ? width - 2 : width;  // x + blk <= simd_w
+
+    for (int ty = y_begin; ty < height; ty += ORIENT_TILE) {
+        const int ty1 = ty + ORIENT_TILE < height ? ty + ORIENT_TILE : height;
+        for (int tx = 0; tx < width; tx += ORIENT_TILE) {
+            const int tx1 = tx + ORIENT_TILE < width ? tx + ORIENT_TILE : width;
+            int y = ty;
+            for (; y + blk <= ty1; y += blk) {
+                int x = tx;
+                for (; x + blk <= tx1 && x + blk <= simd_w; x += blk) {
+                    if constexpr (CH == 4) {
+                        if (avx2) {
+                            orient_block8_rgba_avx2(src, dst, m, x, y);
+                            continue;
+                        }
+                    }
+                    orient_block4<CH>(src, dst, m, x, y);
                 }
+                if (x < tx1) orient_rect_scalar<CH>(src, dst, m, x, tx1, y, y + blk);
             }
-            pixels = std::move(temp);
-            std::swap(width, height);
-            return true;
+            if (y < ty1) orient_rect_scalar<CH>(src, dst, m, tx, tx1, y, ty1);
         }
-        
-        case 6: {  // Rotate 90 CW
-            temp.resize(height * width * pixel_size);
-            int new_width = height;
-            for (int y = 0; y < height; y++) {
-                for (int x = 0; x < width; x++) {
-                    int nx = height - 1 - y;
-                    int ny = x;
-                    set_pixel(temp.data() + ny * new_width * pixel_size + nx * pixel_size,
-                              get_pixel(x, y));
-                }
-            }
-            pixels = std::move(temp);
-            std::swap(width, height);
-            return true;
+    }
+}
+
+// zeile pixelweise umdrehen (2 und 3), 4 pixel pro schritt
+template<int CH>
+inline void reverse_row(const uint8_t* in, uint8_t* out_end, int width) {
+    // out_end zeigt auf den letzten pixel der zielzeile
+    const int simd_w = CH == 3 ? width - 2 : width;
+    int x = 0;
+    for (; x + 4 <= simd_w; x += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x * CH));
+        uint8_t* out = out_end - (x + 3) * CH;
+        if (CH == 3) {
+            store_rgb4(out, reverse_px4(rgb_expand(v)));
+        } else {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), reverse_px4(v));
         }
-        
-        case 7: {  // Transverse (flip H + rotate 90)
-            temp.resize(height * width * pixel_size);
-            int new_width = height;
-            for (int y = 0; y < height; y++) {
-                for (int x = 0; x < width; x++) {
-                    int nx = height - 1 - y;
-                    int ny = width - 1 - x;
-                    set_pixel(temp.data() + ny * new_width * pixel_size + nx * pixel_size,
-                              get_pixel(x, y));
-                }
-            }
-            pixels = std::move(temp);
-            std::swap(width, height);
-            return true;
+    }
+    for (; x < width; x++) std::memcpy(out_end - x * CH, in + x * CH, CH);
+}
+
+#endif // EXIF_ORIENT_SIMD
+
+} // namespace detail
+
+// Apply orientation transform: src -> dst (out of place)
+// dst muss schon die gedrehten maße haben (swaps_dimensions), beliebige strides
+// planar wird plane für plane gemacht
+// rows verteilt die quellzeilen (bzw. kachelzeilen) in bändern, siehe imgview::SerialRows
+template<typename Rows = imgview::SerialRows>
+inline void apply_orientation(
+    imgview::ConstView src,
+    imgview::View dst,
+    int orientation,
+    const Rows& rows = Rows{}
+) {
+    if (src.planar()) {
+        for (int c = 0; c < src.channels; c++) {
+            apply_orientation(src.plane_view(c), dst.plane_view(c), orientation, rows);
         }
-        
-        case 8: {  // Rotate 270 CW (90 CCW)
-            temp.resize(height * width * pixel_size);
-            int new_width = height;
-            for (int y = 0; y < height; y++) {
-                for (int x = 0; x < width; x++) {
-                    int nx = y;
-                    int ny = width - 1 - x;
-                    set_pixel(temp.data() + ny * new_width * pixel_size + nx * pixel_size,
-                              get_pixel(x, y));
-                }
+        return;
+    }
+    
+    const int width = src.width;
+    const int height = src.height;
+    const int channels = src.channels;
+    
+    if (orientation < 2 || orientation > 8) {
+        imgview::copy(src, dst);  // Normal or invalid - plain copy
+        return;
+    }
+    
+    // schon gedrehte views o.ä. - die kernels brauchen zusammenhängende zeilen
+    if (!src.rows_contiguous() || !dst.rows_contiguous()) {
+        imgview::copy(oriented_view(src, orientation), dst);
+        return;
+    }
+    
+    const detail::OrientMap m = detail::orient_map(orientation, width, height, channels, dst.stride);
+    
+    // vertikal spiegeln = zeilen in umgekehrter reihenfolge kopieren
+    if (orientation == 4) {
+        const size_t bytes = src.row_bytes();
+        rows(height, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) {
+                std::memcpy(dst.data + m.origin + y * m.step_y, src.row(y), bytes);
             }
-            pixels = std::move(temp);
-            std::swap(width, height);
-            return true;
+        });
+        return;
+    }
+    
+    constexpr int T = detail::ORIENT_TILE;
+    const int tile_rows = (height + T - 1) / T;
+    
+#if EXIF_ORIENT_SIMD
+    if (channels == 3 || channels == 4) {
+        if (orientation == 2 || orientation == 3) {
+            // zeilen bleiben zeilen, nur pixel umdrehen - braucht keine kacheln
+            rows(height, [&](int y0, int y1) {
+                for (int y = y0; y < y1; y++) {
+                    uint8_t* out_end = dst.data + m.origin + y * m.step_y;
+                    if (channels == 3) detail::reverse_row<3>(src.row(y), out_end, width);
+                    else detail::reverse_row<4>(src.row(y), out_end, width);
+                }
+            });
+            return;
         }
+        rows(tile_rows, [&](int t0, int t1) {
+            const int y0 = t0 * T;
+            const int y1 = t1 * T < height ? t1 * T : height;
+            if (channels == 3) detail::orient_transpose_tiled<3>(src, dst.data, m, y0, y1);
+            else detail::orient_transpose_tiled<4>(src, dst.data, m, y0, y1);
+        });
+        return;
     }
+#endif
     
-    return false;
+    // 1/2 kanäle oder kein simd: skalar, aber trotzdem in kacheln
+    rows(tile_rows, [&](int t0, int t1) {
+        for (int ty = t0 * T; ty < height && ty < t1 * T; ty += T) {
+            const int ty1 = ty + T < height ? ty + T : height;
+            for (int tx = 0; tx < width; tx += T) {
+                const int tx1 = tx + T < width ? tx + T : width;
+                detail::orient_rect_scalar_any(src, dst.data, m, tx, tx1, ty, ty1);
+            }
+        }
+    });
 }
 
 } // namespace exif
@@ -8,7 +8,10 @@
 #include <cstring>
 #include <cstdlib>
 #include <vector>
+#include <atomic>
 #include "gpu_dct.hpp"
+#include "buffer_pool.hpp"
+#include "image_view.hpp"
 
 // LEGACY HARDWARE FIX: Always enable AVX2 intrinsics on x86-64
 // Even when compiling with -march=x86-64-v2 (SSE4.2 baseline), we want AVX2 code paths
@@ -118,6 +121,11 @@ inline void aligned_free_mem(void* ptr) {
 #endif
 }
 
+// scratch pro encode: 4 Y + Cb + Cr blöcke (int16) + 2 dct zwischenpuffer (int32)
+// kommt als ein block aus dem pool statt 3 _mm_malloc pro bild + 2 pro dct aufruf
+constexpr size_t SCRATCH_BLOCKS_BYTES = 6 * 64 * sizeof(int16_t);
+constexpr size_t SCRATCH_BYTES = SCRATCH_BLOCKS_BYTES + 2 * 64 * sizeof(int32_t);
+
 alignas(64) static const uint8_t STD_QUANT_Y[64] = {
     16,11,10,16,24,40,51,61, 12,12,14,19,26,58,60,55,
     14,13,16,24,40,57,69,56, 14,17,22,29,51,87,80,62,
@@ -207,12 +215,20 @@ inline int fast_bit_count(int absval) {
     return bits;
 }
 
+// ausgabe als callback (wie stbi_write_*_to_func), kommt in stücken bis 16K
+using WriteFunc = void (*)(void* context, const uint8_t* data, size_t size);
+
 class Encoder {
 private:
-    FILE* fp;
+    WriteFunc sink = nullptr;
+    void* sink_context = nullptr;
     uint64_t bitbuf;
     int bitcount;
     
+    // dct zwischenpuffer aus dem encode scratch block (32 byte aligned)
+    int32_t* dct_tmp = nullptr;
+    int32_t* dct_res = nullptr;
+    
     // fetter output buffer damit write() nicht ständig aufgerufen wird
     alignas(64) uint8_t outbuf[16384];
     int outpos;
@@ -234,7 +250,7 @@ private:
     
     void flush_outbuf() {
         if (outpos > 0) {
-            fwrite(outbuf, 1, outpos, fp);
+            sink(sink_context, outbuf, static_cast<size_t>(outpos));
             outpos = 0;
         }
     }
@@ -459,11 +475,11 @@ private:
     FASTJPEG_AVX2_TARGET
     void fdct(int16_t* block) {
         // STACK ALIGNMENT FIX: alignas(32) is IGNORED on Windows x64 (16-byte stack alignment only)
-        // Use _mm_malloc to guarantee 32-byte alignment for AVX2 aligned loads/stores
-        // OOM FIX: If malloc fails, fall back to scalar DCT instead of silent corruption
-        int32_t* tmp = (int32_t*)_mm_malloc(64 * sizeof(int32_t), 32);
-        if (!tmp) {
-            // OOM: Fall back to scalar DCT (slow but correct)
+        // Scratch comes from the pooled encode block (64-byte aligned), no malloc per block anymore
+        // Without scratch (fdct called outside encode) fall back to scalar DCT
+        int32_t* tmp = dct_tmp;
+        int32_t* res = dct_res;
+        if (!tmp || !res) {
             fdct_scalar(block);
             return;
         }
@@ -560,17 +576,6 @@ private:
         
         // ergebnisse speichern - 32bit zu 16bit
         // (compiler macht das besser als manuelles packen tbh)
-        // STACK ALIGNMENT FIX: Use _mm_malloc for guaranteed 32-byte alignment
-        // OOM FIX: If allocation fails, fallback to scalar (already processed in tmp)
-        int32_t* res = (int32_t*)_mm_malloc(64 * sizeof(int32_t), 32);
-        if (!res) {
-            // OOM rare case: Convert tmp directly to block without AVX2 stores
-            for (int i = 0; i < 64; i++) {
-                block[i] = (int16_t)tmp[i];
-            }
-            _mm_free(tmp);
-            return;
-        }
         _mm256_store_si256((__m256i*)&res[0], out0);
         _mm256_store_si256((__m256i*)&res[8], out1);
         _mm256_store_si256((__m256i*)&res[16], out2);
@@ -584,8 +589,6 @@ private:
             block[i] = (int16_t)res[i];
         }
         _mm256_zeroupper();  // Prevent AVX-SSE transition penalties
-        _mm_free(res);
-        _mm_free(tmp);
     }
 #else
     // scalar fallback wenn kein avx2
@@ -677,9 +680,31 @@ private:
     }
     
 public:
+    bool encode(const char* filename, imgview::ConstView img, int quality) {
+        FILE* out = fopen(filename, "wb");
+        if (!out) return false;
+        return encode(out, img, quality);
+    }
+    
+    // out gehört ab hier dem encoder und wird immer geschlossen
+    bool encode(FILE* out, imgview::ConstView img, int quality) {
+        FileGuard fp_guard(out);  // RAII: auto-close on exception or early return
+        auto to_file = [](void* context, const uint8_t* data, size_t size) {
+            fwrite(data, 1, size, static_cast<FILE*>(context));
+        };
+        if (!encode(to_file, out, img, quality)) return false;
+        fp_guard.release();  // Success - release ownership before manual close
+        fclose(out);
+        return true;
+    }
+    
     // LEGACY HARDWARE: Function calls AVX2 fdct(), compiled with AVX2 target attribute
     FASTJPEG_AVX2_TARGET
-    bool encode(const char* filename, const uint8_t* rgb, int w, int h, int quality) {
+    bool encode(WriteFunc write, void* context, imgview::ConstView img, int quality) {
+        sink = write;
+        sink_context = context;
+        const uint8_t* rgb = img.data;
+        const int w = img.width, h = img.height;
         // Runtime CPU feature check to prevent crashes on unsupported CPUs
 #if FASTJPEG_AVX2
         if (!cpu_has_avx2()) {
@@ -694,10 +719,6 @@ public:
         }
 #endif
         
-        fp = fopen(filename, "wb");
-        if (!fp) return false;
-        FileGuard fp_guard(fp);  // RAII: auto-close on exception or early return
-        
         init_bit_category();
         bitbuf = 0;
         bitcount = 0;
@@ -730,17 +751,14 @@ public:
         // y plane vorberechnen, chroma on the fly
         // spart speicher und is eigentlich nich langsamer
         
-        // STACK ALIGNMENT FIX: alignas(32) ignored on Windows - use _mm_malloc for guaranteed alignment
-        int16_t* y_blocks_mem = (int16_t*)_mm_malloc(4 * 64 * sizeof(int16_t), 32);
-        int16_t* cb_block = (int16_t*)_mm_malloc(64 * sizeof(int16_t), 32);
-        int16_t* cr_block = (int16_t*)_mm_malloc(64 * sizeof(int16_t), 32);
-        
-        if (!y_blocks_mem || !cb_block || !cr_block) {
-            if (y_blocks_mem) _mm_free(y_blocks_mem);
-            if (cb_block) _mm_free(cb_block);
-            if (cr_block) _mm_free(cr_block);
-            return false;
-        }
+        // STACK ALIGNMENT FIX: alignas(32) ignored on Windows - pool blocks are 64-byte aligned
+        bufpool::Buffer scratch(SCRATCH_BYTES);
+        if (!scratch) return false;
+        int16_t* y_blocks_mem = scratch.as<int16_t>();
+        int16_t* cb_block = y_blocks_mem + 4 * 64;
+        int16_t* cr_block = y_blocks_mem + 5 * 64;
+        dct_tmp = scratch.as<int32_t>(SCRATCH_BLOCKS_BYTES);
+        dct_res = dct_tmp + 64;
         
         // Create 2D view of y_blocks (4 blocks of 64 elements)
         int16_t* y_blocks[4] = {
@@ -754,7 +772,8 @@ public:
         
         const int mcu_rows = (h + 15) / 16;
         const int mcu_cols = (w + 15) / 16;
-        const int stride3 = w * 3;
+        const ptrdiff_t stride3 = img.stride;  // zeilen können padding haben
+        const ptrdiff_t px3 = img.step();       // exif-gedrehte views: gather liest gleich gedreht
         
         for (int mcu_y = 0; mcu_y < mcu_rows; mcu_y++) {
             const int base_y = mcu_y * 16;
@@ -786,7 +805,7 @@ public:
                                 continue;
                             }
                             
-                            const uint8_t* row = rgb + img_y * stride3 + block_x * 3;
+                            const uint8_t* row = rgb + img_y * stride3 + block_x * px3;
                             const int max_px = (w - block_x < 8) ? (w - block_x) : 8;
                             
                             // pixel durchgehen - 2er unroll für chroma subsampling
@@ -795,8 +814,8 @@ public:
                                 // Pixel 0
                                 int r0 = row[0], g0 = row[1], b0 = row[2];
                                 // Pixel 1  
-                                int r1 = row[3], g1 = row[4], b1 = row[5];
-                                row += 6;
+                                int r1 = row[px3], g1 = row[px3 + 1], b1 = row[px3 + 2];
+                                row += px3 * 2;
                                 
                                 // Y for both pixels (Q16 fixed-point)
                                 int y0 = (19595*r0 + 38470*g0 + 7471*b0 + 32768) >> 16;
@@ -821,7 +840,7 @@ public:
                             // ungerades pixel falls vorhanden
                             for (; px < max_px; px++) {
                                 int r = row[0], g = row[1], b = row[2];
-                                row += 3;
+                                row += px3;
                                 int y = (19595*r + 38470*g + 7471*b + 32768) >> 16;
                                 yblk[py*8+px] = y - 128;
                                 
@@ -873,13 +892,9 @@ public:
         // Flush output buffer
         flush_outbuf();
         
-        // Cleanup aligned buffers
-        _mm_free(y_blocks_mem);
-        _mm_free(cb_block);
-        _mm_free(cr_block);
-        
-        fp_guard.release();  // Success - release ownership before manual close
-        fclose(fp);
+        // scratch geht am ende zurück in den pool
+        dct_tmp = nullptr;
+        dct_res = nullptr;
         return true;
     }
 };
@@ -1122,57 +1137,22 @@ private:
         }
     }
     
-public:
-    // Encode to memory buffer, returns actual size written
+    // MCU zeilen [row_begin, row_end) kodieren: gather (RGB -> YCbCr, 4:2:0),
+    // fdct, quantisieren, huffman. genau ein entropy segment, bits bleiben im bitbuf
     FASTJPEG_AVX2_TARGET
-    size_t encode(uint8_t* buffer, size_t buffer_size, const uint8_t* rgb, int w, int h, int quality) {
-        // Runtime CPU feature check
-#if FASTJPEG_AVX2
-        if (!cpu_has_avx2()) {
-            fprintf(stderr, "ERROR: AVX2 required but not supported by CPU\n");
-            return 0;
-        }
-#endif
-        
-        out_start = buffer;
-        out_ptr = buffer;
-        out_end = buffer + buffer_size;
-        bitbuf = 0;
-        bitcount = 0;
+    void encode_mcu_rows(imgview::ConstView img, int row_begin, int row_end) {
+        const uint8_t* rgb = img.data;
+        const int w = img.width, h = img.height;
         
-        init_bit_category();
-        init_quant(quality);
-        build_huffman(dc_luma, DC_LUMA_BITS, DC_LUMA_VAL, 12);
-        build_huffman(ac_luma, AC_LUMA_BITS, AC_LUMA_VAL, 162);
-        build_huffman(dc_chroma, DC_CHROMA_BITS, DC_CHROMA_VAL, 12);
-        build_huffman(ac_chroma, AC_CHROMA_BITS, AC_CHROMA_VAL, 162);
-        
-        write_word(0xFFD8);  // SOI
-        
-        write_word(0xFFE0);  // APP0
-        write_word(16);
-        const char* jfif = "JFIF";
-        for (int i = 0; i < 5; i++) emit_byte(jfif[i]);
-        emit_byte(1); emit_byte(1); emit_byte(0);
-        write_word(1); write_word(1);
-        emit_byte(0); emit_byte(0);
-        
-        write_dqt();
-        write_sof(w, h);
-        write_dht();
-        write_sos();
-        
-        // STACK ALIGNMENT FIX: Use _mm_malloc for guaranteed 32-byte alignment
-        int16_t* y_blocks_mem = (int16_t*)_mm_malloc(4 * 64 * sizeof(int16_t), 32);
-        int16_t* cb_block = (int16_t*)_mm_malloc(64 * sizeof(int16_t), 32);
-        int16_t* cr_block = (int16_t*)_mm_malloc(64 * sizeof(int16_t), 32);
-        
-        if (!y_blocks_mem || !cb_block || !cr_block) {
-            if (y_blocks_mem) _mm_free(y_blocks_mem);
-            if (cb_block) _mm_free(cb_block);
-            if (cr_block) _mm_free(cr_block);
-            return 0;
+        // STACK ALIGNMENT FIX: pooled scratch block, 64-byte aligned
+        bufpool::Buffer scratch(SCRATCH_BLOCKS_BYTES);
+        if (!scratch) {
+            overflow_ = true;
+            return;
         }
+        int16_t* y_blocks_mem = scratch.as<int16_t>();
+        int16_t* cb_block = y_blocks_mem + 4 * 64;
+        int16_t* cr_block = y_blocks_mem + 5 * 64;
         
         int16_t* y_blocks[4] = {
             y_blocks_mem,
@@ -1181,13 +1161,14 @@ public:
             y_blocks_mem + 192
         };
         
+        // dc prädiktion fängt bei jedem restart intervall (und am scan anfang) bei 0 an
         int last_dc_y = 0, last_dc_cb = 0, last_dc_cr = 0;
         
-        const int mcu_rows = (h + 15) / 16;
         const int mcu_cols = (w + 15) / 16;
-        const int stride3 = w * 3;
+        const ptrdiff_t stride3 = img.stride;  // zeilen können padding haben
+        const ptrdiff_t px3 = img.step();       // exif-gedrehte views: gather liest gleich gedreht
         
-        for (int mcu_y = 0; mcu_y < mcu_rows; mcu_y++) {
+        for (int mcu_y = row_begin; mcu_y < row_end; mcu_y++) {
             const int base_y = mcu_y * 16;
             for (int mcu_x = 0; mcu_x < mcu_cols; mcu_x++) {
                 const int base_x = mcu_x * 16;
@@ -1208,14 +1189,14 @@ public:
                                 for (int px = 0; px < 8; px++) yblk[py*8+px] = 0;
                                 continue;
                             }
-                            const uint8_t* row = rgb + img_y * stride3 + block_x * 3;
+                            const uint8_t* row = rgb + img_y * stride3 + block_x * px3;
                             const int max_px = (w - block_x < 8) ? (w - block_x) : 8;
                             
                             int px = 0;
                             for (; px + 1 < max_px; px += 2) {
                                 int r0 = row[0], g0 = row[1], b0 = row[2];
-                                int r1 = row[3], g1 = row[4], b1 = row[5];
-                                row += 6;
+                                int r1 = row[px3], g1 = row[px3 + 1], b1 = row[px3 + 2];
+                                row += px3 * 2;
                                 int y0 = (19595*r0 + 38470*g0 + 7471*b0 + 32768) >> 16;
                                 int y1 = (19595*r1 + 38470*g1 + 7471*b1 + 32768) >> 16;
                                 yblk[py*8+px] = y0 - 128;
@@ -1228,7 +1209,7 @@ public:
                             }
                             for (; px < max_px; px++) {
                                 int r = row[0], g = row[1], b = row[2];
-                                row += 3;
+                                row += px3;
                                 yblk[py*8+px] = ((19595*r + 38470*g + 7471*b + 32768) >> 16) - 128;
                                 int cx = chroma_base_x + (px >> 1);
                                 int cy = chroma_base_y + (py >> 1);
@@ -1258,23 +1239,160 @@ public:
                 encode_ac(cr_block, ac_chroma);
             }
         }
-        
+    }
+    
+    // letztes byte des segments mit 1-bits auffüllen
+    void pad_bits() {
         if (bitcount > 0) write_bits(0x7F, 7);
-        write_word(0xFFD9);  // EOI
+        bitcount = 0;
+    }
+    
+    // ab so vielen pixeln kommt das bild in restart intervalle, dann können die
+    // MCU zeilen bänder parallel kodiert werden. hängt nur an den maßen, nicht an der
+    // thread zahl - gleiche datei gibt immer die gleichen bytes
+    static constexpr int64_t RESTART_MIN_PIXELS = 2 * 1024 * 1024;
+    static constexpr int RESTART_MCU_ROWS = 16;  // 256 pixel zeilen pro intervall
+    
+    static int restart_mcu_rows(int w, int h) {
+        if (static_cast<int64_t>(w) * h < RESTART_MIN_PIXELS) return 0;
+        const int mcu_cols = (w + 15) / 16;
+        const int rows = 65535 / mcu_cols;  // DRI zählt MCUs in 16 bit
+        return rows < RESTART_MCU_ROWS ? rows : RESTART_MCU_ROWS;
+    }
+    
+    // großzügig: ~2 byte pro pixel, viel mehr schafft selbst rauschen bei q100 nicht
+    static size_t segment_capacity(int w, int seg_rows) {
+        return static_cast<size_t>(w) * seg_rows * 16 * 2 + 4096;
+    }
+    
+public:
+    // wieviel speicher encode() zusätzlich zum ausgabepuffer für die restart
+    // segmente braucht (0 für kleine bilder), für die memory admission
+    static size_t scratch_bytes(int w, int h) {
+        const int seg_rows = restart_mcu_rows(w, h);
+        if (seg_rows == 0) return 0;
+        const int segments = ((h + 15) / 16 + seg_rows - 1) / seg_rows;
+        return segment_capacity(w, seg_rows) * static_cast<size_t>(segments);
+    }
+    
+
+    // Encode to memory buffer, returns actual size written (0 = buffer zu klein)
+    // große bilder gehen in restart intervallen raus, rows verteilt die intervalle
+    // (imgview::SerialRows = alles nacheinander im aktuellen thread)
+    template<typename Rows = imgview::SerialRows>
+    size_t encode(uint8_t* buffer, size_t buffer_size, imgview::ConstView img, int quality,
+                  const Rows& rows = Rows{}) {
+        const int w = img.width, h = img.height;
+        // Runtime CPU feature check
+#if FASTJPEG_AVX2
+        if (!cpu_has_avx2()) {
+            fprintf(stderr, "ERROR: AVX2 required but not supported by CPU\n");
+            return 0;
+        }
+#endif
+        
+        out_start = buffer;
+        out_ptr = buffer;
+        out_end = buffer + buffer_size;
+        bitbuf = 0;
+        bitcount = 0;
+        overflow_ = false;
+        
+        init_bit_category();
+        init_quant(quality);
+        build_huffman(dc_luma, DC_LUMA_BITS, DC_LUMA_VAL, 12);
+        build_huffman(ac_luma, AC_LUMA_BITS, AC_LUMA_VAL, 162);
+        build_huffman(dc_chroma, DC_CHROMA_BITS, DC_CHROMA_VAL, 12);
+        build_huffman(ac_chroma, AC_CHROMA_BITS, AC_CHROMA_VAL, 162);
         
-        // Cleanup aligned buffers
-        _mm_free(y_blocks_mem);
-        _mm_free(cb_block);
-        _mm_free(cr_block);
+        write_word(0xFFD8);  // SOI
+        
+        write_word(0xFFE0);  // APP0
+        write_word(16);
+        const char* jfif = "JFIF";
+        for (int i = 0; i < 5; i++) emit_byte(jfif[i]);
+        emit_byte(1); emit_byte(1); emit_byte(0);
+        write_word(1); write_word(1);
+        emit_byte(0); emit_byte(0);
         
+        write_dqt();
+        write_sof(w, h);
+        write_dht();
+        
+        const int mcu_rows = (h + 15) / 16;
+        const int mcu_cols = (w + 15) / 16;
+        const int seg_rows = restart_mcu_rows(w, h);
+        
+        if (seg_rows == 0) {
+            write_sos();
+            encode_mcu_rows(img, 0, mcu_rows);
+            pad_bits();
+        } else {
+            write_word(0xFFDD);  // DRI
+            write_word(4);
+            write_word(static_cast<uint16_t>(mcu_cols * seg_rows));
+            write_sos();
+            if (!encode_segments(img, mcu_rows, seg_rows, rows)) overflow_ = true;
+        }
+        
+        write_word(0xFFD9);  // EOI
+        
+        if (overflow_) return 0;
         return static_cast<size_t>(out_ptr - out_start);
     }
+    
+private:
+    // jedes restart intervall in einen eigenen puffer, mit kopie der tabellen
+    // (eigener bit writer, dc prädiktoren bei 0). danach hintereinander mit RSTn dazwischen
+    template<typename Rows>
+    bool encode_segments(imgview::ConstView img, int mcu_rows, int seg_rows, const Rows& rows) {
+        const int segments = (mcu_rows + seg_rows - 1) / seg_rows;
+        // reicht segment_capacity nicht, gibt encode 0 zurück und der aufrufer nimmt den file encoder
+        const size_t seg_capacity = segment_capacity(img.width, seg_rows);
+        bufpool::Buffer out(seg_capacity * segments);
+        if (!out) return false;
+        bufpool::Vector<size_t> sizes(segments, 0);
+        std::atomic<bool> failed{false};
+        
+        rows(segments, [&](int s0, int s1) {
+            for (int s = s0; s < s1; s++) {
+                MemEncoder seg = *this;  // tabellen, ~5 KB
+                seg.out_start = out.data() + static_cast<size_t>(s) * seg_capacity;
+                seg.out_ptr = seg.out_start;
+                seg.out_end = seg.out_start + seg_capacity;
+                seg.bitbuf = 0;
+                seg.bitcount = 0;
+                seg.overflow_ = false;
+                const int r1 = (s + 1) * seg_rows < mcu_rows ? (s + 1) * seg_rows : mcu_rows;
+                seg.encode_mcu_rows(img, s * seg_rows, r1);
+                seg.pad_bits();
+                if (seg.overflow_) failed = true;
+                sizes[s] = static_cast<size_t>(seg.out_ptr - seg.out_start);
+            }
+        });
+        if (failed) return false;
+        
+        for (int s = 0; s < segments; s++) {
+            const size_t n = sizes[s];
+            if (n > static_cast<size_t>(out_end - out_ptr)) return false;
+            std::memcpy(out_ptr, out.data() + static_cast<size_t>(s) * seg_capacity, n);
+            out_ptr += n;
+            if (s + 1 < segments) {
+                emit_byte(0xFF);
+                emit_byte(static_cast<uint8_t>(0xD0 + (s & 7)));  // RST0..RST7 reihum
+            }
+        }
+        return !overflow_;
+    }
 };
 
 // Encode to memory buffer (mmap-friendly)
-inline size_t encode_jpeg_mem(uint8_t* buffer, size_t buffer_size, const uint8_t* rgb, int w, int h, int quality = 80) {
+// img muss interleaved RGB sein, stride egal
+template<typename Rows = imgview::SerialRows>
+inline size_t encode_jpeg_mem(uint8_t* buffer, size_t buffer_size, imgview::ConstView img, int quality = 80,
+                              const Rows& rows = Rows{}) {
     MemEncoder enc;
-    return enc.encode(buffer, buffer_size, rgb, w, h, quality);
+    return enc.encode(buffer, buffer_size, img, quality, rows);
 }
 
 // GPU-accelerated encoder for large images
@@ -1299,13 +1417,13 @@ private:
     HuffCode dc_chroma[12];
     HuffCode ac_chroma[256];
     
-    // Block storage for GPU batching
-    std::vector<int16_t> y_block_buf;
-    std::vector<int16_t> cb_block_buf;
-    std::vector<int16_t> cr_block_buf;
-    std::vector<int16_t> y_quant_buf;
-    std::vector<int16_t> cb_quant_buf;
-    std::vector<int16_t> cr_quant_buf;
+    // Block storage for GPU batching (pooled)
+    bufpool::Vector<int16_t> y_block_buf;
+    bufpool::Vector<int16_t> cb_block_buf;
+    bufpool::Vector<int16_t> cr_block_buf;
+    bufpool::Vector<int16_t> y_quant_buf;
+    bufpool::Vector<int16_t> cb_quant_buf;
+    bufpool::Vector<int16_t> cr_quant_buf;
     
     inline bool emit_byte(uint8_t b) {
         if (out_ptr >= out_end) {
@@ -1497,7 +1615,9 @@ private:
     }
     
 public:
-    size_t encode(uint8_t* buffer, size_t buffer_size, const uint8_t* rgb, int w, int h, int quality) {
+    size_t encode(uint8_t* buffer, size_t buffer_size, imgview::ConstView img, int quality) {
+        const uint8_t* rgb = img.data;
+        const int w = img.width, h = img.height;
         out_start = buffer;
         out_ptr = buffer;
         out_end = buffer + buffer_size;
@@ -1517,7 +1637,8 @@ public:
         const int mcu_rows = (h + 15) / 16;
         const int mcu_cols = (w + 15) / 16;
         const int total_mcus = mcu_rows * mcu_cols;
-        const int stride3 = w * 3;
+        const ptrdiff_t stride3 = img.stride;  // zeilen können padding haben
+        const ptrdiff_t px3 = img.step();       // exif-gedrehte views: gather liest gleich gedreht
         
         // Allocate block buffers: 4 Y + 1 Cb + 1 Cr per MCU
         const int total_y_blocks = total_mcus * 4;
@@ -1552,14 +1673,14 @@ public:
                                 for (int px = 0; px < 8; px++) yblk[py*8+px] = 0;
                                 continue;
                             }
-                            const uint8_t* row = rgb + img_y * stride3 + block_x * 3;
+                            const uint8_t* row = rgb + img_y * stride3 + block_x * px3;
                             const int max_px = (w - block_x < 8) ? (w - block_x) : 8;
                             
                             int px = 0;
                             for (; px + 1 < max_px; px += 2) {
                                 int r0 = row[0], g0 = row[1], b0 = row[2];
-                                int r1 = row[3], g1 = row[4], b1 = row[5];
-                                row += 6;
+                                int r1 = row[px3], g1 = row[px3 + 1], b1 = row[px3 + 2];
+                                row += px3 * 2;
                                 yblk[py*8+px] = ((19595*r0 + 38470*g0 + 7471*b0 + 32768) >> 16) - 128;
                                 yblk[py*8+px+1] = ((19595*r1 + 38470*g1 + 7471*b1 + 32768) >> 16) - 128;
                                 int r = (r0+r1)>>1, g = (g0+g1)>>1, bl = (b0+b1)>>1;
@@ -1572,7 +1693,7 @@ public:
                             }
                             for (; px < max_px; px++) {
                                 int r = row[0], g = row[1], bl = row[2];
-                                row += 3;
+                                row += px3;
                                 yblk[py*8+px] = ((19595*r + 38470*g + 7471*bl + 32768) >> 16) - 128;
                                 int cx = chroma_base_x + (px >> 1);
                                 int cy = chroma_base_y + (py >> 1);
@@ -1663,19 +1784,34 @@ public:
 };
 
 // Encode with GPU acceleration if available
-inline size_t encode_jpeg_gpu(uint8_t* buffer, size_t buffer_size, const uint8_t* rgb, int w, int h, int quality = 80, bool use_gpu = false) {
-    if (use_gpu && gpudct::gpu_available() && w * h >= 1000000) {
+// rows verteilt beim cpu encoder die restart intervalle (siehe MemEncoder::encode)
+template<typename Rows = imgview::SerialRows>
+inline size_t encode_jpeg_gpu(uint8_t* buffer, size_t buffer_size, imgview::ConstView img, int quality = 80,
+                              bool use_gpu = false, const Rows& rows = Rows{}) {
+    if (use_gpu && gpudct::gpu_available() && img.width * img.height >= 1000000) {
         GPUMemEncoder enc;
-        return enc.encode(buffer, buffer_size, rgb, w, h, quality);
+        return enc.encode(buffer, buffer_size, img, quality);
     }
     MemEncoder enc;
-    return enc.encode(buffer, buffer_size, rgb, w, h, quality);
+    return enc.encode(buffer, buffer_size, img, quality, rows);
 }
 
 // Simple API
-inline bool encode_jpeg(const char* filename, const uint8_t* rgb, int w, int h, int quality = 80) {
+inline bool encode_jpeg(const char* filename, imgview::ConstView img, int quality = 80) {
+    Encoder enc;
+    return enc.encode(filename, img, quality);
+}
+
+// in einen schon offenen stream (wird geschlossen)
+inline bool encode_jpeg(FILE* out, imgview::ConstView img, int quality = 80) {
+    Encoder enc;
+    return enc.encode(out, img, quality);
+}
+
+// über einen callback, z.b. in einen wachsenden speicher buffer
+inline bool encode_jpeg(WriteFunc write, void* context, imgview::ConstView img, int quality = 80) {
     Encoder enc;
-    return enc.encode(filename, rgb, w, h, quality);
+    return enc.encode(write, context, img, quality);
 }
 
 // checken ob GPU acceleration verfügbar is
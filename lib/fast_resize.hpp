@@ -4,9 +4,12 @@
 // avx2 -> sse2 -> scalar fallback je nach cpu
 
 #include <cstdint>
+#include <cstddef>
 #include <cstring>
 #include <algorithm>
 #include <vector>
+#include "buffer_pool.hpp"
+#include "image_view.hpp"
 
 #if defined(__AVX2__) || (defined(_MSC_VER) && defined(__AVX2__))
 #include <immintrin.h>
@@ -20,202 +23,238 @@
 
 namespace fastresize {
 
+// ausgabezeilen verteilen (imgview::SerialRows). jede ausgabezeile hängt nur von der
+// quelle ab, bänder sind also unabhängig
+using SerialRows = imgview::SerialRows;
+
 // ============================================================================
 // 2x2 box downscale - exakt halbe größe, cache optimiert
 // ============================================================================
 
-inline void downscale_rgb_2x(const uint8_t* src, int src_w, int src_h, uint8_t* dst) {
+// src_px = bytes von pixel zu pixel in der quelle (3 = normal). exif-gedrehte
+// quellen (exif::oriented_view) haben hier z.b. -3 oder eine ganze zeile,
+// dann wird beim lesen gleich gedreht und es braucht keinen extra pass
+template<typename Rows = SerialRows>
+inline void downscale_rgb_2x(const uint8_t* src, int src_w, int src_h, ptrdiff_t src_stride,
+                             uint8_t* dst, ptrdiff_t dst_stride, ptrdiff_t src_px = 3,
+                             const Rows& rows = Rows{}) {
+    const ptrdiff_t p1 = src_px;
+    const ptrdiff_t p2 = src_px * 2;
     const int dst_w = src_w / 2;
     const int dst_h = src_h / 2;
-    const int src_stride = src_w * 3;
     
-    for (int dy = 0; dy < dst_h; dy++) {
-        const uint8_t* row0 = src + (dy * 2) * src_stride;
-        const uint8_t* row1 = row0 + src_stride;
-        uint8_t* out = dst + dy * dst_w * 3;
+    rows(dst_h, [&](int dy_begin, int dy_end) {
+        for (int dy = dy_begin; dy < dy_end; dy++) {
+            const uint8_t* row0 = src + (dy * 2) * src_stride;
+            const uint8_t* row1 = row0 + src_stride;
+            uint8_t* out = dst + dy * dst_stride;
         
-        int dx = 0;
+            int dx = 0;
         
-        // 8 pixel auf einmal für bessere pipeline
-        for (; dx + 8 <= dst_w; dx += 8) {
+            // 8 pixel auf einmal für bessere pipeline
+            for (; dx + 8 <= dst_w; dx += 8) {
             
-            for (int i = 0; i < 8; i++) {
-                uint32_t r = row0[0] + row0[3] + row1[0] + row1[3];
-                uint32_t g = row0[1] + row0[4] + row1[1] + row1[4];
-                uint32_t b = row0[2] + row0[5] + row1[2] + row1[5];
+                for (int i = 0; i < 8; i++) {
+                    uint32_t r = row0[0] + row0[p1] + row1[0] + row1[p1];
+                    uint32_t g = row0[1] + row0[p1 + 1] + row1[1] + row1[p1 + 1];
+                    uint32_t b = row0[2] + row0[p1 + 2] + row1[2] + row1[p1 + 2];
+                    out[0] = static_cast<uint8_t>((r + 2) >> 2);
+                    out[1] = static_cast<uint8_t>((g + 2) >> 2);
+                    out[2] = static_cast<uint8_t>((b + 2) >> 2);
+                    row0 += p2;
+                    row1 += p2;
+                    out += 3;
+                }
+            }
+        
+            // rest einzeln
+            for (; dx < dst_w; dx++) {
+                uint32_t r = row0[0] + row0[p1] + row1[0] + row1[p1];
+                uint32_t g = row0[1] + row0[p1 + 1] + row1[1] + row1[p1 + 1];
+                uint32_t b = row0[2] + row0[p1 + 2] + row1[2] + row1[p1 + 2];
                 out[0] = static_cast<uint8_t>((r + 2) >> 2);
                 out[1] = static_cast<uint8_t>((g + 2) >> 2);
                 out[2] = static_cast<uint8_t>((b + 2) >> 2);
-                row0 += 6;
-                row1 += 6;
+                row0 += p2;
+                row1 += p2;
                 out += 3;
             }
         }
-        
-        // rest einzeln
-        for (; dx < dst_w; dx++) {
-            uint32_t r = row0[0] + row0[3] + row1[0] + row1[3];
-            uint32_t g = row0[1] + row0[4] + row1[1] + row1[4];
-            uint32_t b = row0[2] + row0[5] + row1[2] + row1[5];
-            out[0] = static_cast<uint8_t>((r + 2) >> 2);
-            out[1] = static_cast<uint8_t>((g + 2) >> 2);
-            out[2] = static_cast<uint8_t>((b + 2) >> 2);
-            row0 += 6;
-            row1 += 6;
-            out += 3;
-        }
-    }
+    });
 }
 
 // ============================================================================
 // box filter mit row cache - schnellste variante für beliebige skalierung
 // ============================================================================
 
+template<typename Rows = SerialRows>
 inline void downscale_rgb_box_cached(
-    const uint8_t* src, int src_w, int src_h,
-    uint8_t* dst, int dst_w, int dst_h
+    const uint8_t* src, int src_w, int src_h, ptrdiff_t src_stride,
+    uint8_t* dst, int dst_w, int dst_h, ptrdiff_t dst_stride, ptrdiff_t src_px = 3,
+    const Rows& rows = Rows{}
 ) {
     const float scale_x = static_cast<float>(src_w) / dst_w;
     const float scale_y = static_cast<float>(src_h) / dst_h;
-    const int src_stride = src_w * 3;
     
-    // Pre-compute x boundaries and widths
-    std::vector<int> x0_table(dst_w), x1_table(dst_w), box_w_table(dst_w);
+    // Pre-compute x boundaries and widths (pooled, wird pro bild neu gebraucht)
+    bufpool::Vector<int> x0_table(dst_w), x1_table(dst_w), box_w_table(dst_w);
     for (int dx = 0; dx < dst_w; dx++) {
         x0_table[dx] = static_cast<int>(dx * scale_x);
         x1_table[dx] = std::min(static_cast<int>((dx + 1) * scale_x), src_w);
         box_w_table[dx] = x1_table[dx] - x0_table[dx];
     }
     
-    // Row accumulators (R,G,B for each output column)
-    std::vector<uint32_t> row_acc(dst_w * 3);
+    rows(dst_h, [&](int dy_begin, int dy_end) {
+        // Row accumulators (R,G,B for each output column), einer pro band
+        bufpool::Vector<uint32_t> row_acc(dst_w * 3);
     
-    for (int dy = 0; dy < dst_h; dy++) {
-        const int sy0 = static_cast<int>(dy * scale_y);
-        const int sy1 = std::min(static_cast<int>((dy + 1) * scale_y), src_h);
-        const int box_h = sy1 - sy0;
+        for (int dy = dy_begin; dy < dy_end; dy++) {
+            const int sy0 = static_cast<int>(dy * scale_y);
+            const int sy1 = std::min(static_cast<int>((dy + 1) * scale_y), src_h);
+            const int box_h = sy1 - sy0;
         
-        // Clear accumulators
-        std::memset(row_acc.data(), 0, row_acc.size() * sizeof(uint32_t));
+            // Clear accumulators
+            std::memset(row_acc.data(), 0, row_acc.size() * sizeof(uint32_t));
         
-        // Accumulate all source rows for this output row
-        for (int sy = sy0; sy < sy1; sy++) {
-            const uint8_t* row = src + sy * src_stride;
+            // Accumulate all source rows for this output row
+            for (int sy = sy0; sy < sy1; sy++) {
+                const uint8_t* row = src + sy * src_stride;
             
-            // Accumulate each output column
-            for (int dx = 0; dx < dst_w; dx++) {
-                const int sx0 = x0_table[dx];
-                const int sx1 = x1_table[dx];
-                const uint8_t* p = row + sx0 * 3;
+                // Accumulate each output column
+                for (int dx = 0; dx < dst_w; dx++) {
+                    const int sx0 = x0_table[dx];
+                    const int sx1 = x1_table[dx];
+                    const uint8_t* p = row + sx0 * src_px;
                 
-                uint32_t r = 0, g = 0, b = 0;
-                int count = sx1 - sx0;
+                    uint32_t r = 0, g = 0, b = 0;
+                    int count = sx1 - sx0;
                 
-                // Unrolled 4x accumulation
-                while (count >= 4) {
-                    r += p[0] + p[3] + p[6] + p[9];
-                    g += p[1] + p[4] + p[7] + p[10];
-                    b += p[2] + p[5] + p[8] + p[11];
-                    p += 12;
-                    count -= 4;
-                }
-                while (count > 0) {
-                    r += p[0]; g += p[1]; b += p[2];
-                    p += 3;
-                    count--;
-                }
+                    // Unrolled 4x accumulation
+                    const ptrdiff_t q1 = src_px, q2 = src_px * 2, q3 = src_px * 3;
+                    while (count >= 4) {
+                        r += p[0] + p[q1] + p[q2] + p[q3];
+                        g += p[1] + p[q1 + 1] + p[q2 + 1] + p[q3 + 1];
+                        b += p[2] + p[q1 + 2] + p[q2 + 2] + p[q3 + 2];
+                        p += src_px * 4;
+                        count -= 4;
+                    }
+                    while (count > 0) {
+                        r += p[0]; g += p[1]; b += p[2];
+                        p += src_px;
+                        count--;
+                    }
                 
-                row_acc[dx*3+0] += r;
-                row_acc[dx*3+1] += g;
-                row_acc[dx*3+2] += b;
+                    row_acc[dx*3+0] += r;
+                    row_acc[dx*3+1] += g;
+                    row_acc[dx*3+2] += b;
+                }
             }
-        }
         
-        // Output row with reciprocal division (faster than integer divide)
-        uint8_t* out_row = dst + dy * dst_w * 3;
-        for (int dx = 0; dx < dst_w; dx++) {
-            const int area = box_w_table[dx] * box_h;
-            if (area > 0) {
-                // Use reciprocal multiplication for division
-                const uint32_t half = area >> 1;
-                out_row[dx*3+0] = static_cast<uint8_t>((row_acc[dx*3+0] + half) / area);
-                out_row[dx*3+1] = static_cast<uint8_t>((row_acc[dx*3+1] + half) / area);
-                out_row[dx*3+2] = static_cast<uint8_t>((row_acc[dx*3+2] + half) / area);
+            // Output row with reciprocal division (faster than integer divide)
+            uint8_t* out_row = dst + dy * dst_stride;
+            for (int dx = 0; dx < dst_w; dx++) {
+                const int area = box_w_table[dx] * box_h;
+                if (area > 0) {
+                    // Use reciprocal multiplication for division
+                    const uint32_t half = area >> 1;
+                    out_row[dx*3+0] = static_cast<uint8_t>((row_acc[dx*3+0] + half) / area);
+                    out_row[dx*3+1] = static_cast<uint8_t>((row_acc[dx*3+1] + half) / area);
+                    out_row[dx*3+2] = static_cast<uint8_t>((row_acc[dx*3+2] + half) / area);
+                }
             }
         }
-    }
+    });
 }
 
 // ============================================================================
 // Bilinear Interpolation for Upscaling (high quality)
 // ============================================================================
 
+template<typename Rows = SerialRows>
 inline void upscale_rgb_bilinear(
-    const uint8_t* src, int src_w, int src_h,
-    uint8_t* dst, int dst_w, int dst_h
+    const uint8_t* src, int src_w, int src_h, ptrdiff_t src_stride,
+    uint8_t* dst, int dst_w, int dst_h, ptrdiff_t dst_stride, ptrdiff_t src_px = 3,
+    const Rows& rows = Rows{}
 ) {
     if (dst_w <= 1 || dst_h <= 1 || src_w <= 1 || src_h <= 1) return;
     
     const float scale_x = static_cast<float>(src_w - 1) / (dst_w - 1);
     const float scale_y = static_cast<float>(src_h - 1) / (dst_h - 1);
-    const int src_stride = src_w * 3;
     
-    for (int dy = 0; dy < dst_h; dy++) {
-        const float sy = dy * scale_y;
-        const int sy0 = static_cast<int>(sy);
-        const int sy1 = std::min(sy0 + 1, src_h - 1);
-        const int fy = static_cast<int>((sy - sy0) * 256);  // Fixed point
-        const int fy1 = 256 - fy;
+    rows(dst_h, [&](int dy_begin, int dy_end) {
+        for (int dy = dy_begin; dy < dy_end; dy++) {
+            const float sy = dy * scale_y;
+            const int sy0 = static_cast<int>(sy);
+            const int sy1 = std::min(sy0 + 1, src_h - 1);
+            const int fy = static_cast<int>((sy - sy0) * 256);  // Fixed point
+            const int fy1 = 256 - fy;
         
-        const uint8_t* row0 = src + sy0 * src_stride;
-        const uint8_t* row1 = src + sy1 * src_stride;
-        uint8_t* out = dst + dy * dst_w * 3;
+            const uint8_t* row0 = src + sy0 * src_stride;
+            const uint8_t* row1 = src + sy1 * src_stride;
+            uint8_t* out = dst + dy * dst_stride;
         
-        for (int dx = 0; dx < dst_w; dx++) {
-            const float sx = dx * scale_x;
-            const int sx0 = static_cast<int>(sx);
-            const int sx1 = std::min(sx0 + 1, src_w - 1);
-            const int fx = static_cast<int>((sx - sx0) * 256);  // Fixed point
-            const int fx1 = 256 - fx;
+            for (int dx = 0; dx < dst_w; dx++) {
+                const float sx = dx * scale_x;
+                const int sx0 = static_cast<int>(sx);
+                const int sx1 = std::min(sx0 + 1, src_w - 1);
+                const int fx = static_cast<int>((sx - sx0) * 256);  // Fixed point
+                const int fx1 = 256 - fx;
             
-            const uint8_t* p00 = row0 + sx0 * 3;
-            const uint8_t* p10 = row0 + sx1 * 3;
-            const uint8_t* p01 = row1 + sx0 * 3;
-            const uint8_t* p11 = row1 + sx1 * 3;
+                const uint8_t* p00 = row0 + sx0 * src_px;
+                const uint8_t* p10 = row0 + sx1 * src_px;
+                const uint8_t* p01 = row1 + sx0 * src_px;
+                const uint8_t* p11 = row1 + sx1 * src_px;
             
-            // Fixed-point bilinear interpolation
-            for (int c = 0; c < 3; c++) {
-                int v = (p00[c] * fx1 * fy1 + p10[c] * fx * fy1 +
-                         p01[c] * fx1 * fy  + p11[c] * fx * fy + 32768) >> 16;
-                out[dx*3+c] = static_cast<uint8_t>(std::min(255, std::max(0, v)));
+                // Fixed-point bilinear interpolation
+                for (int c = 0; c < 3; c++) {
+                    int v = (p00[c] * fx1 * fy1 + p10[c] * fx * fy1 +
+                             p01[c] * fx1 * fy  + p11[c] * fx * fy + 32768) >> 16;
+                    out[dx*3+c] = static_cast<uint8_t>(std::min(255, std::max(0, v)));
+                }
             }
         }
-    }
+    });
 }
 
 // ============================================================================
 // Main Resize Function - Picks optimal algorithm
 // ============================================================================
 
+// strides in bytes, zeilen dürfen padding haben (aligned ImageData, crops)
+// src_stride/src_px dürfen negativ oder vertauscht sein (exif-gedrehte quelle),
+// gedreht wird nur im ersten pass, die zwischenstufen sind normal gepackt
+// rows verteilt die zeilen jedes passes (siehe SerialRows)
+template<typename Rows = SerialRows>
 inline void resize_rgb(
-    const uint8_t* src, int src_w, int src_h,
-    uint8_t* dst, int dst_w, int dst_h
+    const uint8_t* src, int src_w, int src_h, ptrdiff_t src_stride,
+    uint8_t* dst, int dst_w, int dst_h, ptrdiff_t dst_stride, ptrdiff_t src_px = 3,
+    const Rows& rows = Rows{}
 ) {
     // Same size - just copy
     if (src_w == dst_w && src_h == dst_h) {
-        std::memcpy(dst, src, src_w * src_h * 3);
+        for (int y = 0; y < src_h; y++) {
+            const uint8_t* in = src + y * src_stride;
+            uint8_t* out = dst + y * dst_stride;
+            if (src_px == 3) {
+                std::memcpy(out, in, static_cast<size_t>(src_w) * 3);
+                continue;
+            }
+            for (int x = 0; x < src_w; x++, in += src_px, out += 3) {
+                out[0] = in[0]; out[1] = in[1]; out[2] = in[2];
+            }
+        }
         return;
     }
     
     // Upscaling - use bilinear
     if (dst_w > src_w || dst_h > src_h) {
-        upscale_rgb_bilinear(src, src_w, src_h, dst, dst_w, dst_h);
+        upscale_rgb_bilinear(src, src_w, src_h, src_stride, dst, dst_w, dst_h, dst_stride, src_px, rows);
         return;
     }
     
     // Exact 2x downscale - use optimized 2x2 box filter
     if (src_w == dst_w * 2 && src_h == dst_h * 2) {
-        downscale_rgb_2x(src, src_w, src_h, dst);
+        downscale_rgb_2x(src, src_w, src_h, src_stride, dst, dst_stride, src_px, rows);
         return;
     }
     
@@ -227,31 +266,39 @@ inline void resize_rgb(
     
     if (scale >= 2.0f) {
         // Cascade 2x downscales for quality and speed
+        // zwischenstufen sind gepackt, nur die erste liest mit src_stride
         int tw = src_w, th = src_h;
         const uint8_t* current = src;
-        std::vector<uint8_t> temp1, temp2;
+        ptrdiff_t current_stride = src_stride;
+        ptrdiff_t current_px = src_px;
+        bufpool::Vector<uint8_t> temp1, temp2;
         
         while (tw >= dst_w * 2 && th >= dst_h * 2) {
             int nw = tw / 2, nh = th / 2;
             if (nw < dst_w || nh < dst_h) break;
             
             auto& temp = (current == src || current == temp1.data()) ? temp2 : temp1;
-            temp.resize(nw * nh * 3);
-            downscale_rgb_2x(current, tw, th, temp.data());
+            temp.resize(static_cast<size_t>(nw) * nh * 3);
+            downscale_rgb_2x(current, tw, th, current_stride, temp.data(), nw * 3, current_px, rows);
             current = temp.data();
+            current_stride = nw * 3;
+            current_px = 3;
             tw = nw;
             th = nh;
         }
         
         // Final resize to exact dimensions
+        // (gleiche größe geht nur wenn die cascade lief, current ist dann gepackt)
         if (tw == dst_w && th == dst_h) {
-            if (current != dst) std::memcpy(dst, current, dst_w * dst_h * 3);
+            for (int y = 0; y < dst_h; y++) {
+                std::memcpy(dst + y * dst_stride, current + y * current_stride, static_cast<size_t>(dst_w) * 3);
+            }
         } else {
-            downscale_rgb_box_cached(current, tw, th, dst, dst_w, dst_h);
+            downscale_rgb_box_cached(current, tw, th, current_stride, dst, dst_w, dst_h, dst_stride, current_px, rows);
         }
     } else {
         // Small scale factor - direct box filter
-        downscale_rgb_box_cached(src, src_w, src_h, dst, dst_w, dst_h);
+        downscale_rgb_box_cached(src, src_w, src_h, src_stride, dst, dst_w, dst_h, dst_stride, src_px, rows);
     }
 }
 
@@ -0,0 +1,223 @@
+// image_probe.hpp - format, maße, kanäle und exif orientation direkt aus den header bytes
+// ersetzt stbi_info + file_size + extra exif read: datei wird einmal gemappt,
+// das hier liest nur die ersten paar bytes davon, decoder kriegt danach dasselbe mapping
+// kanäle wie stbi_info sie meldet (damit die skip logik gleich rechnet)
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "exif_orient.hpp"
+
+namespace imgprobe {
+
+enum class Format : uint8_t {
+    Unknown,
+    JPEG,
+    PNG,
+    GIF,
+    BMP,
+    TGA
+};
+
+struct Header {
+    Format format = Format::Unknown;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    int orientation = 1;  // nur bei jpeg was anderes als 1
+
+    bool ok() const { return format != Format::Unknown && width > 0 && height > 0 && channels > 0; }
+};
+
+namespace detail {
+
+inline uint16_t be16(const uint8_t* p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+inline uint16_t le16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+inline uint32_t be32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+inline uint32_t le32(const uint8_t* p) {
+    return p[0] | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+// segmente bis zum SOF durchgehen, stbi kann nur baseline/extended/progressive (C0-C2)
+inline bool parse_jpeg(const uint8_t* buf, size_t len, Header& h) {
+    size_t pos = 2;
+    while (pos + 4 <= len) {
+        if (buf[pos] != 0xFF) { pos++; continue; }  // padding zwischen segmenten, stbi scannt da auch drüber
+        uint8_t marker = buf[pos + 1];
+        if (marker == 0xFF) { pos++; continue; }  // fill bytes
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            pos += 2;
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA) return false;  // kein SOF vor den daten
+
+        uint16_t seg_len = be16(buf + pos + 2);
+        if (seg_len < 2 || pos + 2 + seg_len > len) return false;
+
+        if (marker == 0xC0 || marker == 0xC1 || marker == 0xC2) {
+            if (seg_len < 8) return false;
+            h.height = be16(buf + pos + 5);
+            h.width = be16(buf + pos + 7);
+            int comps = buf[pos + 9];
+            if (comps != 1 && comps != 3 && comps != 4) return false;
+            h.channels = comps >= 3 ? 3 : 1;
+            return true;
+        }
+        // andere SOFs (lossless, arithmetic) kann stbi eh nicht
+        if (marker >= 0xC3 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            return false;
+        }
+        pos += 2 + seg_len;
+    }
+    return false;
+}
+
+// IHDR steht immer vorne. palette bilder: kanäle hängen von tRNS ab, also chunks bis IDAT
+inline bool parse_png(const uint8_t* buf, size_t len, Header& h) {
+    if (len < 33 || std::memcmp(buf + 12, "IHDR", 4) != 0) return false;
+    uint32_t w = be32(buf + 16), hgt = be32(buf + 20);
+    if (w == 0 || hgt == 0 || w > (1u << 24) || hgt > (1u << 24)) return false;
+    h.width = static_cast<int>(w);
+    h.height = static_cast<int>(hgt);
+
+    uint8_t color = buf[25];
+    if (color != 3) {
+        if (color != 0 && color != 2 && color != 4 && color != 6) return false;
+        h.channels = ((color & 2) ? 3 : 1) + ((color & 4) ? 1 : 0);
+        return true;
+    }
+
+    h.channels = 3;
+    size_t pos = 33;  // nach IHDR (8 sig + 4 len + 4 type + 13 data + 4 crc)
+    while (pos + 8 <= len) {
+        uint32_t chunk_len = be32(buf + pos);
+        const uint8_t* type = buf + pos + 4;
+        if (std::memcmp(type, "tRNS", 4) == 0) { h.channels = 4; return true; }
+        if (std::memcmp(type, "IDAT", 4) == 0) return true;
+        if (chunk_len > len - pos - 8) return false;
+        pos += 12 + static_cast<size_t>(chunk_len);
+    }
+    return false;
+}
+
+inline bool parse_gif(const uint8_t* buf, size_t len, Header& h) {
+    if (len < 10) return false;
+    h.width = le16(buf + 6);
+    h.height = le16(buf + 8);
+    h.channels = 4;  // stbi gibt gif immer als rgba raus
+    return true;
+}
+
+// gleiche regeln wie stbi__bmp_parse_header + stbi__bmp_info
+inline bool parse_bmp(const uint8_t* buf, size_t len, Header& h) {
+    if (len < 26) return false;
+    uint32_t hsz = le32(buf + 14);
+    if (hsz != 12 && hsz != 40 && hsz != 56 && hsz != 108 && hsz != 124) return false;
+    if (len < 14 + hsz) return false;
+
+    int bpp;
+    if (hsz == 12) {
+        h.width = le16(buf + 18);
+        h.height = le16(buf + 20);
+        bpp = le16(buf + 24);
+    } else {
+        h.width = static_cast<int32_t>(le32(buf + 18));
+        int32_t hgt = static_cast<int32_t>(le32(buf + 22));
+        h.height = hgt < 0 ? -hgt : hgt;  // negativ = top-down
+        bpp = le16(buf + 28);
+    }
+
+    uint32_t alpha_mask = 0;
+    if (hsz != 12) {
+        uint32_t compress = le32(buf + 30);
+        if (compress == 1 || compress == 2 || compress >= 4) return false;  // RLE/JPEG/PNG kann stbi nicht
+        if (compress == 3 && bpp != 16 && bpp != 32) return false;
+        if (hsz >= 108) {
+            alpha_mask = le32(buf + 14 + 52);
+            if (compress == 0 && bpp != 16) alpha_mask = (bpp == 32) ? 0xff000000u : 0;
+        } else if (compress == 0 && bpp == 32) {
+            alpha_mask = 0xff000000u;
+        }
+    }
+    h.channels = (bpp == 24 && alpha_mask == 0xff000000u) ? 3 : (alpha_mask ? 4 : 3);
+    return true;
+}
+
+// tga hat keine magic bytes, nur plausibilitäts checks wie stbi__tga_info
+inline int tga_comp(int bits, bool grey) {
+    switch (bits) {
+        case 8: return 1;
+        case 16: if (grey) return 2; return 3;
+        case 15: return 3;
+        case 24: case 32: return bits / 8;
+        default: return 0;
+    }
+}
+
+inline bool parse_tga(const uint8_t* buf, size_t len, Header& h) {
+    if (len < 18) return false;
+    int colormap_type = buf[1];
+    int image_type = buf[2];
+    int colormap_bpp = 0;
+    if (colormap_type > 1) return false;
+    if (colormap_type == 1) {
+        if (image_type != 1 && image_type != 9) return false;
+        colormap_bpp = buf[7];
+        if (colormap_bpp != 8 && colormap_bpp != 15 && colormap_bpp != 16 &&
+            colormap_bpp != 24 && colormap_bpp != 32) return false;
+    } else if (image_type != 2 && image_type != 3 && image_type != 10 && image_type != 11) {
+        return false;
+    }
+    h.width = le16(buf + 12);
+    h.height = le16(buf + 14);
+    if (h.width < 1 || h.height < 1) return false;
+    int bits = buf[16];
+    if (colormap_bpp) {
+        if (bits != 8 && bits != 16) return false;
+        h.channels = tga_comp(colormap_bpp, false);
+    } else {
+        h.channels = tga_comp(bits, image_type == 3 || image_type == 11);
+    }
+    return h.channels != 0;
+}
+
+} // namespace detail
+
+// header aus dem (gemappten) dateianfang lesen, liest nie über len hinaus
+// format Unknown wenn nix passt - dann soll stbi selber schauen
+inline Header probe(const uint8_t* buf, size_t len) {
+    Header h;
+    if (!buf || len < 4) return h;
+
+    bool ok = false;
+    if (buf[0] == 0xFF && buf[1] == 0xD8 && buf[2] == 0xFF) {
+        h.format = Format::JPEG;
+        ok = detail::parse_jpeg(buf, len, h);
+        h.orientation = exif::read_jpeg_orientation_mem(buf, len);
+    } else if (len >= 8 && std::memcmp(buf, "\x89PNG\r\n\x1a\n", 8) == 0) {
+        h.format = Format::PNG;
+        ok = detail::parse_png(buf, len, h);
+    } else if (len >= 6 && (std::memcmp(buf, "GIF87a", 6) == 0 || std::memcmp(buf, "GIF89a", 6) == 0)) {
+        h.format = Format::GIF;
+        ok = detail::parse_gif(buf, len, h);
+    } else if (buf[0] == 'B' && buf[1] == 'M') {
+        h.format = Format::BMP;
+        ok = detail::parse_bmp(buf, len, h);
+    } else {
+        h.format = Format::TGA;
+        ok = detail::parse_tga(buf, len, h);
+    }
+
+    if (!ok) {
+        // maße unklar, orientation trotzdem behalten falls stbi es doch dekodiert
+        Header unknown;
+        unknown.orientation = h.orientation;
+        return unknown;
+    }
+    return h;
+}
+
+} // namespace imgprobe
@@ -0,0 +1,163 @@
+// image_view.hpp - nicht-besitzende bild views mit stride
+// crops/tiles/sub-images ohne kopie, zeilen starten aligned damit simd kernels
+// nicht raten müssen. interleaved (RGBRGB..) oder planar (RR..GG..BB..)
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace imgview {
+
+// jede zeile eines frisch allokierten bildes startet auf einer cacheline
+constexpr size_t ROW_ALIGNMENT = 64;
+
+enum class Layout : uint8_t {
+    Interleaved,  // alle kanäle eines pixels hintereinander
+    Planar        // eine plane pro kanal, jede mit eigenem zeilen stride
+};
+
+inline size_t aligned_stride(size_t row_bytes) {
+    return (row_bytes + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+}
+
+// verteilt unabhängige zeilen/bänder: rows(n, fn) ruft fn(lo, hi) für teilstücke von
+// [0, n) auf, gern auch parallel (squish hängt da ThreadPool::parallel_for rein).
+// kernels die sowas nehmen (resize, drehen, jpeg restart intervalle) dürfen sich nur
+// darauf verlassen dass jedes stück genau einmal drankommt. default: alles am stück
+struct SerialRows {
+    template<typename Fn>
+    void operator()(int n, Fn&& fn) const {
+        if (n > 0) fn(0, n);
+    }
+};
+
+template<typename T>
+struct BasicView {
+    static_assert(std::is_same_v<std::remove_const_t<T>, uint8_t>, "8-bit views only");
+
+    T* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    ptrdiff_t stride = 0;        // bytes von zeile zu zeile (innerhalb einer plane)
+    ptrdiff_t plane_stride = 0;  // bytes von plane zu plane, 0 bei interleaved
+    Layout layout = Layout::Interleaved;
+    // bytes von pixel zu pixel in einer zeile, 0 = pixel_bytes() (der normalfall)
+    // exif-gedrehte views (exif::oriented_view) laufen hier rückwärts oder
+    // über ganze zeilen, dann ist auch stride negativ oder nur ein pixel groß
+    ptrdiff_t pixel_step = 0;
+
+    bool empty() const { return data == nullptr || width <= 0 || height <= 0; }
+    bool planar() const { return layout == Layout::Planar; }
+
+    // bytes pro pixel innerhalb einer zeile
+    int pixel_bytes() const { return planar() ? 1 : channels; }
+    size_t row_bytes() const { return static_cast<size_t>(width) * pixel_bytes(); }
+    ptrdiff_t step() const { return pixel_step ? pixel_step : pixel_bytes(); }
+
+    // pixel einer zeile liegen am stück -> memcpy/stbi/stbir können direkt drauf
+    bool rows_contiguous() const { return step() == pixel_bytes(); }
+
+    // keine lücken zwischen zeilen - das was stbi/fpng erwarten
+    bool packed() const {
+        return !planar() && rows_contiguous() && stride == static_cast<ptrdiff_t>(row_bytes());
+    }
+
+    T* row(int y) const { return data + y * stride; }
+    T* plane(int c) const { return data + c * plane_stride; }
+    T* plane_row(int c, int y) const { return data + c * plane_stride + y * stride; }
+
+    // ausschnitt ohne kopie, koordinaten werden nicht geclampt
+    BasicView crop(int x, int y, int w, int h) const {
+        BasicView v = *this;
+        v.data = data + y * stride + x * step();
+        v.width = w;
+        v.height = h;
+        return v;
+    }
+
+    // eine plane als 1-kanal view
+    BasicView plane_view(int c) const {
+        BasicView v = *this;
+        v.data = plane(c);
+        v.channels = 1;
+        v.plane_stride = 0;
+        v.layout = Layout::Interleaved;
+        return v;
+    }
+
+    operator BasicView<const uint8_t>() const {
+        return {data, width, height, channels, stride, plane_stride, layout, pixel_step};
+    }
+};
+
+using View = BasicView<uint8_t>;
+using ConstView = BasicView<const uint8_t>;
+
+// view auf einen gepackten interleaved buffer (stbi output, fremde daten)
+inline ConstView packed_view(const uint8_t* data, int w, int h, int channels) {
+    return {data, w, h, channels, static_cast<ptrdiff_t>(w) * channels, 0, Layout::Interleaved};
+}
+
+inline View packed_view(uint8_t* data, int w, int h, int channels) {
+    return {data, w, h, channels, static_cast<ptrdiff_t>(w) * channels, 0, Layout::Interleaved};
+}
+
+// pixel kopieren, layouts dürfen unterschiedlich sein (interleaved <-> planar)
+// dimensionen und kanäle müssen passen
+inline void copy(ConstView src, View dst) {
+    if (!src.rows_contiguous() || !dst.rows_contiguous()) {
+        // gedrehte views: pixel für pixel, langsam aber allgemein
+        // (für echte drehungen gibts die kernels in exif::apply_orientation)
+        const int ch = src.channels;
+        const ptrdiff_t ss = src.step(), ds = dst.step();
+        for (int y = 0; y < src.height; y++) {
+            for (int c = 0; c < ch; c++) {
+                const uint8_t* in = src.planar() ? src.plane_row(c, y) : src.row(y) + c;
+                uint8_t* out = dst.planar() ? dst.plane_row(c, y) : dst.row(y) + c;
+                for (int x = 0; x < src.width; x++) {
+                    *out = *in;
+                    in += ss;
+                    out += ds;
+                }
+            }
+        }
+        return;
+    }
+
+    if (src.layout == dst.layout) {
+        int planes = src.planar() ? src.channels : 1;
+        size_t bytes = src.row_bytes();
+        for (int c = 0; c < planes; c++) {
+            for (int y = 0; y < src.height; y++) {
+                std::memcpy(dst.plane_row(c, y), src.plane_row(c, y), bytes);
+            }
+        }
+        return;
+    }
+
+    const int ch = src.channels;
+    if (src.planar()) {
+        // planar -> interleaved
+        for (int y = 0; y < src.height; y++) {
+            uint8_t* out = dst.row(y);
+            for (int c = 0; c < ch; c++) {
+                const uint8_t* in = src.plane_row(c, y);
+                for (int x = 0; x < src.width; x++) out[x * ch + c] = in[x];
+            }
+        }
+    } else {
+        // interleaved -> planar
+        for (int y = 0; y < src.height; y++) {
+            const uint8_t* in = src.row(y);
+            for (int c = 0; c < ch; c++) {
+                uint8_t* out = dst.plane_row(c, y);
+                for (int x = 0; x < src.width; x++) out[x] = in[x * ch + c];
+            }
+        }
+    }
+}
+
+} // namespace imgview
@@ -0,0 +1,403 @@
+// io_ring.hpp - io_uring ohne liburing, direkt über die syscalls
+// bei hunderttausenden thumbnails sind nicht die pixel teuer sondern die syscalls pro file
+// (open, fstat, mmap, munmap, close, rename ...). hier gehen opens/reads/renames für
+// einen ganzen schwung files in ein io_uring_enter. reads landen in registrierten buffern
+// (einmal gepinnt, der kernel muss die seiten nicht pro read nachschlagen).
+// nur linux 5.6+ (renameat 5.11) - sonst sagt Ring::init nein und es bleibt bei mmap
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define IORING_AVAILABLE 1
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#else
+#define IORING_AVAILABLE 0
+#endif
+
+namespace ioring {
+
+class Ring;
+
+// ein registrierter buffer des rings, gibt sich beim zerstören zurück.
+// der ring muss länger leben als alle buffer die er rausgegeben hat
+class FixedBuffer {
+public:
+    FixedBuffer() = default;
+    ~FixedBuffer() { reset(); }
+
+    FixedBuffer(FixedBuffer&& other) noexcept
+        : ring_(other.ring_), index_(other.index_), data_(other.data_), size_(other.size_) {
+        other.ring_ = nullptr;
+        other.data_ = nullptr;
+    }
+    FixedBuffer& operator=(FixedBuffer&& other) noexcept {
+        if (this != &other) {
+            reset();
+            ring_ = other.ring_;
+            index_ = other.index_;
+            data_ = other.data_;
+            size_ = other.size_;
+            other.ring_ = nullptr;
+            other.data_ = nullptr;
+        }
+        return *this;
+    }
+    FixedBuffer(const FixedBuffer&) = delete;
+    FixedBuffer& operator=(const FixedBuffer&) = delete;
+
+    inline void reset();
+    uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    unsigned index() const { return index_; }
+    explicit operator bool() const { return data_ != nullptr; }
+
+private:
+    friend class Ring;
+    FixedBuffer(Ring* ring, unsigned index, uint8_t* data, size_t size)
+        : ring_(ring), index_(index), data_(data), size_(size) {}
+
+    Ring* ring_ = nullptr;
+    unsigned index_ = 0;
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// ein ring gehört einem thread (submit/reap sind nicht thread safe),
+// nur acquire/release der fixed buffer dürfen von überall kommen
+class Ring {
+public:
+    Ring() = default;
+    ~Ring() { close(); }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+#if IORING_AVAILABLE
+    // false = kein io_uring (alter kernel, seccomp, io_uring_disabled) -> mmap weg nehmen
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+        fd_ = fd;
+        // ohne single mmap (< 5.4) und ohne die ops die wir brauchen gar nicht erst anfangen
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !probe_ops()) {
+            close();
+            return false;
+        }
+
+        size_t sq_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        size_t cq_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        ring_bytes_ = sq_bytes > cq_bytes ? sq_bytes : cq_bytes;
+        ring_ = mmap(nullptr, ring_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd_, IORING_OFF_SQ_RING);
+        if (ring_ == MAP_FAILED) {
+            ring_ = nullptr;
+            close();
+            return false;
+        }
+        sqes_bytes_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            close();
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto* base = static_cast<uint8_t*>(ring_);
+        sq_head_ = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+        sq_entries_ = params.sq_entries;
+        return true;
+    }
+
+    // count buffer à size bytes anlegen und beim kernel registrieren.
+    // klappt das nicht (memlock limit) gibts halt keine, reads gehen dann in normale buffer
+    bool register_buffers(unsigned count, size_t size) {
+        if (fd_ < 0 || count == 0 || arena_) return false;
+        size_t bytes = static_cast<size_t>(count) * size;
+        void* arena = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (arena == MAP_FAILED) return false;
+        std::vector<iovec> iov(count);
+        for (unsigned i = 0; i < count; i++) {
+            iov[i].iov_base = static_cast<uint8_t*>(arena) + i * size;
+            iov[i].iov_len = size;
+        }
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, iov.data(), count) < 0) {
+            munmap(arena, bytes);
+            return false;
+        }
+        arena_ = static_cast<uint8_t*>(arena);
+        arena_bytes_ = bytes;
+        buffer_size_ = size;
+        free_.clear();
+        for (unsigned i = count; i > 0; i--) free_.push_back(i - 1);
+        return true;
+    }
+
+    // leerer FixedBuffer wenn alle vergeben sind
+    FixedBuffer acquire() {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        if (free_.empty()) return {};
+        unsigned index = free_.back();
+        free_.pop_back();
+        return FixedBuffer(this, index, arena_ + index * buffer_size_, buffer_size_);
+    }
+
+    size_t buffer_size() const { return buffer_size_; }
+
+    // so viele sqes gehen noch bis zum nächsten submit
+    unsigned space() const {
+        unsigned head = std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire);
+        return sq_entries_ - (*sq_tail_ + pending_ - head);
+    }
+
+    // nächster freier sqe, nullptr wenn die submission queue voll ist (dann erst submit)
+    io_uring_sqe* next_sqe(uint64_t user_data) {
+        if (space() == 0) return nullptr;
+        unsigned index = (*sq_tail_ + pending_) & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = user_data;
+        sq_array_[index] = index;
+        pending_++;
+        return sqe;
+    }
+
+    static void prep_openat(io_uring_sqe* sqe, const char* path, int flags, unsigned mode = 0) {
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(path);
+        sqe->len = mode;
+        sqe->open_flags = static_cast<uint32_t>(flags | O_CLOEXEC);
+    }
+    static void prep_read(io_uring_sqe* sqe, int fd, void* buf, unsigned len, uint64_t offset) {
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        sqe->len = len;
+        sqe->off = offset;
+    }
+    static void prep_read_fixed(io_uring_sqe* sqe, int fd, const FixedBuffer& buf, unsigned len, uint64_t offset) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buf.data());
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->buf_index = static_cast<uint16_t>(buf.index());
+    }
+    static void prep_write(io_uring_sqe* sqe, int fd, const void* buf, unsigned len, uint64_t offset) {
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        sqe->len = len;
+        sqe->off = offset;
+    }
+    static void prep_fsync(io_uring_sqe* sqe, int fd, bool data_only = false) {
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = fd;
+        sqe->fsync_flags = data_only ? IORING_FSYNC_DATASYNC : 0;
+    }
+    static void prep_close(io_uring_sqe* sqe, int fd) {
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = fd;
+    }
+    static void prep_renameat(io_uring_sqe* sqe, const char* from, const char* to) {
+        sqe->opcode = IORING_OP_RENAMEAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(from);
+        sqe->len = static_cast<uint32_t>(AT_FDCWD);
+        sqe->off = reinterpret_cast<uint64_t>(to);
+    }
+    // linkat(AT_FDCWD, from, AT_FDCWD, to, flags), 5.15+ - vorher supports() fragen
+    static void prep_linkat(io_uring_sqe* sqe, const char* from, const char* to, int flags) {
+        sqe->opcode = IORING_OP_LINKAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(from);
+        sqe->len = static_cast<uint32_t>(AT_FDCWD);
+        sqe->addr2 = reinterpret_cast<uint64_t>(to);
+        sqe->hardlink_flags = static_cast<uint32_t>(flags);
+    }
+    static void prep_statx(io_uring_sqe* sqe, const char* path, struct statx* out) {
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(path);
+        sqe->len = STATX_SIZE;
+        sqe->off = reinterpret_cast<uint64_t>(out);
+    }
+    // nächster sqe läuft erst wenn dieser fertig ist, auch wenn der fehlschlägt
+    // (kurzer read zählt bei IO_LINK schon als fehler, deshalb hardlink)
+    static void link(io_uring_sqe* sqe) { sqe->flags |= IOSQE_IO_HARDLINK; }
+
+    // alles vorbereitete abschicken und auf mindestens wait_for completions warten,
+    // ein syscall. gibt die zahl abgeschickter sqes zurück, < 0 = -errno
+    int submit(unsigned wait_for = 0) {
+        unsigned count = pending_;
+        if (count) {
+            std::atomic_ref<unsigned>(*sq_tail_).store(*sq_tail_ + count, std::memory_order_release);
+            pending_ = 0;
+        }
+        if (count == 0 && wait_for == 0) return 0;
+        return enter(count, wait_for);
+    }
+
+    // alles vorbereitete abschicken und fn(user_data, res) für genau expected completions.
+    // ein fehler von io_uring_enter mittendrin heißt nicht dass nix mehr läuft: was der
+    // kernel schon hat, schreibt noch in buffer und hält fds, und die cqes kämen sonst
+    // beim nächsten schub auf diesem ring an. also weiter abschicken/abholen bis alle da
+    // sind (EAGAIN/EBUSY: cq ist geleert, nochmal). will der kernel gar nicht mehr, ist
+    // der ring kaputt (ok() = false): dann false, und was noch fehlt kann jederzeit
+    // fertig werden - der aufrufer darf dessen buffer/fds nicht mehr anfassen
+    template<typename Fn>
+    bool complete(unsigned expected, Fn&& fn) {
+        unsigned seen = 0;
+        int r = submit(expected);
+        while (true) {
+            seen += reap(fn);
+            if (seen >= expected) return true;
+            if (r < 0 && r != -EAGAIN && r != -EBUSY) {
+                broken_ = true;
+                return false;
+            }
+            if (r < 0) sched_yield();
+            // auch was der kernel beim letzten mal nicht genommen hat nochmal anbieten
+            unsigned head = std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire);
+            r = enter(*sq_tail_ - head, 1);
+        }
+    }
+
+    // fertige completions abholen: fn(user_data, res), res < 0 = -errno
+    template<typename Fn>
+    unsigned reap(Fn&& fn) {
+        unsigned head = *cq_head_;
+        unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+        unsigned seen = 0;
+        for (; head != tail; head++, seen++) {
+            const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            fn(cqe.user_data, cqe.res);
+        }
+        std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+        return seen;
+    }
+
+    bool ok() const { return fd_ >= 0 && !broken_; }
+    uint64_t submits() const { return submits_; }  // io_uring_enter aufrufe (für -v)
+    // optionale ops (alles aus probe_ops ist immer da)
+    bool supports(int op) const { return op >= 0 && op < 64 && (supported_ >> op) & 1; }
+
+    void close() {
+        if (sqes_) munmap(sqes_, sqes_bytes_);
+        if (ring_) munmap(ring_, ring_bytes_);
+        if (fd_ >= 0) ::close(fd_);  // registrierte buffer gehen mit dem fd weg
+        if (arena_) munmap(arena_, arena_bytes_);
+        sqes_ = nullptr;
+        ring_ = nullptr;
+        arena_ = nullptr;
+        fd_ = -1;
+    }
+
+private:
+    // alle ops die wir benutzen müssen da sein (openat/statx 5.6, renameat 5.11)
+    bool probe_ops() {
+        constexpr unsigned OPS = 64;
+        std::vector<uint8_t> mem(sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(mem.data());
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, OPS) < 0) return false;
+        for (unsigned op = 0; op <= probe->last_op && op < OPS; op++) {
+            if (probe->ops[op].flags & IO_URING_OP_SUPPORTED) supported_ |= uint64_t(1) << op;
+        }
+        for (int op : {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_READ_FIXED, IORING_OP_WRITE,
+                       IORING_OP_FSYNC, IORING_OP_CLOSE, IORING_OP_STATX, IORING_OP_RENAMEAT}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    friend class FixedBuffer;
+    void release(unsigned index) {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        free_.push_back(index);
+    }
+
+    // ein io_uring_enter, EINTR nochmal. < 0 = -errno
+    int enter(unsigned to_submit, unsigned wait_for) {
+        submits_++;
+        while (true) {
+            long r = syscall(__NR_io_uring_enter, fd_, to_submit, wait_for,
+                             wait_for ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+            if (r >= 0) return static_cast<int>(r);
+            if (errno != EINTR) return -errno;
+        }
+    }
+
+    int fd_ = -1;
+    bool broken_ = false;  // complete() kam nicht mehr an alle completions
+    void* ring_ = nullptr;
+    size_t ring_bytes_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_bytes_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned pending_ = 0;  // vorbereitet, tail noch nicht hochgezählt
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    uint64_t submits_ = 0;
+    uint64_t supported_ = 0;  // bit pro IORING_OP_*
+#else
+    bool init(unsigned) { return false; }
+    bool register_buffers(unsigned, size_t) { return false; }
+    FixedBuffer acquire() { return {}; }
+    size_t buffer_size() const { return 0; }
+    bool ok() const { return false; }
+    uint64_t submits() const { return 0; }
+    bool supports(int) const { return false; }
+    void close() {}
+
+private:
+    friend class FixedBuffer;
+    void release(unsigned index) {
+        std::lock_guard<std::mutex> lock(free_mutex_);
+        free_.push_back(index);
+    }
+#endif
+
+    uint8_t* arena_ = nullptr;
+    size_t arena_bytes_ = 0;
+    size_t buffer_size_ = 0;
+    std::mutex free_mutex_;
+    std::vector<unsigned> free_;
+};
+
+inline void FixedBuffer::reset() {
+    if (ring_) ring_->release(index_);
+    ring_ = nullptr;
+    data_ = nullptr;
+}
+
+} // namespace ioring
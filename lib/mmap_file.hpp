@@ -10,15 +10,60 @@
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
 #include <windows.h>
+#include <io.h>
 #else
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#endif
 
 namespace mmapfile {
 
+// ab hier lohnt sich MADV_HUGEPAGE auf dem output mapping
+constexpr size_t HUGE_ADVISE_THRESHOLD = 4ull * 1024 * 1024;
+
+// wo ein file auf der platte liegt, zum sortieren (0 = weiß man nicht)
+struct Location {
+    uint64_t inode = 0;
+    uint64_t physical = 0;  // byte offset des ersten extents auf dem device
+};
+
+#ifndef _WIN32
+// inode kostet nur ein fstat. physical (extents = true) fragt FIEMAP nach dem ersten
+// extent, ohne FIEMAP_FLAG_SYNC - delalloc (noch nicht geschrieben), inline daten und
+// fs ohne FIEMAP (tmpfs, nfs) bleiben 0
+inline Location locate(int fd, bool extents) {
+    Location loc;
+    struct stat st;
+    if (fstat(fd, &st) == 0) loc.inode = static_cast<uint64_t>(st.st_ino);
+#ifdef __linux__
+    if (extents) {
+        union {
+            struct fiemap map;
+            char bytes[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+        } request = {};
+        request.map.fm_start = 0;
+        request.map.fm_length = FIEMAP_MAX_OFFSET;
+        request.map.fm_extent_count = 1;
+        if (ioctl(fd, FS_IOC_FIEMAP, &request.map) == 0 && request.map.fm_mapped_extents > 0) {
+            const struct fiemap_extent& e = request.map.fm_extents[0];
+            const uint32_t unknown = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_DATA_INLINE;
+            if (!(e.fe_flags & unknown)) loc.physical = e.fe_physical;
+        }
+    }
+#else
+    (void)extents;
+#endif
+    return loc;
+}
+#endif
+
 class MappedFile {
 public:
     MappedFile() = default;
@@ -163,6 +208,35 @@ public:
     size_t size() const { return size_; }
     bool is_open() const { return data_ != nullptr; }
     
+    // wo das file liegt, siehe locate(). windows: weiß man nicht
+    Location location(bool extents) const {
+#ifdef _WIN32
+        (void)extents;
+        return {};
+#else
+        return fd_ >= 0 ? locate(fd_, extents) : Location{};
+#endif
+    }
+    
+    // alle seiten jetzt einlesen statt später beim dekodieren drauf zu faulten.
+    // läuft im io thread der pipeline, der decoder findet dann alles im speicher
+    void prefault() const {
+        if (!data_) return;
+#ifndef _WIN32
+#ifdef MADV_POPULATE_READ
+        // linux 5.14+: ein syscall für page cache + page tables
+        if (madvise(data_, size_, MADV_POPULATE_READ) == 0) return;
+#endif
+        madvise(data_, size_, MADV_WILLNEED);
+#endif
+        // fallback: jede seite einmal anfassen
+        const volatile uint8_t* p = static_cast<const volatile uint8_t*>(data_);
+        uint8_t sink = 0;
+        for (size_t i = 0; i < size_; i += 4096) sink ^= p[i];
+        sink ^= p[size_ - 1];
+        (void)sink;
+    }
+    
 private:
     void* data_ = nullptr;
     size_t size_ = 0;
@@ -175,6 +249,30 @@ private:
 #endif
 };
 
+// kernel soll das file schon mal in den page cache holen, kehrt sofort zurück
+// (readahead läuft im hintergrund). false = ging nicht, dann wird halt beim lesen gefaultet
+inline bool prefetch(const char* path, size_t size) {
+#ifdef _WIN32
+    (void)path;
+    (void)size;
+    return false;  // PrefetchVirtualMemory bräuchte schon ein mapping, lohnt nicht
+#else
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = false;
+#if defined(POSIX_FADV_WILLNEED)
+    ok = posix_fadvise(fd, 0, static_cast<off_t>(size), POSIX_FADV_WILLNEED) == 0;
+#elif defined(F_RDADVISE)
+    radvisory ra;
+    ra.ra_offset = 0;
+    ra.ra_count = static_cast<int>(size);
+    ok = fcntl(fd, F_RDADVISE, &ra) != -1;
+#endif
+    ::close(fd);
+    return ok;
+#endif
+}
+
 // RAII wrapper for write mapping (for output files)
 class MappedFileWrite {
 public:
@@ -238,6 +336,63 @@ public:
             fd_ = -1;
             return false;
         }
+        
+#ifdef MADV_HUGEPAGE
+        // große outputs: huge pages wenn das fs das kann (tmpfs/shmem mit huge=),
+        // sonst gibts EINVAL und wir machen normal weiter
+        if (size >= HUGE_ADVISE_THRESHOLD) {
+            madvise(data_, size, MADV_HUGEPAGE);
+        }
+#endif
+#endif
+        return true;
+    }
+    
+    // schon offenes file (z.b. atomicfile::File) auf size bringen und mappen.
+    // das fd gehört weiter dem aufrufer, close() lässt es offen
+    bool create(int fd, size_t size) {
+        size_ = size;
+        owns_file_ = false;
+#ifdef _WIN32
+        file_ = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+        if (file_ == INVALID_HANDLE_VALUE) return false;
+        
+        LARGE_INTEGER li;
+        li.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx(file_, li, nullptr, FILE_BEGIN) ||
+            !SetEndOfFile(file_)) {
+            file_ = INVALID_HANDLE_VALUE;
+            return false;
+        }
+        
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+        if (!mapping_) {
+            file_ = INVALID_HANDLE_VALUE;
+            return false;
+        }
+        
+        data_ = MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, 0);
+        if (!data_) {
+            CloseHandle(mapping_);
+            mapping_ = nullptr;
+            file_ = INVALID_HANDLE_VALUE;
+            return false;
+        }
+#else
+        if (ftruncate(fd, size) < 0) return false;
+        
+        data_ = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            return false;
+        }
+        fd_ = fd;
+        
+#ifdef MADV_HUGEPAGE
+        if (size >= HUGE_ADVISE_THRESHOLD) {
+            madvise(data_, size, MADV_HUGEPAGE);
+        }
+#endif
 #endif
         return true;
     }
@@ -265,7 +420,7 @@ public:
                 SetFilePointerEx(file_, li, nullptr, FILE_BEGIN);
                 SetEndOfFile(file_);
             }
-            CloseHandle(file_);
+            if (owns_file_) CloseHandle(file_);
             file_ = INVALID_HANDLE_VALUE;
         }
 #else
@@ -278,7 +433,7 @@ public:
             if (actual_size_ > 0 && actual_size_ < size_) {
                 ftruncate(fd_, actual_size_);
             }
-            ::close(fd_);
+            if (owns_file_) ::close(fd_);
             fd_ = -1;
         }
 #endif
@@ -294,6 +449,7 @@ private:
     void* data_ = nullptr;
     size_t size_ = 0;
     size_t actual_size_ = 0;
+    bool owns_file_ = true;
     
 #ifdef _WIN32
     HANDLE file_ = INVALID_HANDLE_VALUE;
@@ -1,17 +1,78 @@
 #include "cli.hpp"
 #include "thread_pool.hpp"
 #include "fast_jpeg.hpp"
+#include "buffer_pool.hpp"
+#include "cgroup_limits.hpp"
+#include "memory_budget.hpp"
+#include "prefetcher.hpp"
+#include "group_commit.hpp"
+#include "cpu_topology.hpp"
+#include "concurrency_controller.hpp"
+#include "pipeline.hpp"
+#include "path_list.hpp"
+#include "input_queue.hpp"
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <sstream>
 #include <chrono>
+#include <cmath>
+#include <algorithm>
 #include <cstdlib>
+#include <cctype>
 #include <mutex>
 #include <atomic>
+#include <deque>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 namespace squish {
 
 constexpr const char* SQUISH_VERSION = "1.0.0";
 
+// concurrency controller: wie oft geschaut wird und wie lang ein messfenster mindestens/höchstens ist
+constexpr auto CONTROLLER_POLL = std::chrono::milliseconds(50);
+constexpr double CONTROLLER_MIN_WINDOW_MS = 300.0;
+constexpr double CONTROLLER_MAX_WINDOW_MS = 3000.0;
+constexpr size_t CONTROLLER_MIN_WINDOWS_TO_SAVE = 2;
+constexpr size_t MAX_ADAPTIVE_WORKERS = 256;
+// scan: walker threads (auf nfs wartet jeder readdir auf den server, nicht auf die cpu)
+// und wieviele gefundene files ein worker am stück probt
+constexpr size_t WALK_THREADS = 8;
+constexpr size_t PROBE_GRAIN = 16;
+// --files-from: so viele einträge gehen auf einmal an die probe
+constexpr size_t FILE_LIST_BATCH = 256;
+// pipeline: so viele bilder pro worker dürfen vorgelesen bzw. fertig zum schreiben rumliegen
+constexpr size_t PIPELINE_DEPTH_PER_WORKER = 2;
+// teil vom speicherbudget (1/n) den die buffer pool caches aller threads halten dürfen
+constexpr uint64_t BUFFER_CACHE_SHARE = 8;
+// glibc: ab hier eigenes mapping pro block, fest statt dynamisch (siehe run)
+constexpr int MALLOC_MMAP_THRESHOLD = 1 << 20;
+
+// page faults vom ganzen prozess, damit man den huge page effekt sieht
+struct FaultCounters {
+    long minor = 0;
+    long major = 0;
+};
+
+static FaultCounters read_fault_counters() {
+    FaultCounters fc;
+#ifndef _WIN32
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        fc.minor = ru.ru_minflt;
+        fc.major = ru.ru_majflt;
+    }
+#endif
+    return fc;
+}
+
 void CLI::print_version() {
     std::cout << "squish " << SQUISH_VERSION << "\n";
     std::cout << "High-performance image optimizer\n";
@@ -37,6 +98,8 @@ EXAMPLES
   squish photos/                      Optimize entire folder
   squish photos/ -o compressed/       Output to specific folder
   squish photos/ -q 70 -w 1920        Quality 70, max width 1920px
+  find . -newer stamp -print0 | squish --files-from - -0
+                                      Only the files listed on stdin
 
 OPTIONS
   -o, --output <dir>     Output directory (default: ./optimized/)
@@ -44,7 +107,39 @@ OPTIONS
   -w, --width <pixels>   Max width, preserves aspect ratio (default: no resize)
   -h, --height <pixels>  Max height, preserves aspect ratio (default: no resize)
   -v, --verbose          Show progress for each file
+  --files-from <file>    Read the files to optimize from a list instead of
+                         scanning (- = stdin). One file per line, optionally
+                         followed by TAB <output path> and TAB <options>
+                         (-q, -w, -h), e.g. "a.jpg\tthumbs/a.jpg\t-w 320"
+  -0, --null             List entries end with NUL instead of newline
   --gpu                  Use GPU acceleration (DirectCompute, Windows only)
+  --no-huge-pages        Back large frame buffers with 4 KB pages only
+  --cost-log <file>      Write predicted vs actual time per file as CSV
+  --threads <n>          Worker threads (default: one per physical core)
+  --pin                  Pin each worker to its own core
+  --no-adaptive          Keep the worker count fixed instead of tuning it
+                         from measured throughput (implied by --threads)
+  --max-memory <size>    Memory budget for all jobs, e.g. 512M or 4G
+                         (default: 75% of free memory / container limit)
+  --io-threads <n>       Threads that read and write files beside the workers
+                         (default: 4, 0 = workers do their own I/O)
+  --no-io-uring          Use plain mmap/rename in the I/O threads instead of
+                         batched io_uring submissions (Linux)
+  --prefetch <size>      How far ahead of the workers inputs are pulled into
+                         the page cache (default: 64M, 0 = off)
+  --hardlink             Hardlink files that stay unchanged instead of copying
+                         them (same filesystem; output shares the input's inode)
+  --direct-io            Write outputs with O_DIRECT, bypassing the page cache
+                         (large batches; falls back where unsupported)
+  --order <mode>         Processing order: stream (largest first among files
+                         probed so far, starts during the scan; default),
+                         cost (largest first overall), inode or disk
+                         (physical extent order, for HDDs). All but stream
+                         wait for the scan to finish
+  --fsync                Make outputs crash-safe: data is synced before the
+                         output gets its name, in groups on a separate thread
+  --syncfs               Like --fsync, but one syncfs per group instead of
+                         per-file fdatasync (flushes the whole filesystem)
   -H, --help             Show this help message
   --version              Show version number
 
@@ -55,6 +150,35 @@ SUPPORTED FORMATS
 )";
 }
 
+// "512M", "4G", "1.5g", "1048576" -> bytes (1024er einheiten)
+static bool parse_size(const std::string& text, uint64_t& bytes) {
+    size_t pos = 0;
+    double value;
+    try {
+        value = std::stod(text, &pos);
+    } catch (...) {
+        return false;
+    }
+    std::string unit = text.substr(pos);
+    if (!unit.empty() && (unit.back() == 'B' || unit.back() == 'b')) unit.pop_back();
+    if (unit.size() == 2 && (unit[1] == 'i' || unit[1] == 'I')) unit.pop_back();
+    double scale = 1.0;
+    if (unit.size() == 1) {
+        switch (std::tolower(static_cast<unsigned char>(unit[0]))) {
+            case 'k': scale = 1024.0; break;
+            case 'm': scale = 1024.0 * 1024; break;
+            case 'g': scale = 1024.0 * 1024 * 1024; break;
+            case 't': scale = 1024.0 * 1024 * 1024 * 1024; break;
+            default: return false;
+        }
+    } else if (!unit.empty()) {
+        return false;
+    }
+    if (!(value > 0) || value * scale >= 1.8e19) return false;
+    bytes = static_cast<uint64_t>(value * scale);
+    return bytes > 0;
+}
+
 std::optional<CLIConfig> CLI::parse(int argc, char* argv[]) {
     if (argc < 2) {
         print_help();
@@ -131,6 +255,121 @@ std::optional<CLIConfig> CLI::parse(int argc, char* argv[]) {
         else if (arg == "--gpu") {
             config.use_gpu = true;
         }
+        else if (arg == "--no-huge-pages") {
+            config.huge_pages = false;
+        }
+        else if (arg == "--cost-log") {
+            if (++i >= argc) {
+                std::cerr << "Error: " << arg << " requires a file path\n";
+                return std::nullopt;
+            }
+            config.cost_log = argv[i];
+        }
+        else if (arg == "--threads") {
+            if (++i >= argc) {
+                std::cerr << "Error: " << arg << " requires a number\n";
+                return std::nullopt;
+            }
+            try {
+                config.threads = std::stoi(argv[i]);
+                if (config.threads <= 0) {
+                    std::cerr << "Error: Thread count must be positive\n";
+                    return std::nullopt;
+                }
+            } catch (...) {
+                std::cerr << "Error: Invalid thread count\n";
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--pin") {
+            config.pin = true;
+        }
+        else if (arg == "--no-adaptive") {
+            config.adaptive = false;
+        }
+        else if (arg == "--max-memory") {
+            if (++i >= argc) {
+                std::cerr << "Error: " << arg << " requires a size (e.g. 512M, 4G)\n";
+                return std::nullopt;
+            }
+            if (!parse_size(argv[i], config.max_memory)) {
+                std::cerr << "Error: Invalid memory size\n";
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--io-threads") {
+            if (++i >= argc) {
+                std::cerr << "Error: " << arg << " requires a number\n";
+                return std::nullopt;
+            }
+            try {
+                config.io_threads = std::stoi(argv[i]);
+                if (config.io_threads < 0) {
+                    std::cerr << "Error: I/O thread count must not be negative\n";
+                    return std::nullopt;
+                }
+            } catch (...) {
+                std::cerr << "Error: Invalid I/O thread count\n";
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--no-io-uring") {
+            config.io_uring = false;
+        }
+        else if (arg == "--hardlink") {
+            config.hardlink = true;
+        }
+        else if (arg == "--direct-io") {
+            config.direct_io = true;
+        }
+        else if (arg == "--fsync") {
+            config.fsync = true;
+        }
+        else if (arg == "--syncfs") {
+            config.fsync = true;
+            config.syncfs = true;
+        }
+        else if (arg == "--files-from") {
+            if (++i >= argc) {
+                std::cerr << "Error: " << arg << " requires a file (- = stdin)\n";
+                return std::nullopt;
+            }
+            config.files_from = argv[i];
+        }
+        else if (arg == "-0" || arg == "--null") {
+            config.null_separated = true;
+        }
+        else if (arg == "--order") {
+            if (++i >= argc) {
+                std::cerr << "Error: " << arg << " requires stream, cost, inode or disk\n";
+                return std::nullopt;
+            }
+            std::string mode = argv[i];
+            if (mode == "stream") {
+                config.order = InputOrder::Stream;
+            } else if (mode == "cost") {
+                config.order = InputOrder::Cost;
+            } else if (mode == "inode") {
+                config.order = InputOrder::Inode;
+            } else if (mode == "disk") {
+                config.order = InputOrder::Disk;
+            } else {
+                std::cerr << "Error: Invalid order '" << mode << "' (stream, cost, inode or disk)\n";
+                return std::nullopt;
+            }
+        }
+        else if (arg == "--prefetch") {
+            if (++i >= argc) {
+                std::cerr << "Error: " << arg << " requires a size (e.g. 64M, 0 = off)\n";
+                return std::nullopt;
+            }
+            if (std::string(argv[i]) == "0") {
+                config.prefetch = 0;
+            } else if (!parse_size(argv[i], config.prefetch)) {
+                std::cerr << "Error: Invalid prefetch size\n";
+                return std::nullopt;
+            }
+        }
         else if (arg[0] != '-') {
             config.input_paths.emplace_back(arg);
         }
@@ -141,7 +380,7 @@ std::optional<CLIConfig> CLI::parse(int argc, char* argv[]) {
         }
     }
     
-    if (config.input_paths.empty()) {
+    if (config.input_paths.empty() && config.files_from.empty()) {
         std::cerr << "Error: No input files specified\n";
         std::cerr << "Use 'squish --help' for usage information.\n";
         return std::nullopt;
@@ -155,11 +394,11 @@ std::optional<CLIConfig> CLI::parse(int argc, char* argv[]) {
     return config;
 }
 
-std::vector<std::filesystem::path> CLI::collect_files(
-    const std::vector<std::filesystem::path>& paths
+void CLI::collect_files(
+    const std::vector<std::filesystem::path>& paths,
+    std::vector<std::filesystem::path>& roots,
+    DirWalker::Batch& direct
 ) {
-    std::vector<std::filesystem::path> files;
-    
     for (const auto& path : paths) {
         if (!std::filesystem::exists(path)) {
             std::cerr << "Warning: " << path << " does not exist, skipping\n";
@@ -167,50 +406,182 @@ std::vector<std::filesystem::path> CLI::collect_files(
         }
         
         if (std::filesystem::is_directory(path)) {
-            // rekursiv alle bilder sammeln
-            // SYMLINK FIX: Don't follow symlinks (prevents infinite loops)
-            // Also wrap in try-catch for permission errors mid-traversal
-            try {
-                constexpr size_t MAX_FILES = 500000;  // Sanity limit
-                for (const auto& entry : std::filesystem::recursive_directory_iterator(
-                    path, std::filesystem::directory_options::skip_permission_denied)) {
-                    if (entry.is_regular_file() && !entry.is_symlink() && ImageProcessor::is_supported(entry.path())) {
-                        files.push_back(entry.path());
-                        if (files.size() >= MAX_FILES) {
-                            std::cerr << "Warning: File limit (" << MAX_FILES << ") reached, stopping scan\n";
-                            break;
-                        }
-                    }
-                }
-            } catch (const std::filesystem::filesystem_error& e) {
-                std::cerr << "Warning: Error scanning " << path << ": " << e.what() << "\n";
-            }
+            // rekursiv alle bilder sammeln. der root darf ein symlink sein, darunter folgt der walker keinem
+            roots.push_back(path);
         } else if (std::filesystem::is_regular_file(path)) {
             if (ImageProcessor::is_supported(path)) {
-                files.push_back(path);
+                direct.push_back(path);
             } else {
                 std::cerr << "Warning: " << path << " is not a supported image format\n";
             }
         }
     }
-    
-    return files;
 }
 
-void CLI::print_summary(const std::vector<ProcessingResult>& results, double total_time) {
-    size_t total_original = 0;
-    size_t total_compressed = 0;
-    size_t success_count = 0;
+// optionen einer listenzeile: "-q 70 -w 1920 -h 1080", wie auf der kommandozeile
+static bool parse_line_options(const std::string& text, FileOverrides& overrides) {
+    std::istringstream in(text);
+    std::string flag, value;
+    while (in >> flag) {
+        if (!(in >> value)) return false;
+        int n;
+        try {
+            size_t pos = 0;
+            n = std::stoi(value, &pos);
+            if (pos != value.size()) return false;
+        } catch (...) {
+            return false;
+        }
+        if ((flag == "-q" || flag == "--quality") && n >= 1 && n <= 100) {
+            overrides.quality = n;
+        } else if ((flag == "-w" || flag == "--width") && n >= 0) {
+            overrides.max_width = n;
+        } else if ((flag == "-h" || flag == "--height") && n >= 0) {
+            overrides.max_height = n;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// relativer output mit ".." drin käme aus -o raus (dank create_directories sogar
+// in verzeichnisse die es noch nicht gab)
+static bool leaves_output_dir(const std::filesystem::path& output) {
+    if (output.is_absolute()) return false;
+    for (const auto& part : output) {
+        if (part == "..") return true;
+    }
+    return false;
+}
+
+// eigener output name muss zu dem passen was rauskommt: png bleibt png, alles andere
+// wird jpeg (bzw. bleibt es beim kopieren). sonst stehen jpeg bytes in einer .png
+static std::string lower_extension(const std::filesystem::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+static bool matches_output_format(bool png, const std::filesystem::path& output) {
+    std::string ext = lower_extension(output);
+    return png ? ext == ".png" : ext == ".jpg" || ext == ".jpeg";
+}
+
+bool CLI::read_file_list(const CLIConfig& config, const ListSink& found) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (config.files_from != "-") {
+        file.open(config.files_from, std::ios::binary);
+        if (!file) return false;
+        in = &file;
+    }
+#ifndef _WIN32
+    else {
+        // eigener filebuf auf fd 0: der weiß (FIONREAD) ob die nächste zeile schon da ist,
+        // std::cin über stdio nicht. geht nicht (socket) -> cin, dann nur volle schübe
+        file.open("/dev/stdin", std::ios::binary);
+        if (file) in = &file;
+    }
+#endif
     
-    for (const auto& r : results) {
-        if (r.success) {
-            total_original += r.original_size;
-            total_compressed += r.compressed_size;
-            success_count++;
+    // kein exists/stat pro eintrag: der upstream weiß was es gibt, was fehlt
+    // scheitert beim lesen und steht dann als FAILED da
+    const char separator = config.null_separated ? '\0' : '\n';
+    DirWalker::Batch batch;
+    std::vector<FileOverrides> overrides;
+    std::filesystem::path last_parent;
+    std::string line;
+    size_t line_no = 0;
+    while (std::getline(*in, line, separator)) {
+        line_no++;
+        if (!config.null_separated && !line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        
+        // input [TAB output [TAB optionen]]
+        size_t tab1 = line.find('\t');
+        size_t tab2 = tab1 == std::string::npos ? tab1 : line.find('\t', tab1 + 1);
+        std::filesystem::path input = line.substr(0, tab1);
+        FileOverrides extra;
+        if (tab1 != std::string::npos) {
+            std::string output = line.substr(tab1 + 1, tab2 == std::string::npos ? std::string::npos : tab2 - tab1 - 1);
+            // relativ = unter -o, absolut bleibt wie es ist (wer die liste schreibt, darf das)
+            if (leaves_output_dir(output)) {
+                std::cerr << "Warning: " << config.files_from << " line " << line_no
+                          << ": output " << output << " leaves the output directory, skipping " << input << "\n";
+                continue;
+            }
+            bool png = lower_extension(input) == ".png";
+            if (!output.empty() && !matches_output_format(png, output)) {
+                std::cerr << "Warning: " << config.files_from << " line " << line_no
+                          << ": output " << output << " needs " << (png ? ".png" : ".jpg or .jpeg")
+                          << " for " << input << ", skipping\n";
+                continue;
+            }
+            if (!output.empty()) extra.output = config.output_dir / output;
+            if (tab2 != std::string::npos && !parse_line_options(line.substr(tab2 + 1), extra)) {
+                std::cerr << "Warning: " << config.files_from << " line " << line_no
+                          << ": invalid options, skipping " << input << "\n";
+                continue;
+            }
+        }
+        if (!ImageProcessor::is_supported(input)) {
+            std::cerr << "Warning: " << input << " is not a supported image format\n";
+            continue;
+        }
+        // eigene output pfade können überall hin zeigen, verzeichnis muss es geben
+        // (meistens gleich wie die zeile davor)
+        if (!extra.output.empty() && extra.output.parent_path() != last_parent) {
+            last_parent = extra.output.parent_path();
+            std::error_code ec;
+            if (!last_parent.empty()) std::filesystem::create_directories(last_parent, ec);
+        }
+        
+        batch.push_back(std::move(input));
+        overrides.push_back(std::move(extra));
+        // die liste kommt tröpfchenweise (stdin von einem watcher o.ä.): was da ist gleich
+        // losschicken statt mit der verarbeitung auf 256 zeilen oder EOF zu warten
+        bool dry = in == &file && in->rdbuf()->in_avail() <= 0;
+        if (batch.size() >= FILE_LIST_BATCH || dry) {
+            found(std::move(batch), std::move(overrides));
+            batch = DirWalker::Batch();
+            overrides = std::vector<FileOverrides>();
         }
     }
+    if (!batch.empty()) found(std::move(batch), std::move(overrides));
+    return true;
+}
+
+void RunTotals::add(const ProcessingResult& r) {
+    images++;
+    if (r.success) {
+        succeeded++;
+        original_bytes += r.original_size;
+        compressed_bytes += r.compressed_size;
+        if (r.predicted_ms > 0) {
+            double x = r.predicted_ms, y = r.processing_time_ms;
+            model_n++; model_x += x; model_y += y; model_xx += x * x; model_yy += y * y; model_xy += x * y;
+        }
+    } else {
+        failed++;
+    }
+    kept[static_cast<size_t>(r.kept)]++;
+    job_ms += r.processing_time_ms;
+    read_ms += r.read_ms;
+    decode_ms += r.decode_ms;
+    transform_ms += r.transform_ms;
+    encode_ms += r.encode_ms;
+    write_ms += r.write_ms;
+    compute_ms += r.compute_ms();
+    cpu_ms += r.cpu_ms;
+    runqueue_ms += r.runqueue_ms;
+}
+
+void CLI::print_summary(const RunTotals& totals, double total_time) {
+    uint64_t total_original = totals.original_bytes;
+    uint64_t total_compressed = totals.compressed_bytes;
     
-    auto format_size = [](size_t bytes) -> std::string {
+    auto format_size = [](uint64_t bytes) -> std::string {
         if (bytes >= 1024 * 1024)
             return std::to_string(bytes / (1024 * 1024)) + " MB";
         if (bytes >= 1024)
@@ -219,7 +590,7 @@ void CLI::print_summary(const std::vector<ProcessingResult>& results, double tot
     };
     
     std::cout << "\n";
-    std::cout << "Done! " << success_count << " images optimized\n";
+    std::cout << "Done! " << totals.succeeded << " images optimized\n";
     std::cout << "  " << format_size(total_original) << " -> " << format_size(total_compressed);
     
     if (total_original > 0) {
@@ -233,19 +604,35 @@ void CLI::print_summary(const std::vector<ProcessingResult>& results, double tot
     std::cout << "\n";
 }
 
-int CLI::run(const CLIConfig& config) {
-    // files sammeln
-    auto files = collect_files(config.input_paths);
-    
-    if (files.empty()) {
-        std::cerr << "No supported images found.\n";
-        std::cerr << "Supported formats: .jpg .jpeg .png .bmp .tga .gif\n";
-        return 1;
+// wie gut passt das kostenmodell? korrelation geschätzt vs gemessen, für die reihenfolge
+// zählt nur dass große jobs als groß erkannt werden, absolute werte sind egal
+void CLI::print_cost_model(const RunTotals& totals) {
+    double n = totals.model_n, sx = totals.model_x, sy = totals.model_y;
+    double sxx = totals.model_xx, syy = totals.model_yy, sxy = totals.model_xy;
+    if (n < 2) return;
+    double cov = sxy - sx * sy / n;
+    double vx = sxx - sx * sx / n;
+    double vy = syy - sy * sy / n;
+    double r = (vx > 0 && vy > 0) ? cov / std::sqrt(vx * vy) : 0.0;
+    std::cout << "  cost model: r=" << std::fixed << std::setprecision(2) << r
+              << ", predicted " << std::setprecision(0) << sx << " ms vs actual " << sy << " ms\n";
+}
+
+// eine zeile --cost-log, geschrieben sobald das file fertig ist (reihenfolge = fertig)
+void CLI::write_cost_row(std::ostream& out, const ProcessingResult& r, const JobEstimate& e) {
+    std::string name = r.input_path.string();
+    out << '"';
+    for (char c : name) {
+        if (c == '"') out << '"';  // csv: quotes verdoppeln
+        out << c;
     }
-    
-    // output dir erstellen wenns nich existiert
-    std::filesystem::create_directories(config.output_dir);
-    
+    out << '"' << ','
+        << e.header.width << ',' << e.header.height << ',' << e.file_size << ','
+        << std::fixed << std::setprecision(3) << r.predicted_ms << ','
+        << r.processing_time_ms << ',' << (r.success ? 1 : 0) << '\n';
+}
+
+int CLI::run(const CLIConfig& config) {
     // optionen zusammenbauen
     ProcessingOptions options;
     options.quality = config.quality;
@@ -253,96 +640,575 @@ int CLI::run(const CLIConfig& config) {
     options.max_width = config.max_width;
     options.max_height = config.max_height;
     options.use_gpu = config.use_gpu;
+    options.hardlink_unchanged = config.hardlink;
+    options.direct_io = config.direct_io;
+    options.order = config.order;
+    
+    bufpool::set_huge_pages(config.huge_pages);
+#ifdef __GLIBC__
+    // glibc hebt die mmap schwelle nach jedem free eines gemappten blocks an (bis 32 MB).
+    // danach kommen frames und output buffer aus den per-thread arenen und gehen nach dem
+    // free nicht mehr ans system zurück - RSS weit über dem budget. feste schwelle = aus
+    mallopt(M_MMAP_THRESHOLD, MALLOC_MMAP_THRESHOLD);
+#endif
+    
+    // threads rausfinden: cpus die wir wirklich kriegen (affinity, cpuset, cgroup quota),
+    // nicht was der host hat - sonst throttled CFS im pod jeden zweiten slice weg.
+    // ein worker pro physischem kern: SMT geschwister teilen sich die SIMD einheiten,
+    // bei den dct/resize kernels bringt der zweite thread kaum was. E-cores zählen mit,
+    // work stealing gleicht aus dass die langsamer sind
+    cgroup::CpuLimits cpu = cgroup::cpu_limits();
+    cputopo::Topology topo = cputopo::detect();
+    size_t num_threads;
+    if (config.threads > 0) {
+        num_threads = static_cast<size_t>(config.threads);
+    } else if (topo.known()) {
+        num_threads = std::min<size_t>(topo.cores, cpu.effective);
+    } else if (cpu.quota_bound) {
+        num_threads = cpu.effective;
+    } else {
+        // keine topologie (kein sysfs): Use physical cores (~75% of logical) to avoid hyper-threading penalties
+        num_threads = std::max<size_t>(2, (cpu.effective * 3) / 4);  // 75% of logical cores
+    }
+    num_threads = std::max<size_t>(num_threads, 1);
+    
+    // --pin: worker i auf die i-te cpu der pin reihenfolge (ein thread pro kern zuerst)
+    std::vector<int> pin_cpus;
+    if (config.pin) {
+        pin_cpus = topo.pin_order();
+        if (pin_cpus.empty()) {
+            std::cerr << "Warning: CPU topology unknown, --pin ignored\n";
+        }
+    }
+    
+    // adaptiv: pool mit reserve nach oben (io-bound läufe wollen mehr threads als kerne),
+    // aktiv sind erstmal num_threads bzw. was beim letzten lauf über diese inputs am besten war.
+    // ob es mehr als ein file wird steht erst nach dem scan, der pool muss vorher stehen
+    bool adaptive = config.adaptive && config.threads == 0;
+    std::string input_key;
+    size_t pool_threads = num_threads;
+    if (adaptive) {
+        auto keyed = config.input_paths;
+        if (!config.files_from.empty()) keyed.push_back(config.files_from);
+        for (const auto& p : keyed) {
+            std::error_code ec;
+            auto canonical = std::filesystem::weakly_canonical(p, ec);
+            if (!input_key.empty()) input_key += '|';
+            input_key += (ec ? p : canonical).string();
+        }
+        pool_threads = std::max<size_t>(num_threads * 2, topo.logical());
+        if (auto remembered = ConcurrencyController::load(input_key)) {
+            num_threads = *remembered;
+            pool_threads = std::max(pool_threads, num_threads);
+        }
+        pool_threads = std::min(pool_threads, MAX_ADAPTIVE_WORKERS);
+        num_threads = std::min(num_threads, pool_threads);
+    }
+    
+    // thread pool für parallel processing
+    ThreadPool pool(pool_threads, pin_cpus);
+    pool.set_active(num_threads);
+    
+    auto start_time = std::chrono::high_resolution_clock::now();
+    FaultCounters faults_before = read_fault_counters();
     
-    // threads rausfinden, 4 als fallback
-    // Use physical cores (~75% of logical) to avoid hyper-threading penalties and thermal throttling
-    size_t num_threads = std::thread::hardware_concurrency();
-    if (num_threads == 0) num_threads = 4;
-    num_threads = std::max(size_t(2), (num_threads * 3) / 4);  // 75% of logical cores
+    // inputs einteilen (warnungen kommen gleich), gescannt wird nebenher. wieviele files
+    // es werden steht erst am ende vom scan - ob pipeline und controller sich lohnen,
+    // muss aber vorher feststehen: ein verzeichnis oder eine liste zählt als viele
+    std::vector<std::filesystem::path> roots;
+    DirWalker::Batch direct;
+    collect_files(config.input_paths, roots, direct);
+    const bool many = !roots.empty() || !config.files_from.empty() || direct.size() > 1;
+    if (!many && direct.empty()) {
+        std::cerr << "No supported images found.\n";
+        std::cerr << "Supported formats: .jpg .jpeg .png .bmp .tga .gif\n";
+        return 1;
+    }
+    adaptive = adaptive && many;
     
-    std::cout << "Optimizing " << files.size() << " image(s) with " << num_threads << " threads";
+    // output dir erstellen wenns nich existiert (findet der scan nix, kommt es wieder weg)
+    const bool created_output = std::filesystem::create_directories(config.output_dir);
+    
+    std::cout << "Optimizing ";
+    if (many) {
+        std::cout << "images";
+    } else {
+        std::cout << direct.size() << " image(s)";
+    }
+    std::cout << " with " << num_threads << " threads";
+    if (adaptive) {
+        std::cout << " (adaptive, up to " << pool_threads << ")";
+    }
     if (config.use_gpu && fastjpeg::gpu_available()) {
         std::cout << " + GPU";
     }
     std::cout << "...\n";
     
-    // thread pool für parallel processing
-    ThreadPool pool(num_threads);
+    // im container sehen was wirklich limitiert
+    if (config.verbose) {
+        if (topo.known()) {
+            std::cout << "  cpu topology: " << topo.cores << " cores / " << topo.logical() << " threads";
+            if (topo.efficiency_cores) {
+                std::cout << " (" << (topo.cores - topo.efficiency_cores) << "P + "
+                          << topo.efficiency_cores << "E)";
+            }
+            std::cout << ", " << topo.cache_domains << " LLC domain" << (topo.cache_domains == 1 ? "" : "s")
+                      << ", SMT " << (topo.smt() ? "on" : "off") << "\n";
+        }
+        cgroup::MemoryLimits mem = cgroup::memory_limits();
+        if (cpu.limited() || mem.limited()) {
+            std::cout << "  container limits: " << cpu.effective << " of " << cpu.host << " cpus";
+            if (cpu.quota > 0.0) {
+                std::ostringstream q;
+                q << std::fixed << std::setprecision(2) << cpu.quota;
+                std::cout << " (quota " << q.str() << ")";
+            }
+            if (cpu.cpuset) std::cout << ", cpuset " << cpu.cpuset;
+            if (mem.limited()) {
+                std::cout << ", memory " << (mem.max / (1024 * 1024)) << " MB ("
+                          << (mem.available() / (1024 * 1024)) << " MB free)";
+            }
+            std::cout << "\n";
+        }
+    }
     
-    // results speichern
-    std::vector<ProcessingResult> results(files.size());
+    // speicherbudget für alle jobs zusammen: --max-memory oder 3/4 von dem was beim
+    // start frei ist (im container vom cgroup limit). rest bleibt für page cache + co
+    uint64_t budget_bytes = config.max_memory;
+    if (budget_bytes == 0) {
+        uint64_t available = MemoryBudget::system_available();
+        budget_bytes = available == MemoryBudget::UNLIMITED ? available : available / 4 * 3;
+    }
+    // die thread caches vom buffer pool halten freigegebene blöcke außerhalb jeder
+    // reservierung. ein achtel vom budget geht dafür weg, verteilt auf alle threads
+    // die blöcke freigeben (worker, io threads, main), der rest ist für die jobs
+    if (budget_bytes != MemoryBudget::UNLIMITED) {
+        uint64_t cache_bytes = budget_bytes / BUFFER_CACHE_SHARE;
+        size_t caching_threads = pool_threads + static_cast<size_t>(config.io_threads) + 1;
+        bufpool::set_thread_cache_limit(static_cast<size_t>(cache_bytes / caching_threads));
+        budget_bytes -= cache_bytes;
+    }
+    MemoryBudget budget(budget_bytes);
+    options.memory_budget = &budget;
+    
+    // results nicht speichern sondern gleich aufsummieren, fehler gleich melden
+    RunTotals totals;
     std::atomic<size_t> completed{0};
     std::mutex output_mutex;
     
-    auto start_time = std::chrono::high_resolution_clock::now();
+    // --cost-log: zeile pro file sobald es fertig ist
+    std::ofstream cost_log;
+    if (!config.cost_log.empty()) {
+        cost_log.open(config.cost_log);
+        if (cost_log) cost_log << "file,width,height,bytes,predicted_ms,actual_ms,success\n";
+    }
     
-    // alle tasks reinhauen
-    std::vector<std::future<void>> futures;
-    futures.reserve(files.size());
+    // pipeline: io threads lesen (in queue reihenfolge) und schreiben, die worker rechnen nur.
+    // ohne (--io-threads 0 oder nur ein file) macht jeder worker alles selber
+    const bool pipelined = config.io_threads > 0 && many;
     
-    for (size_t i = 0; i < files.size(); ++i) {
-        futures.push_back(pool.enqueue([&, i]() {
-            ImageProcessor processor;
-            results[i] = processor.process(files[i], config.output_dir, options);
-            
-            size_t done = ++completed;
+    // summen über fertige jobs für den controller (in µs, atomics gibts nur für ganzzahlen gescheit)
+    std::atomic<uint64_t> done_work_us{0}, done_job_us{0}, done_cpu_us{0}, done_runqueue_us{0};
+    
+    // files zählt mit solange der scan läuft, der fortschritt zeigt den stand bis dahin
+    PathList files;
+    auto finish_one = [&](size_t i, const JobEstimate& estimate, ProcessingResult&& result) {
+        result.predicted_ms = estimate.cost_ms;
+        
+        // der controller regelt nur die worker: in der pipeline zählt deren zeit, lesen
+        // und schreiben laufen woanders
+        double job_ms = pipelined ? result.compute_ms() : result.processing_time_ms;
+        done_work_us.fetch_add(static_cast<uint64_t>(estimate.cost_ms * 1000.0), std::memory_order_relaxed);
+        done_job_us.fetch_add(static_cast<uint64_t>(job_ms * 1000.0), std::memory_order_relaxed);
+        done_cpu_us.fetch_add(static_cast<uint64_t>(result.cpu_ms * 1000.0), std::memory_order_relaxed);
+        done_runqueue_us.fetch_add(static_cast<uint64_t>(result.runqueue_ms * 1000.0), std::memory_order_relaxed);
+        
+        std::lock_guard<std::mutex> lock(output_mutex);
+        totals.add(result);
+        if (cost_log.is_open()) write_cost_row(cost_log, result, estimate);
+        size_t done = ++completed;
+        size_t total = files.size();
+        
+        if (config.verbose) {
+            // Detailed output with list
+            std::cout << "[" << done << "/" << total << "] " 
+                      << files.filename(i).string();
             
-            if (config.verbose) {
-                // Detailed output with list
-                std::lock_guard<std::mutex> lock(output_mutex);
-                const auto& result = results[i];
-                std::cout << "[" << done << "/" << files.size() << "] " 
-                          << files[i].filename().string();
-                
-                if (result.success) {
-                    double ratio = result.compression_ratio() * 100;
-                    if (ratio > 0.5) {
-                        std::cout << " -> " << std::fixed << std::setprecision(0) << ratio << "% saved\n";
-                    } else {
-                        std::cout << " -> kept (already optimal)\n";
-                    }
+            if (result.success) {
+                double ratio = result.compression_ratio() * 100;
+                if (ratio > 0.5) {
+                    std::cout << " -> " << std::fixed << std::setprecision(0) << ratio << "% saved\n";
                 } else {
-                    std::cout << " FAILED: " << result.error_message << "\n";
+                    std::cout << " -> kept (already optimal)\n";
                 }
             } else {
-                // minimal progress: nur alle 10 files oder am ende updaten
-                if (done % 10 == 0 || done == files.size()) {
-                    std::lock_guard<std::mutex> lock(output_mutex);
-                    std::cout << "\r" << done << "/" << files.size() << " processed..." << std::flush;
+                std::cout << " FAILED: " << result.error_message << "\n";
+            }
+        } else {
+            // fehler gleich, auf eigener zeile unter dem fortschritt
+            if (!result.success) {
+                std::cout << std::flush;
+                std::cerr << "\nFAILED: " << result.input_path.filename().string() << " - " << result.error_message << "\n";
+            }
+            // minimal progress: nur alle 10 files oder am ende updaten
+            if (done % 10 == 0 || done == total) {
+                std::cout << "\r" << done << "/" << total << " processed..." << std::flush;
+            }
+        }
+    };
+    
+    // --order stream (default): geprobte files gehen gleich in die queue, largest-first
+    // unter dem was schon da ist. cost/inode/disk brauchen alle schätzungen und sortieren
+    // erst nach dem scan, die queue gibt sie dann so raus wie sie reinkamen
+    const bool streaming = config.order == InputOrder::Stream;
+    InputQueue queue(streaming);
+    
+    // read-ahead: die nächsten files aus der queue schon in den page cache holen.
+    // zählt im container gegen memory.max (reclaimable, trotzdem) - höchstens 1/4 vom budget
+    std::optional<Prefetcher> prefetcher;
+    if (config.prefetch > 0 && many) {
+        prefetcher.emplace(files, queue, std::min(config.prefetch, std::max<uint64_t>(budget_bytes / 4, 1)));
+        prefetcher->start();
+        options.prefetcher = &*prefetcher;
+    }
+    
+    // --fsync: ein commit thread, writer/worker geben outputs ab und warten gruppenweise.
+    // muss nach der pipeline weg (deren writer warten evtl. noch), deshalb vor ihr
+    std::optional<GroupCommit> group_commit;
+    if (config.fsync) {
+        group_commit.emplace(config.syncfs ? GroupCommit::Mode::Syncfs : GroupCommit::Mode::File);
+        options.group_commit = &*group_commit;
+    }
+    
+    // pipeline: reader holen sich die files aus der queue sobald der scan sie liefert.
+    // ohne: pro schub in der queue gehen genauso viele plätze als bulk job an den pool,
+    // jeder nimmt sich das nächste file - ein latch für alles statt future pro file
+    std::optional<Pipeline> pipeline;
+    Latch batch;
+    if (pipelined) {
+        // io threads halbe/halbe auf lesen und schreiben, queues für alle möglichen worker.
+        // nach lage sortiert liest nur einer, zwei reader wären wieder zwei seek ströme
+        size_t io = static_cast<size_t>(config.io_threads);
+        bool by_location = config.order == InputOrder::Inode || config.order == InputOrder::Disk;
+        size_t readers = by_location ? 1 : (io + 1) / 2;
+        pipeline.emplace(pool, readers, io / 2, pool_threads * PIPELINE_DEPTH_PER_WORKER, config.io_uring);
+        pipeline->start(files, queue, config.output_dir, options, finish_one);
+    }
+    auto process_next = [&](size_t lo, size_t hi) {
+        ImageProcessor processor;
+        for (size_t n = lo; n < hi; ++n) {
+            InputQueue::Item item;
+            size_t k;
+            if (!queue.try_pop(item, k)) return;  // pro file in der queue gibts genau einen platz
+            if (options.prefetcher) options.prefetcher->claim(k);
+            finish_one(item.index, *item.estimate, processor.process(files.path(item.index), config.output_dir,
+                                                                     options, files.overrides(item.index)));
+        }
+    };
+    auto dispatch = [&](const std::vector<InputQueue::Item>& items) {
+        queue.push(items);
+        if (!pipelined) pool.enqueue_bulk(0, items.size(), 1, process_next, batch);
+    };
+    
+    // files sammeln und dabei schon die kosten schätzen (nur header lesen): jeder schub
+    // vom walker geht sofort als bulk job an den pool, auf langsamen dateisystemen
+    // überlappen scan und probe statt nacheinander zu warten. ist ein schub geprobt, geht
+    // er gleich in die queue und wird verarbeitet während der scan weiterläuft.
+    // die pfade landen gleich kompakt in files, die volle kopie vom schub lebt nur
+    // bis er geprobt ist. schübe liegen stabil im deque, die queue zeigt auf ihre schätzungen
+    struct Found {
+        size_t first = 0;  // index in files vom ersten file
+        DirWalker::Batch files;
+        std::vector<FileOverrides> overrides;  // --files-from, sonst leer
+        std::vector<JobEstimate> estimates;
+        std::atomic<size_t> left{0};  // noch nicht geprobt, der letzte gibt files frei
+    };
+    auto items_of = [](Found& chunk) {
+        std::vector<InputQueue::Item> items(chunk.estimates.size());
+        for (size_t i = 0; i < items.size(); ++i) items[i] = {chunk.first + i, &chunk.estimates[i]};
+        return items;
+    };
+    std::deque<Found> found;
+    std::mutex found_mutex;
+    Latch probed;
+    auto probe_list = [&](DirWalker::Batch&& batch, std::vector<FileOverrides>&& overrides) {
+        Found* chunk;
+        {
+            std::lock_guard<std::mutex> lock(found_mutex);
+            chunk = &found.emplace_back();
+            chunk->first = files.size();
+            for (size_t k = 0; k < batch.size(); ++k) {
+                size_t i = files.add(batch[k]);
+                if (k < overrides.size() && !overrides[k].empty()) files.set_overrides(i, overrides[k]);
+            }
+        }
+        size_t n = batch.size();
+        chunk->files = std::move(batch);
+        chunk->overrides = std::move(overrides);
+        chunk->estimates.resize(n);
+        chunk->left.store(n, std::memory_order_relaxed);
+        pool.enqueue_bulk(0, n, PROBE_GRAIN, [chunk, streaming, &options, &dispatch, &items_of](size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; ++i) {
+                chunk->estimates[i] = i < chunk->overrides.size() && !chunk->overrides[i].empty()
+                    ? ImageProcessor::estimate(chunk->files[i], ImageProcessor::with_overrides(options, chunk->overrides[i]))
+                    : ImageProcessor::estimate(chunk->files[i], options);
+            }
+            if (chunk->left.fetch_sub(hi - lo, std::memory_order_acq_rel) == hi - lo) {
+                DirWalker::Batch().swap(chunk->files);
+                std::vector<FileOverrides>().swap(chunk->overrides);
+                if (streaming) dispatch(items_of(*chunk));
+            }
+        }, probed);
+    };
+    auto probe = [&](DirWalker::Batch&& batch) { probe_list(std::move(batch), {}); };
+    
+    // scan auf eigenem thread, main regelt derweil die worker. danach ist die queue zu
+    DirWalker walker(WALK_THREADS, probe);
+    Latch scanned(1);
+    std::exception_ptr scan_error;
+    double scan_ms = 0;
+    size_t located = 0;
+    std::thread scanner([&] {
+        try {
+            if (!direct.empty()) probe(std::move(direct));
+            if (!roots.empty()) walker.walk(roots);
+            if (!config.files_from.empty() && !read_file_list(config, probe_list)) {
+                std::cerr << "Error: cannot read file list " << config.files_from << "\n";
+            }
+            pool.wait(probed);
+            scan_ms = std::chrono::duration<double, std::milli>(
+                std::chrono::high_resolution_clock::now() - start_time).count();
+            
+            if (!streaming) {
+                // global largest-first (LPT) über alle schätzungen. sonst kann das 100 MP
+                // panorama als letztes kommen und ein kern rechnet allein weiter
+                std::vector<InputQueue::Item> items;
+                items.reserve(files.size());
+                for (auto& chunk : found) {
+                    auto more = items_of(chunk);
+                    items.insert(items.end(), more.begin(), more.end());
+                }
+                std::stable_sort(items.begin(), items.end(), [](const auto& a, const auto& b) {
+                    return a.estimate->cost_ms > b.estimate->cost_ms;
+                });
+                
+                // --order inode/disk: nach lage auf der platte. auf einer hdd kostet jeder sprung
+                // einen seek (~10 ms) - bei kalten archiven mehr als das rechnen. reader, prefetcher
+                // und io_uring schübe gehen alle in dieser reihenfolge. gleiche keys bleiben LPT.
+                // das budget gilt wie sonst, reserviert wird erst beim dekodieren
+                if (config.order != InputOrder::Cost) {
+                    const bool disk = config.order == InputOrder::Disk;
+                    auto key = [disk](const InputQueue::Item& item) {
+                        const mmapfile::Location& l = item.estimate->location;
+                        // disk: files ohne extent (tmpfs, nfs, leer) hinter die anderen, nach inode
+                        if (disk) {
+                            return l.physical ? std::make_pair(0, l.physical) : std::make_pair(1, l.inode);
+                        }
+                        return std::make_pair(0, l.inode);
+                    };
+                    for (const auto& item : items) {
+                        const mmapfile::Location& l = item.estimate->location;
+                        if (disk ? l.physical != 0 : l.inode != 0) located++;
+                    }
+                    std::stable_sort(items.begin(), items.end(), [&](const auto& a, const auto& b) {
+                        return key(a) < key(b);
+                    });
                 }
+                dispatch(items);
             }
-        }));
+        } catch (...) {
+            scan_error = std::current_exception();
+            // probe tasks zeigen noch auf die schübe
+            try {
+                pool.wait(probed);
+            } catch (...) {}
+        }
+        queue.close();
+        scanned.count_down();
+    });
+    struct JoinScanner {
+        std::thread& thread;
+        ~JoinScanner() {
+            if (thread.joinable()) thread.join();
+        }
+    } join_scanner{scanner};
+    
+    // solange der scan läuft ist batch/written zwischendurch auch mal leer
+    auto batch_done = [&](std::chrono::milliseconds timeout) {
+        if (!scanned.wait_for(timeout)) return false;
+        return pipeline ? pipeline->wait_for(timeout) : batch.wait_for(timeout);
+    };
+    
+    // controller: fenster messen (genug fertige jobs für ein stabiles signal), dann
+    // einen worker mehr oder weniger aktiv schalten
+    ConcurrencyController controller(num_threads, pool_threads);
+    if (adaptive) {
+        auto window_start = std::chrono::high_resolution_clock::now();
+        size_t window_images = completed.load();
+        uint64_t window_work = 0, window_job = 0, window_cpu = 0, window_runqueue = 0;
+        while (!batch_done(CONTROLLER_POLL)) {
+            auto now = std::chrono::high_resolution_clock::now();
+            double window_ms = std::chrono::duration<double, std::milli>(now - window_start).count();
+            size_t images = completed.load() - window_images;
+            bool enough = images >= std::max<size_t>(2, pool.active()) || window_ms >= CONTROLLER_MAX_WINDOW_MS;
+            if (window_ms < CONTROLLER_MIN_WINDOW_MS || images == 0 || !enough) continue;
+            
+            uint64_t work = done_work_us.load(), job = done_job_us.load(), cpu = done_cpu_us.load();
+            uint64_t runqueue = done_runqueue_us.load();
+            ConcurrencyController::Sample sample;
+            sample.window_ms = window_ms;
+            sample.work_ms = (work - window_work) / 1000.0;
+            sample.job_ms = (job - window_job) / 1000.0;
+            sample.cpu_ms = (cpu - window_cpu) / 1000.0;
+            sample.runqueue_ms = (runqueue - window_runqueue) / 1000.0;
+            sample.images = images;
+            pool.set_active(controller.update(sample));
+            
+            window_start = now;
+            window_images += images;
+            window_work = work;
+            window_job = job;
+            window_cpu = cpu;
+            window_runqueue = runqueue;
+        }
     }
+    scanner.join();
+    if (pipeline) {
+        pipeline->wait();
+    } else {
+        pool.wait(batch);
+    }
+    if (prefetcher) prefetcher->stop();
+    if (scan_error) std::rethrow_exception(scan_error);
     
-    // warten bis alles fertig
-    for (auto& f : futures) {
-        f.get();
+    if (files.empty()) {
+        std::cerr << "No supported images found.\n";
+        std::cerr << "Supported formats: .jpg .jpeg .png .bmp .tga .gif\n";
+        if (created_output) {
+            std::error_code ec;
+            std::filesystem::remove(config.output_dir, ec);
+        }
+        return 1;
+    }
+    if (adaptive && controller.windows() >= CONTROLLER_MIN_WINDOWS_TO_SAVE) {
+        ConcurrencyController::save(input_key, controller.best());
     }
     
     auto end_time = std::chrono::high_resolution_clock::now();
     double total_time = std::chrono::duration<double, std::milli>(end_time - start_time).count();
     
-    // errors am ende zeigen wenn nich verbose
     if (!config.verbose) {
         std::cout << "\n";
-        size_t fail_count = 0;
-        for (const auto& r : results) {
-            if (!r.success) {
-                fail_count++;
-                std::cerr << "FAILED: " << r.input_path.filename().string() << " - " << r.error_message << "\n";
+    }
+    
+    print_summary(totals, total_time);
+    
+    // pool reuse für die profiler leute
+    if (config.verbose) {
+        std::cout << "  scan: " << walker.dirs() << " dirs, " << files.size() << " images in "
+                  << std::fixed << std::setprecision(0) << scan_ms << " ms (" << walker.threads()
+                  << " walker threads, header probe " << (streaming ? "and processing " : "")
+                  << "overlapped), paths " << std::setprecision(1) << files.bytes() / (1024.0 * 1024.0) << " MB\n";
+        // skip/größer geworden: wie die originale rübergekommen sind
+        const size_t* kept = totals.kept;
+        if (totals.images > kept[0]) {
+            std::cout << "  unchanged originals:";
+            const char* sep = " ";
+            for (size_t m = 1; m < 5; ++m) {
+                if (!kept[m]) continue;
+                std::cout << sep << kept[m] << " " << atomicfile::copy_method_name(static_cast<atomicfile::CopyMethod>(m));
+                sep = ", ";
             }
+            std::cout << "\n";
         }
+        auto ps = bufpool::stats();
+        std::cout << "  buffer pool: " << std::fixed << std::setprecision(1) << ps.hit_rate() * 100.0
+                  << "% reuse (" << ps.hits << " hits / " << ps.misses << " misses, "
+                  << (ps.bytes_reused / (1024 * 1024)) << " MB recycled, " << ps.foreign_frees
+                  << " freed by another thread)\n";
+        
+        FaultCounters faults_after = read_fault_counters();
+        long minor = faults_after.minor - faults_before.minor;
+        long major = faults_after.major - faults_before.major;
+        std::cout << "  page faults: " << minor << " minor / " << major << " major ("
+                  << std::setprecision(0) << static_cast<double>(minor) / totals.images << " per image)\n";
+        std::cout << "  huge pages: " << (ps.huge_bytes / (1024 * 1024)) << " MB ("
+                  << ps.hugetlb_allocs << " hugetlb / " << ps.thp_allocs << " thp blocks)\n";
+        double job_total = totals.job_ms, read_total = totals.read_ms, decode_total = totals.decode_ms;
+        double transform_total = totals.transform_ms, encode_total = totals.encode_ms;
+        double write_total = totals.write_ms, compute_total = totals.compute_ms;
+        double cpu_total = totals.cpu_ms, runqueue_total = totals.runqueue_ms;
+        if (job_total > 0) {
+            auto pct = [](double v, double total) { return static_cast<int>(std::lround(100.0 * v / total)); };
+            std::cout << "  stages: read " << pct(read_total, job_total) << "%, decode "
+                      << pct(decode_total, job_total) << "%, transform " << pct(transform_total, job_total)
+                      << "%, encode " << pct(encode_total, job_total) << "%, write "
+                      << pct(write_total, job_total) << "%";
+            if (compute_total > 0) {
+                std::cout << "; compute blocked "
+                          << pct(std::max(0.0, compute_total - cpu_total - runqueue_total), compute_total)
+                          << "%, runqueue " << pct(runqueue_total, compute_total) << "%";
+            }
+            std::cout << "\n";
+        }
+        if (pipeline) {
+            std::cout << "  pipeline: " << pipeline->readers() << " readers + " << pipeline->writers()
+                      << " writers, queue depth " << pipeline->depth() << "; workers waited for input "
+                      << pipeline->compute_starved() << "x, readers for workers " << pipeline->read_blocked()
+                      << "x, workers for writers " << pipeline->write_blocked() << "x\n";
+            if (pipeline->rings() > 0) {
+                std::cout << "  io_uring: " << pipeline->rings() << " rings, " << pipeline->uring_files()
+                          << " files read in batches, " << pipeline->uring_submits() << " submits\n";
+            } else {
+                std::cout << "  io_uring: off\n";
+            }
+        }
+        if (adaptive) {
+            std::cout << "  concurrency: " << controller.windows() << " windows, " << controller.changes()
+                      << " changes, ended at " << pool.active() << ", best " << controller.best()
+                      << " (io wait " << static_cast<int>(std::lround(controller.io_wait() * 100)) << "%)\n";
+        }
+        std::cout << "  thread pool: " << pool.size() << " workers";
+        if (config.pin) std::cout << " (" << pool.pinned() << " pinned)";
+        std::cout << ", " << pool.steals() << " steals, " << std::setprecision(1)
+                  << (total_time > 0 ? totals.images * 1000.0 / total_time : 0.0) << " images/s\n";
+        if (config.order == InputOrder::Inode || config.order == InputOrder::Disk) {
+            std::cout << "  order: " << (config.order == InputOrder::Disk ? "disk extents" : "inode") << ", "
+                      << located << " of " << files.size() << " files located\n";
+        }
+        if (prefetcher) {
+            // issued ahead = fadvise war vor dem lesen durch, ob die seiten schon da waren weiß keiner
+            uint64_t ahead = prefetcher->issued_ahead();
+            uint64_t claimed = ahead + prefetcher->not_ahead();
+            std::cout << "  prefetch: " << ahead << " of " << claimed << " files issued ahead ("
+                      << std::setprecision(1) << (claimed ? ahead * 100.0 / claimed : 0.0) << "%), "
+                      << (prefetcher->bytes() / (1024 * 1024)) << " MB read ahead, window "
+                      << (prefetcher->budget() / (1024 * 1024)) << " MB\n";
+        }
+        if (group_commit) {
+            uint64_t groups = group_commit->groups();
+            std::cout << "  fsync: " << group_commit->files() << " outputs in " << groups << " groups ("
+                      << std::setprecision(1) << (groups ? group_commit->files() * 1.0 / groups : 0.0)
+                      << " per group), " << group_commit->data_syncs()
+                      << (config.syncfs ? " syncfs" : " fdatasync") << ", " << group_commit->dir_syncs()
+                      << " dir syncs\n";
+        }
+        if (budget.capacity() != MemoryBudget::UNLIMITED) {
+            std::cout << "  memory budget: " << (budget.capacity() / (1024 * 1024)) << " MB, peak "
+                      << (budget.peak() / (1024 * 1024)) << " MB reserved, "
+                      << budget.waits() << " jobs waited\n";
+        }
+        print_cost_model(totals);
     }
     
-    print_summary(results, total_time);
+    if (!config.cost_log.empty()) {
+        cost_log.close();
+        if (!cost_log) std::cerr << "Warning: could not write cost log " << config.cost_log << "\n";
+    }
     
     // EXIT CODE FIX: Return non-zero if any images failed
-    size_t total_failures = 0;
-    for (const auto& r : results) {
-        if (!r.success) total_failures++;
-    }
-    if (total_failures == results.size()) return 2;  // All failed
-    if (total_failures > 0) return 1;                 // Partial failure
+    if (totals.failed == totals.images) return 2;  // All failed
+    if (totals.failed > 0) return 1;               // Partial failure
     return 0;
 }
 
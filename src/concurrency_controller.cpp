@@ -0,0 +1,160 @@
+#include "concurrency_controller.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace squish {
+
+// durchsatz schwankt auch ohne änderung ein paar prozent (jobgrößen, page cache)
+constexpr double RATE_NOISE = 0.05;
+// ab so viel blockierter zeit gilt der lauf als io-bound -> mehr threads probieren
+constexpr double IO_BOUND = 0.15;
+// gewicht des neuen fensters im geglätteten durchsatz pro worker zahl
+constexpr double RATE_SMOOTHING = 0.5;
+// so viele input ordner werden gemerkt, älteste fliegen raus
+constexpr size_t MAX_REMEMBERED_INPUTS = 256;
+
+ConcurrencyController::ConcurrencyController(size_t initial, size_t max_workers)
+    : max_workers_(std::max<size_t>(max_workers, 1)),
+      workers_(std::clamp<size_t>(initial, 1, std::max<size_t>(max_workers, 1))) {}
+
+size_t ConcurrencyController::update(const Sample& sample) {
+    if (sample.images == 0 || sample.window_ms <= 0) return workers_;
+
+    // durchsatz in geschätzter arbeit statt bildern pro sekunde: jobs laufen largest-first,
+    // images/s steigt also über den lauf von selbst und würde jede änderung gut aussehen lassen
+    const double rate = sample.work_ms / sample.window_ms;
+    // blockiert = weder gerechnet noch auf eine cpu gewartet. zu viele threads für die kerne
+    // sieht sonst genauso aus wie langsame platte, braucht aber genau das gegenteil
+    const double busy = sample.cpu_ms + sample.runqueue_ms;
+    io_wait_ = sample.job_ms > 0 ? std::clamp(1.0 - busy / sample.job_ms, 0.0, 1.0) : 0.0;
+
+    auto it = rates_.find(workers_);
+    if (it == rates_.end()) rates_[workers_] = rate;
+    else it->second = it->second * (1.0 - RATE_SMOOTHING) + rate * RATE_SMOOTHING;
+
+    if (windows_ == 0) {
+        // erster schritt: blockiert viel -> mehr threads, sonst schauen ob weniger genauso gehen
+        direction_ = io_wait_ > IO_BOUND ? 1 : -1;
+    } else if (rate < last_rate_ * (1.0 - RATE_NOISE)) {
+        direction_ = -direction_;  // letzter schritt hat geschadet, zurück
+    } else if (rate < last_rate_ * (1.0 + RATE_NOISE) && io_wait_ <= IO_BOUND) {
+        direction_ = -1;  // gleich schnell und cpu-bound: weniger threads reichen
+    }
+    // sonst: besser geworden, weiter in die gleiche richtung
+    last_rate_ = rate;
+    windows_++;
+
+    size_t next = workers_;
+    if (direction_ > 0 && workers_ < max_workers_) next = workers_ + 1;
+    else if (direction_ < 0 && workers_ > 1) next = workers_ - 1;
+    else direction_ = -direction_;  // am rand umdrehen
+
+    if (next != workers_) changes_++;
+    workers_ = next;
+    return workers_;
+}
+
+size_t ConcurrencyController::best() const {
+    size_t best = workers_;
+    double best_rate = -1;
+    for (const auto& [n, rate] : rates_) {
+        // bei gleichstand (im rauschen) die kleinere zahl
+        if (rate > best_rate * (1.0 + RATE_NOISE)) {
+            best = n;
+            best_rate = rate;
+        }
+    }
+    return best;
+}
+
+static std::filesystem::path state_file() {
+#ifdef _WIN32
+    const char* base = std::getenv("LOCALAPPDATA");
+    if (!base || !*base) return {};
+    return std::filesystem::path(base) / "squish" / "workers";
+#else
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        return std::filesystem::path(xdg) / "squish" / "workers";
+    }
+    const char* home = std::getenv("HOME");
+    if (!home || !*home) return {};
+    return std::filesystem::path(home) / ".cache" / "squish" / "workers";
+#endif
+}
+
+// eine zeile pro input: "<workers>\t<key>"
+std::optional<size_t> ConcurrencyController::load(const std::string& key) {
+    auto path = state_file();
+    if (path.empty()) return std::nullopt;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos || line.compare(tab + 1, std::string::npos, key) != 0) continue;
+        try {
+            size_t workers = std::stoul(line.substr(0, tab));
+            if (workers > 0) return workers;
+        } catch (...) {}
+    }
+    return std::nullopt;
+}
+
+bool ConcurrencyController::save(const std::string& key, size_t workers) {
+    if (key.empty() || key.find('\n') != std::string::npos) return false;
+    auto path = state_file();
+    if (path.empty()) return false;
+
+    std::vector<std::string> lines;
+    {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t tab = line.find('\t');
+            if (tab != std::string::npos && line.compare(tab + 1, std::string::npos, key) == 0) continue;
+            lines.push_back(line);
+        }
+    }
+    lines.push_back(std::to_string(workers) + "\t" + key);
+    if (lines.size() > MAX_REMEMBERED_INPUTS) {
+        lines.erase(lines.begin(), lines.end() - MAX_REMEMBERED_INPUTS);
+    }
+
+    // tmp + rename, parallele läufe sollen sich die datei nicht zerschießen. tmp name pro
+    // prozess, sonst schreiben zwei läufe gleichzeitig in dasselbe .tmp und einer benennt
+    // die halbe datei des anderen um
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+#ifdef _WIN32
+    long pid = static_cast<long>(::_getpid());
+#else
+    long pid = static_cast<long>(::getpid());
+#endif
+    auto tmp = path;
+    tmp += ".";
+    tmp += std::to_string(pid);
+    tmp += ".tmp";
+    bool written;
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        for (const auto& l : lines) out << l << '\n';
+        written = static_cast<bool>(out);
+    }
+    if (written) std::filesystem::rename(tmp, path, ec);
+    if (!written || ec) {
+        std::error_code rm_ec;
+        std::filesystem::remove(tmp, rm_ec);
+        return false;
+    }
+    return true;
+}
+
+} // namespace squish
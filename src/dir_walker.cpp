@@ -0,0 +1,183 @@
+#include "dir_walker.hpp"
+#include "image_processor.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace squish {
+
+// gefundene files gehen in schüben dieser größe an den sink
+constexpr size_t WALK_BATCH = 256;
+// getdents64 buffer: auf nfs holt ein großer buffer mehr einträge pro READDIR(PLUS)
+constexpr size_t WALK_DENTS_BYTES = 64 * 1024;
+
+DirWalker::DirWalker(size_t threads, Sink sink)
+    : threads_(std::max<size_t>(threads, 1)), sink_(std::move(sink)) {}
+
+void DirWalker::take(Batch& batch, std::filesystem::path file) {
+    files_.fetch_add(1, std::memory_order_relaxed);
+    batch.push_back(std::move(file));
+    if (batch.size() >= WALK_BATCH) flush(batch);
+}
+
+void DirWalker::flush(Batch& batch) {
+    if (batch.empty()) return;
+    sink_(std::move(batch));
+    batch = Batch();
+    batch.reserve(WALK_BATCH);
+}
+
+void DirWalker::warn(const std::filesystem::path& dir, int error) {
+    // EACCES wie bisher still überspringen, ENOENT = grad gelöscht
+    if (error == EACCES || error == ENOENT) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::cerr << "Warning: Error scanning " << dir << ": " << std::strerror(error) << "\n";
+}
+
+#ifdef __linux__
+
+void DirWalker::walk(const std::vector<std::filesystem::path>& roots) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.clear();
+        for (auto it = roots.rbegin(); it != roots.rend(); ++it) pending_.push_back({*it, true});  // erster root zuerst
+        busy_ = 0;
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(threads_ - 1);
+    for (size_t i = 1; i < threads_; ++i) threads.emplace_back([this] { run(); });
+    run();
+    for (auto& t : threads) t.join();
+}
+
+void DirWalker::run() {
+    Batch batch;
+    batch.reserve(WALK_BATCH);
+    std::vector<std::filesystem::path> subdirs;
+    while (true) {
+        Pending next;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (pending_.empty() && busy_ > 0) {
+                // nix zu tun: was schon gefunden ist raus, statt es bis zum ende zu halten
+                lock.unlock();
+                flush(batch);
+                lock.lock();
+            }
+            changed_.wait(lock, [&] { return !pending_.empty() || busy_ == 0; });
+            if (pending_.empty()) {
+                changed_.notify_all();
+                break;
+            }
+            next = std::move(pending_.back());
+            pending_.pop_back();
+            busy_++;
+        }
+        subdirs.clear();
+        scan(next.dir, next.root, batch, subdirs);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_--;
+            // rückwärts drauf, dann kommt das erste unterverzeichnis als nächstes dran
+            for (auto it = subdirs.rbegin(); it != subdirs.rend(); ++it) pending_.push_back({std::move(*it), false});
+        }
+        changed_.notify_all();
+    }
+    flush(batch);
+}
+
+void DirWalker::scan(const std::filesystem::path& dir, bool root, Batch& batch, std::vector<std::filesystem::path>& subdirs) {
+    // O_NOFOLLOW: falls jemand ein unterverzeichnis zwischendurch gegen einen symlink tauscht.
+    // roots kommen so wie angegeben, "photos -> /mnt/nas/photos" ist ganz normal
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (root ? 0 : O_NOFOLLOW);
+    int fd = ::openat(AT_FDCWD, dir.c_str(), flags);
+    if (fd < 0) {
+        warn(dir, errno);
+        return;
+    }
+    dirs_.fetch_add(1, std::memory_order_relaxed);
+    thread_local std::vector<char> buffer(WALK_DENTS_BYTES);
+    // struct linux_dirent64, glibc hat dafür keinen header
+    struct Dirent64 {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];
+    };
+    while (true) {
+        long n = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            warn(dir, errno);
+            break;
+        }
+        if (n == 0) break;
+        for (long off = 0; off < n;) {
+            auto* d = reinterpret_cast<Dirent64*>(buffer.data() + off);
+            off += d->d_reclen;
+            const char* name = d->d_name;
+            if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) continue;
+            unsigned char type = d->d_type;
+            if (type == DT_UNKNOWN) {
+                // manche fs (ältere xfs, manche fuse) liefern keinen typ: lstat-artig nachfragen
+                struct stat st {};
+                if (::fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_LNK;
+            }
+            if (type == DT_DIR) {
+                subdirs.push_back(dir / name);
+            } else if (type == DT_REG) {
+                std::filesystem::path file = dir / name;
+                if (ImageProcessor::is_supported(file)) take(batch, std::move(file));
+            }
+            // DT_LNK und alles andere (fifos, sockets, devices): nie anfassen
+        }
+    }
+    ::close(fd);
+}
+
+#else
+
+// kein getdents: wie bisher ein recursive_directory_iterator, aber schon gestreamt
+void DirWalker::walk(const std::vector<std::filesystem::path>& roots) {
+    Batch batch;
+    batch.reserve(WALK_BATCH);
+    for (const auto& root : roots) {
+        std::vector<std::filesystem::path> unused;
+        scan(root, true, batch, unused);
+    }
+    flush(batch);
+}
+
+void DirWalker::run() {}
+
+void DirWalker::scan(const std::filesystem::path& dir, bool, Batch& batch, std::vector<std::filesystem::path>&) {
+    // SYMLINK FIX: Don't follow symlinks (prevents infinite loops)
+    // Also wrap in try-catch for permission errors mid-traversal
+    try {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(
+            dir, std::filesystem::directory_options::skip_permission_denied)) {
+            if (entry.is_directory() && !entry.is_symlink()) dirs_.fetch_add(1, std::memory_order_relaxed);
+            if (entry.is_regular_file() && !entry.is_symlink() && ImageProcessor::is_supported(entry.path())) {
+                take(batch, entry.path());
+            }
+        }
+    } catch (const std::filesystem::filesystem_error& e) {
+        warn(dir, e.code().value());
+    }
+}
+
+#endif
+
+} // namespace squish
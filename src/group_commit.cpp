@@ -0,0 +1,232 @@
+#include "group_commit.hpp"
+#include "io_ring.hpp"
+#include <algorithm>
+#include <map>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace squish {
+
+// fdatasyncs einer gruppe gehen in schüben von so vielen an den ring
+constexpr unsigned COMMIT_RING_ENTRIES = 64;
+
+#ifdef __linux__
+// syncfs für das fs auf dem dir liegt, jedes fs nur einmal pro runde
+static std::error_code syncfs_dir(const std::string& dir, std::vector<std::pair<dev_t, std::error_code>>& done,
+                                  uint64_t& syncs) {
+    int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return std::error_code(errno, std::generic_category());
+    std::error_code ec;
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ec = std::error_code(errno, std::generic_category());
+    } else {
+        auto it = std::find_if(done.begin(), done.end(), [&](const auto& d) { return d.first == st.st_dev; });
+        if (it != done.end()) {
+            ec = it->second;
+        } else {
+            syncs++;
+            if (::syncfs(fd) != 0) ec = std::error_code(errno, std::generic_category());
+            done.emplace_back(st.st_dev, ec);
+        }
+    }
+    ::close(fd);
+    return ec;
+}
+#endif
+
+GroupCommit::GroupCommit(Mode mode) : mode_(mode) {
+    thread_ = std::thread([this] { run(); });
+}
+
+GroupCommit::~GroupCommit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+GroupCommit::Ticket GroupCommit::stage(atomicfile::File file, const std::filesystem::path& target) {
+    Ticket ticket;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ticket = next_ticket_++;
+        Entry entry;
+        entry.ticket = ticket;
+        entry.file = std::move(file);
+        entry.dir = target.parent_path().string();
+        pending_.push_back(std::move(entry));
+    }
+    work_.notify_one();
+    return ticket;
+}
+
+std::error_code GroupCommit::wait(Ticket ticket) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    committed_.wait(lock, [&] { return done_upto_ >= ticket; });
+    auto it = errors_.find(ticket);
+    if (it == errors_.end()) return {};
+    std::error_code ec = it->second;
+    errors_.erase(it);
+    return ec;
+}
+
+bool GroupCommit::committed(Ticket ticket) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return done_upto_ >= ticket;
+}
+
+uint64_t GroupCommit::groups() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return groups_;
+}
+
+uint64_t GroupCommit::files() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return files_;
+}
+
+uint64_t GroupCommit::data_syncs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return data_syncs_;
+}
+
+uint64_t GroupCommit::dir_syncs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dir_syncs_;
+}
+
+void GroupCommit::run() {
+#if IORING_AVAILABLE
+    if (mode_ == Mode::File) ring_.init(COMMIT_RING_ENTRIES);  // gehört diesem thread
+#endif
+    std::vector<Entry> group;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_.wait(lock, [&] { return stop_ || !pending_.empty(); });
+            if (pending_.empty()) return;  // stop und alles committed
+            group.swap(pending_);
+        }
+
+        // 1. daten der ganzen gruppe auf die platte, vorher darf kein name drauf zeigen
+        // (sonst steht nach einem crash ein leeres file unter dem richtigen namen)
+        sync_data(group);
+
+        // 2. namen drauf. was beim syncen schon kaputt ging bleibt namenlos
+        for (Entry& e : group) {
+            if (!e.file.is_open()) continue;
+            if (e.error || !e.file.publish(e.error)) e.file.discard();
+        }
+
+        // 3. die neuen namen selber: jedes verzeichnis einmal, bzw. noch ein syncfs pro fs
+        uint64_t dirs = 0;
+        uint64_t syncs = 0;
+        std::map<std::string, std::error_code> synced;
+#ifdef __linux__
+        std::vector<std::pair<dev_t, std::error_code>> filesystems;
+#endif
+        for (Entry& e : group) {
+            auto [it, fresh] = synced.try_emplace(e.dir);
+            if (fresh) {
+#ifdef __linux__
+                if (mode_ == Mode::Syncfs) {
+                    it->second = syncfs_dir(e.dir, filesystems, syncs);
+                } else
+#endif
+                {
+                    dirs++;
+                    if (!atomicfile::File::sync_dir(e.dir)) it->second = std::error_code(errno, std::generic_category());
+                }
+            }
+            if (!e.error) e.error = it->second;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (Entry& e : group) {
+                if (e.error) errors_[e.ticket] = e.error;
+                done_upto_ = std::max(done_upto_, e.ticket);
+            }
+            groups_++;
+            files_ += group.size();
+            data_syncs_ += syncs;
+            dir_syncs_ += dirs;
+        }
+        committed_.notify_all();
+        group.clear();
+    }
+}
+
+void GroupCommit::sync_data(std::vector<Entry>& group) {
+    uint64_t syncs = 0;
+    auto failed = [](Entry& e) { e.error = std::error_code(errno, std::generic_category()); };
+
+#ifdef __linux__
+    // syncfs: einmal pro dateisystem, schreibt alles dirty zurück und wartet drauf
+    // (ein fehler gilt dann für alle files auf dem fs)
+    if (mode_ == Mode::Syncfs) {
+        std::vector<std::pair<dev_t, std::error_code>> done;
+        for (Entry& e : group) {
+            if (!e.file.is_open()) continue;
+            struct stat st {};
+            if (::fstat(e.file.fd(), &st) != 0) {
+                failed(e);
+                continue;
+            }
+            auto it = std::find_if(done.begin(), done.end(), [&](const auto& d) { return d.first == st.st_dev; });
+            if (it == done.end()) {
+                syncs++;
+                std::error_code ec;
+                if (::syncfs(e.file.fd()) != 0) ec = std::error_code(errno, std::generic_category());
+                it = done.insert(done.end(), {st.st_dev, ec});
+            }
+            e.error = it->second;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        data_syncs_ += syncs;
+        return;
+    }
+#endif
+
+    // fdatasync pro file. über io_uring laufen die parallel und das journal nimmt sie
+    // in einem commit mit, nacheinander wartet jeder auf seinen eigenen
+    size_t next = 0;
+#if IORING_AVAILABLE
+    while (ring_.ok() && next < group.size()) {
+        size_t first = next;
+        unsigned queued = 0;
+        for (; next < group.size() && ring_.space() > 0; ++next) {
+            if (!group[next].file.is_open()) continue;
+            ioring::Ring::prep_fsync(ring_.next_sqe(next), group[next].file.fd(), true);
+            queued++;
+        }
+        bool all = ring_.complete(queued, [&](uint64_t index, int res) {
+            if (res < 0) group[index].error = std::error_code(-res, std::generic_category());
+        });
+        if (!all) {
+            // ring kaputt, nicht wissen was durch ist: den schub nochmal einzeln, ab jetzt ohne ring
+            ring_.close();
+            next = first;
+            break;
+        }
+        syncs += queued;
+    }
+#endif
+    for (; next < group.size(); ++next) {
+        Entry& e = group[next];
+        if (!e.file.is_open()) continue;
+        syncs++;
+        if (!e.file.sync_data()) failed(e);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    data_syncs_ += syncs;
+}
+
+} // namespace squish
@@ -2,7 +2,9 @@
 #include <chrono>
 #include <algorithm>
 #include <cstring>
+#include <cmath>
 #include <fstream>
+#include <memory>
 
 // stb braucht die flags sonst isses lahm
 #define STBI_SSE2
@@ -13,6 +15,14 @@
 #define STBI_NO_PIC        // No Softimage PIC
 #define STBI_NO_PNM        // No PBM/PGM/PPM (Netpbm formats)
 
+// stb allokiert über unseren pool, decode buffer + zlib/huffman temps werden recycled
+#include "buffer_pool.hpp"
+#define STBI_MALLOC(sz)                   bufpool::allocate(sz)
+#define STBI_REALLOC(p, newsz)            bufpool::reallocate(p, newsz)
+#define STBI_FREE(p)                      bufpool::deallocate(p)
+#define STBIR_MALLOC(size, user_data)     ((void)(user_data), bufpool::allocate(size))
+#define STBIR_FREE(ptr, user_data)        ((void)(user_data), bufpool::deallocate(ptr))
+
 // stb zeugs
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -33,45 +43,32 @@
 // mmap ist krass schneller als fread, who knew
 #include "mmap_file.hpp"
 
-#ifdef _WIN32
-#include <windows.h>
-#endif
+// header probe: format/maße/exif aus dem gleichen mapping, kein stbi_info mehr
+#include "image_probe.hpp"
 
-// Helper: Check if sufficient memory is available before allocating
-// Returns false if likely to OOM (prevents thread deadlocks)
-static bool check_memory_available(size_t bytes_needed) {
-#ifdef _WIN32
-    MEMORYSTATUSEX status;
-    status.dwLength = sizeof(status);
-    if (!GlobalMemoryStatusEx(&status)) {
-        return true;  // If check fails, proceed anyway (better than false positive)
-    }
-    // Need at least bytes_needed + 20% safety margin
-    size_t required_with_margin = static_cast<size_t>(bytes_needed * 1.2);
-    return status.ullAvailPhys > required_with_margin;
-#else
-    // Linux: parse /proc/meminfo MemAvailable
-    std::ifstream meminfo("/proc/meminfo");
-    if (!meminfo) return true;
-    
-    std::string line;
-    while (std::getline(meminfo, line)) {
-        if (line.find("MemAvailable:") == 0) {
-            size_t kb_available = 0;
-            if (sscanf(line.c_str(), "MemAvailable: %zu kB", &kb_available) == 1) {
-                size_t bytes_available = kb_available * 1024;
-                size_t required_with_margin = static_cast<size_t>(bytes_needed * 1.2);
-                return bytes_available > required_with_margin;
-            }
-        }
-    }
-    return true;  // Fallback: proceed if can't determine
-#endif
-}
+// globales speicherbudget, jobs reservieren vor dem dekodieren
+#include "memory_budget.hpp"
 
 // eigener resizer, stb war hier auch zu langsam lol
 #include "fast_resize.hpp"
 
+// parallel_for für zeilenbänder innerhalb eines bildes
+#include "thread_pool.hpp"
+
+// outputs ohne namen bis sie fertig sind (O_TMPFILE + linkat)
+#include "atomic_file.hpp"
+
+// --fsync: sync + einhängen gruppenweise auf einem eigenen thread
+#include "group_commit.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 namespace squish {
 
 // Mutex to protect thread-unsafe stb library operations:
@@ -103,122 +100,183 @@ bool ImageProcessor::is_supported(const std::filesystem::path& path) {
     return std::find(supported.begin(), supported.end(), ext) != supported.end();
 }
 
-std::optional<ImageData> ImageProcessor::load_image(const std::filesystem::path& path) {
-    int width, height, channels;
-    unsigned char* data = nullptr;
-    int orientation = 1;  // normal = nicht gedreht
-    
-    // OOM PROTECTION: Check memory before loading to prevent thread deadlock
-    // Estimate: Worst case is uncompressed RGB at file_size * 100 (highly compressed JPEG)
-    // Most images decompress to ~10-50x file size, we use 100x as safety margin
-    std::error_code ec;
-    auto file_size = std::filesystem::file_size(path, ec);
-    if (!ec && file_size > 0) {
-        size_t estimated_decompressed = file_size * 100;  // Conservative estimate
-        constexpr size_t MAX_SINGLE_IMAGE = 2ULL * 1024 * 1024 * 1024;  // 2GB limit
-        
-        if (estimated_decompressed > MAX_SINGLE_IMAGE) {
-            // Reject absurdly large images (would need >2GB RAM decoded)
-            return std::nullopt;
-        }
-        
-        if (!check_memory_available(estimated_decompressed)) {
-            // Insufficient RAM - would likely cause OOM or swap thrashing
-            // Fail gracefully instead of hanging thread pool
-            return std::nullopt;
-        }
+// Validate dimensions before size calculation to prevent integer overflow
+static bool dimensions_ok(int width, int height, int channels) {
+    constexpr int MAX_DIMENSION = 65535;
+    constexpr uint64_t MAX_PIXELS = 100000000;  // 100 megapixels
+    return width > 0 && height > 0 && channels > 0 && channels <= 4 &&
+           width <= MAX_DIMENSION && height <= MAX_DIMENSION &&
+           static_cast<uint64_t>(width) * static_cast<uint64_t>(height) <= MAX_PIXELS;
+}
+
+// stbi output übernehmen: buffer kommt aus unserem pool - keine kopie.
+// exif drehung wird nur gemerkt, resize/encoder lesen später gedreht durch
+// (ImageData::oriented), das spart einen kompletten pass übers bild
+static std::optional<ImageData> adopt_decoded(unsigned char* data, int width, int height,
+                                              int channels, int orientation) {
+    if (!data) {
+        return std::nullopt;
+    }
+    if (!dimensions_ok(width, height, channels)) {
+        stbi_image_free(data);
+        return std::nullopt;
     }
     
-    // jpeg check für exif
-    auto ext = path.extension().string();
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-    bool is_jpeg = (ext == ".jpg" || ext == ".jpeg");
+    size_t row_bytes = static_cast<size_t>(width) * static_cast<size_t>(channels);
+    ImageData image;
+    image.storage = bufpool::Buffer::adopt(data, row_bytes * static_cast<size_t>(height));
+    image.width = width;
+    image.height = height;
+    image.channels = channels;
+    image.stride = static_cast<ptrdiff_t>(row_bytes);
+    image.orientation = orientation;
+    return image;
+}
+
+std::optional<ImageData> ImageProcessor::decode_image(
+    const uint8_t* bytes, size_t size, const imgprobe::Header& header
+) {
+    // header sagt schon zu groß -> gar nicht erst dekodieren
+    if (header.ok() && !dimensions_ok(header.width, header.height, header.channels)) {
+        return std::nullopt;
+    }
     
-    // mmap variante - viel schneller
-    mmapfile::MappedFile mapped;
-    if (mapped.open(path.string().c_str())) {
-        // exif direkt aus mmap buffer lesen, spart disk io
-        if (is_jpeg) {
-            orientation = exif::read_jpeg_orientation_mem(mapped.data(), mapped.size());
-        }
+    int width, height, channels;
+    unsigned char* data;
+    {
         // Lock to protect stbi_load_from_memory and preserve stbi_failure_reason()
         std::lock_guard<std::mutex> lock(stb_operations_mutex);
-        data = stbi_load_from_memory(mapped.data(), static_cast<int>(mapped.size()),
-                                     &width, &height, &channels, 0);
+        data = stbi_load_from_memory(bytes, static_cast<int>(size), &width, &height, &channels, 0);
     }
-    
-    // wenns nich klappt halt normal laden
-    if (!data) {
-        std::lock_guard<std::mutex> lock(stb_operations_mutex);
-        data = stbi_load(path.string().c_str(), &width, &height, &channels, 0);
-        // und exif halt extra lesen, blöd aber geht
-        if (is_jpeg && orientation == 1) {
-            orientation = exif::read_jpeg_orientation(path.string().c_str());
-        }
+    return adopt_decoded(data, width, height, channels, header.orientation);
+}
+
+std::optional<ImageData> ImageProcessor::load_image(const std::filesystem::path& path) {
+    // mmap variante - viel schneller, exif/header kommen aus demselben mapping
+    mmapfile::MappedFile mapped;
+    if (mapped.open(path.string().c_str())) {
+        return decode_image(mapped.data(), mapped.size(), imgprobe::probe(mapped.data(), mapped.size()));
     }
     
-    if (!data) {
-        return std::nullopt;
-    }
+    // wenns nich klappt halt normal laden (leere datei, fs ohne mmap)
+    auto ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    bool is_jpeg = (ext == ".jpg" || ext == ".jpeg");
     
-    // Validate dimensions before size calculation to prevent integer overflow
-    constexpr int MAX_DIMENSION = 65535;
-    constexpr uint64_t MAX_PIXELS = 100000000;  // 100 megapixels
-    if (width <= 0 || height <= 0 || channels <= 0 || channels > 4 ||
-        width > MAX_DIMENSION || height > MAX_DIMENSION ||
-        static_cast<uint64_t>(width) * static_cast<uint64_t>(height) > MAX_PIXELS) {
-        stbi_image_free(data);
-        return std::nullopt;
+    int width, height, channels;
+    unsigned char* data;
+    {
+        std::lock_guard<std::mutex> lock(stb_operations_mutex);
+        data = stbi_load(path.string().c_str(), &width, &height, &channels, 0);
     }
-    
+    // und exif halt extra lesen, blöd aber geht
+    int orientation = (data && is_jpeg) ? exif::read_jpeg_orientation(path.string().c_str()) : 1;
+    return adopt_decoded(data, width, height, channels, orientation);
+}
+
+ImageData ImageData::create(int width, int height, int channels, imgview::Layout layout) {
     ImageData image;
     image.width = width;
     image.height = height;
     image.channels = channels;
+    image.layout = layout;
     
-    // stbi gibt uns nen raw pointer, müssen wir kopieren
-    size_t size = static_cast<size_t>(width) * static_cast<size_t>(height) * static_cast<size_t>(channels);
-    try {
-        image.pixels.assign(data, data + size);
-    } catch (...) {
-        stbi_image_free(data);  // Exception-safe: free before re-throw
-        throw;
+    size_t total;
+    if (layout == imgview::Layout::Planar) {
+        image.stride = static_cast<ptrdiff_t>(imgview::aligned_stride(static_cast<size_t>(width)));
+        image.plane_stride = image.stride * height;
+        total = static_cast<size_t>(image.plane_stride) * channels;
+    } else {
+        image.stride = static_cast<ptrdiff_t>(imgview::aligned_stride(static_cast<size_t>(width) * channels));
+        total = static_cast<size_t>(image.stride) * height;
     }
-    stbi_image_free(data);
     
-    // jpeg drehen wenn nötig
-    if (orientation != 1) {
-        exif::apply_orientation(image.pixels, image.width, image.height, 
-                               orientation, image.channels);
+    image.storage = bufpool::Buffer(total);
+    if (!image.storage) {
+        throw std::bad_alloc();
     }
-    
     return image;
 }
 
-ImageData ImageProcessor::resize(const ImageData& image, int new_width, int new_height) {
+imgview::ConstView ImageData::oriented() const {
+    return exif::oriented_view(view(), orientation);
+}
+
+// so klein wird ein zeilenband nicht, darunter frisst der overhead den gewinn
+constexpr int MIN_ROW_BAND = 16;
+
+// zeilen/bänder eines bildes über den pool verteilen, aber nur wenn wir selber in einem
+// worker laufen (CLI). die helfer landen in der eigenen deque: sind alle anderen worker
+// beschäftigt, arbeitet der aufrufer sie selber ab; wird einer frei (ende vom batch,
+// einzelnes großes bild) klaut er sich bänder. ohne pool läuft alles am stück wie vorher
+struct PoolRows {
+    ThreadPool* pool = ThreadPool::current();
+    int min_band = MIN_ROW_BAND;  // in einheiten von n (zeilen, kachelzeilen, intervalle)
+
+    PoolRows() = default;
+    explicit PoolRows(int band) : min_band(band) {}
+
+    template<typename Fn>
+    void operator()(int n, Fn&& fn) const {
+        if (!pool || pool->active() < 2 || n < 2 * min_band) {
+            if (n > 0) fn(0, n);
+            return;
+        }
+        size_t grain = std::max<size_t>(min_band, static_cast<size_t>(n) / (pool->active() * 4));
+        pool->parallel_for(0, static_cast<size_t>(n), grain, [&](size_t lo, size_t hi) {
+            fn(static_cast<int>(lo), static_cast<int>(hi));
+        });
+    }
+};
+
+ImageData ImageProcessor::apply_orientation(imgview::ConstView image, int orientation) {
+    int out_w = image.width, out_h = image.height;
+    if (exif::swaps_dimensions(orientation)) {
+        std::swap(out_w, out_h);
+    }
+    ImageData result = ImageData::create(out_w, out_h, image.channels, image.layout);
+    exif::apply_orientation(image, result.view(), orientation, PoolRows(2));  // 2 kachelzeilen = 64 px
+    return result;
+}
+
+// unser simd resizer kann rgb downscale, auch mit gedreht gelesener quelle
+static bool use_fast_resize(imgview::ConstView image, int new_width, int new_height) {
+    return image.channels == 3 && !image.planar() && new_width < image.width && new_height < image.height;
+}
+
+ImageData ImageProcessor::resize(imgview::ConstView image, int new_width, int new_height) {
+    // OOM FIX: Catch bad_alloc from pool allocation
     ImageData result;
-    result.width = new_width;
-    result.height = new_height;
-    result.channels = image.channels;
-    
-    // OOM FIX: Catch bad_alloc from vector resize
     try {
-        result.pixels.resize(static_cast<size_t>(new_width) * static_cast<size_t>(new_height) * static_cast<size_t>(image.channels));
+        result = ImageData::create(new_width, new_height, image.channels, image.layout);
     } catch (const std::bad_alloc& e) {
         throw std::runtime_error("Out of memory: Failed to allocate " + 
             std::to_string(static_cast<size_t>(new_width) * static_cast<size_t>(new_height) * static_cast<size_t>(image.channels)) + " bytes for resized image");
     }
     
     // unser simd resizer für rgb - ballert richtig
-    if (image.channels == 3 && new_width < image.width && new_height < image.height) {
+    if (use_fast_resize(image, new_width, new_height)) {
         fastresize::resize_rgb(
-            image.pixels.data(), image.width, image.height,
-            result.pixels.data(), new_width, new_height
+            image.data, image.width, image.height, image.stride,
+            result.data(), new_width, new_height, result.stride, image.step(), PoolRows{}
         );
-    } else {
-        // für alpha/grau/upscale stb nehmen, egal
+        return result;
+    }
+    
+    // stbir kann nicht gedreht lesen, dann vorher umkopieren
+    // (process() dreht in dem fall schon vorher mit den simd kernels, das hier ist nur fallback)
+    ImageData straight;
+    if (!image.rows_contiguous()) {
+        straight = ImageData::create(image.width, image.height, image.channels, image.layout);
+        imgview::copy(image, straight.view());
+        image = straight.view();
+    }
+    
+    // für alpha/grau/upscale stb nehmen, egal
+    // planar = jede plane einzeln als 1-kanal bild
+    auto resize_plane = [&](imgview::ConstView src, imgview::View dst) {
         stbir_pixel_layout layout;
-        switch (image.channels) {
+        switch (src.channels) {
             case 1: layout = STBIR_1CHANNEL; break;
             case 2: layout = STBIR_2CHANNEL; break;
             case 3: layout = STBIR_RGB; break;
@@ -226,30 +284,90 @@ ImageData ImageProcessor::resize(const ImageData& image, int new_width, int new_
             default: layout = STBIR_RGBA; break;
         }
         
-        // OOM FIX: Check stbir_resize return value (returns NULL on failure)
-        unsigned char* resize_result = stbir_resize_uint8_linear(
-            image.pixels.data(), image.width, image.height, 0,
-            result.pixels.data(), new_width, new_height, 0,
-            layout
-        );
+        // gleiche einstellungen wie stbir_resize_uint8_linear (clamp, default filter),
+        // nur mit splits damit die ausgabezeilen auf den pool verteilt werden können
+        STBIR_RESIZE r;
+        stbir_resize_init(&r, src.data, src.width, src.height, static_cast<int>(src.stride),
+                          dst.data, dst.width, dst.height, static_cast<int>(dst.stride),
+                          layout, STBIR_TYPE_UINT8);
+        
+        ThreadPool* pool = ThreadPool::current();
+        int want_splits = 1;
+        if (pool && pool->active() > 1) {
+            want_splits = std::clamp(dst.height / (MIN_ROW_BAND * 2), 1, static_cast<int>(pool->active()));
+        }
         
-        if (!resize_result) {
+        // OOM FIX: Check stbir return values (0 on failure)
+        int splits = stbir_build_samplers_with_splits(&r, want_splits);
+        bool ok = splits > 0;
+        if (ok && splits == 1) {
+            ok = stbir_resize_extended(&r) != 0;
+        } else if (ok) {
+            std::atomic<bool> split_ok{true};
+            pool->parallel_for(0, static_cast<size_t>(splits), 1, [&](size_t lo, size_t hi) {
+                if (!stbir_resize_extended_split(&r, static_cast<int>(lo), static_cast<int>(hi - lo))) {
+                    split_ok = false;
+                }
+            });
+            ok = split_ok;
+        }
+        stbir_free_samplers(&r);
+        
+        if (!ok) {
             throw std::runtime_error("stbir_resize failed (likely out of memory): " + 
                 std::to_string(new_width) + "x" + std::to_string(new_height));
         }
+    };
+    
+    if (image.planar()) {
+        for (int c = 0; c < image.channels; c++) {
+            resize_plane(image.plane_view(c), result.view().plane_view(c));
+        }
+    } else {
+        resize_plane(image, result.view());
     }
     
     return result;
 }
 
+// fpng/stbi_write_jpg wollen gepackte interleaved zeilen ohne padding
+// nur wenn nötig umkopieren, gepackte views gehen direkt durch
+static imgview::ConstView packed_for_writer(imgview::ConstView image, bufpool::Buffer& tmp) {
+    if (image.packed()) return image;
+    size_t row_bytes = static_cast<size_t>(image.width) * image.channels;
+    tmp = bufpool::Buffer(row_bytes * image.height);
+    if (!tmp) throw std::bad_alloc();
+    auto packed = imgview::packed_view(tmp.data(), image.width, image.height, image.channels);
+    imgview::copy(image, packed);
+    return packed;
+}
+
+// stb schreibt über einen callback, das landet hinten im encoded buffer
+struct WriteSink {
+    EncodedImage* out;
+    bool ok = true;
+};
+
+static void write_to_sink(void* context, void* data, int size) {
+    auto* sink = static_cast<WriteSink*>(context);
+    if (sink->ok) sink->ok = sink->out->append(data, static_cast<size_t>(size));
+}
+
+static void jpeg_to_sink(void* context, const uint8_t* data, size_t size) {
+    auto* sink = static_cast<WriteSink*>(context);
+    if (sink->ok) sink->ok = sink->out->append(data, size);
+}
+
 bool ImageProcessor::save_image(
-    const ImageData& image,
-    const std::filesystem::path& path,
+    imgview::ConstView image,
+    const std::filesystem::path& output_path,
+    EncodedImage& out,
     OutputFormat format,
     int quality,
     bool use_gpu
 ) {
-    auto ext = path.extension().string();
+    out.reset();
+    auto ext = output_path.extension().string();
     std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
     
     // format raten wenn auto
@@ -259,23 +377,32 @@ bool ImageProcessor::save_image(
         else format = OutputFormat::JPEG;  // Default
     }
     
-    std::string out_path = path.string();
-    
     // Ensure fpng is initialized (thread-safe)
     ensure_fpng_initialized();
     
+    // planar erst zurück nach interleaved, encoder können nur das
+    ImageData interleaved;
+    if (image.planar()) {
+        interleaved = ImageData::create(image.width, image.height, image.channels);
+        imgview::copy(image, interleaved.view());
+        image = interleaved.view();
+    }
+    bufpool::Buffer packed_tmp;
+    
     switch (format) {
         case OutputFormat::PNG: {
             // fpng geht nur mit rgb/rgba
             if (image.channels == 3 || image.channels == 4) {
-                // direkt auf disk schreiben, kein extra buffer
-                bool ok = fpng::fpng_encode_image_to_file(
-                    out_path.c_str(),
-                    image.pixels.data(),
+                // in speicher kodieren und am stück schreiben, fpng kennt keinen stride
+                auto packed = packed_for_writer(image, packed_tmp);
+                std::vector<uint8_t> png;
+                bool ok = fpng::fpng_encode_image_to_memory(
+                    packed.data,
                     image.width, image.height,
-                    image.channels
+                    image.channels,
+                    png
                 );
-                if (ok) return true;
+                if (ok) return out.append(png.data(), png.size());
             }
             // RACE CONDITION FIX: Protect stbi_write_png with mutex
             // stbi_write_png accesses thread-unsafe globals:
@@ -283,13 +410,15 @@ bool ImageProcessor::save_image(
             // - stbi__flip_vertically_on_write
             // Mutex ensures atomic access to these globals
             // graustufen etc über stb
+            if (!image.rows_contiguous()) image = packed_for_writer(image, packed_tmp);
             std::lock_guard<std::mutex> lock(stb_operations_mutex);
-            return stbi_write_png(
-                out_path.c_str(),
+            WriteSink sink{&out};
+            return stbi_write_png_to_func(
+                write_to_sink, &sink,
                 image.width, image.height, image.channels,
-                image.pixels.data(),
-                image.width * image.channels
-            ) != 0;
+                image.data,
+                static_cast<int>(image.stride)
+            ) != 0 && sink.ok;
         }
             
         case OutputFormat::JPEG:
@@ -298,144 +427,534 @@ bool ImageProcessor::save_image(
             if (image.channels == 3) {
                 // jpeg output größe raten, lieber zu viel als zu wenig
                 size_t estimated_size = static_cast<size_t>(image.width) * image.height / 2 + 65536;
-                mmapfile::MappedFileWrite mf(out_path, estimated_size);
-                if (!mf.data()) {
-                    // mmap ging nich, file fallback
-                    return fastjpeg::encode_jpeg(
-                        out_path.c_str(),
-                        image.pixels.data(),
-                        image.width, image.height,
-                        quality
+                out.data = bufpool::Buffer(estimated_size);
+                size_t actual_size = 0;
+                if (out.data) {
+                    // gpu version wenn gewünscht, sonst cpu
+                    // große bilder: restart intervalle parallel über den pool
+                    actual_size = fastjpeg::encode_jpeg_gpu(
+                        out.data.data(),
+                        out.data.size(),
+                        image,
+                        quality,
+                        use_gpu,
+                        PoolRows(1)
                     );
                 }
-                // gpu version wenn gewünscht, sonst cpu
-                size_t actual_size = fastjpeg::encode_jpeg_gpu(
-                    mf.data(),
-                    mf.size(),
-                    image.pixels.data(),
-                    image.width, image.height,
-                    quality,
-                    use_gpu
-                );
-                // MMAP OVERFLOW FIX: actual_size==0 means buffer overflow, fall back to file-based encoder
+                // OVERFLOW FIX: actual_size==0 means buffer overflow, fall back to the
+                // streaming encoder (wächst mit, kein größen-raten)
                 if (actual_size == 0) {
-                    mf.truncate(0);  // discard partial data
-                    return fastjpeg::encode_jpeg(
-                        out_path.c_str(),
-                        image.pixels.data(),
-                        image.width, image.height,
-                        quality
-                    );
+                    out.reset();
+                    WriteSink sink{&out};
+                    return fastjpeg::encode_jpeg(jpeg_to_sink, &sink, image, quality) && sink.ok;
                 }
-                // file auf echte größe kürzen
-                mf.truncate(actual_size);
+                out.size = actual_size;
                 return true;
             }
             // THREAD SAFETY FIX: Protect stbi_write_jpg with mutex
             // stbi_write_jpg uses thread-unsafe global state (stb_image_write.h:251-260)
             // für komische formate stb
             {
+                auto packed = packed_for_writer(image, packed_tmp);
                 std::lock_guard<std::mutex> lock(stb_operations_mutex);
-                return stbi_write_jpg(
-                    out_path.c_str(),
+                WriteSink sink{&out};
+                return stbi_write_jpg_to_func(
+                    write_to_sink, &sink,
                     image.width, image.height, image.channels,
-                    image.pixels.data(),
+                    packed.data,
                     quality
-                ) != 0;
+                ) != 0 && sink.ok;
             }
     }
 }
 
+// zielmaße nach max_width/max_height (w/h schon exif-gedreht)
+static std::pair<int, int> target_dimensions(int width, int height, const ProcessingOptions& options) {
+    int new_width = width;
+    int new_height = height;
+    if (options.max_width > 0 || options.max_height > 0) {
+        if (options.preserve_aspect) {
+            double ratio = static_cast<double>(width) / height;
+            
+            if (options.max_width > 0 && new_width > options.max_width) {
+                new_width = options.max_width;
+                new_height = static_cast<int>(new_width / ratio);
+            }
+            if (options.max_height > 0 && new_height > options.max_height) {
+                new_height = options.max_height;
+                new_width = static_cast<int>(new_height * ratio);
+            }
+        } else {
+            if (options.max_width > 0) new_width = options.max_width;
+            if (options.max_height > 0) new_height = options.max_height;
+        }
+    }
+    return {new_width, new_height};
+}
+
+// schon gut komprimiert -> process() kopiert nur
+static bool already_compressed(bool is_jpeg, bool is_png, const imgprobe::Header& header,
+                               size_t file_size, const ProcessingOptions& options) {
+    if (!(is_jpeg || is_png) || options.max_width != 0 || options.max_height != 0 || !header.ok()) {
+        return false;
+    }
+    size_t raw_size = static_cast<size_t>(header.width) * header.height * header.channels;
+    double compression_ratio = static_cast<double>(file_size) / raw_size;
+    
+    return (is_jpeg && compression_ratio < 0.10) ||  // unter 10% raw size = gut genug
+           (is_png && compression_ratio < 0.50);     // png braucht mehr
+}
+
+// grobe kosten pro stufe in ns, kalibriert mit --cost-log auf einzelnen files (release build).
+// muss nicht genau stimmen, nur die reihenfolge der jobs soll passen.
+// jpeg: entropy decode/encode skaliert mit den komprimierten bytes, nicht nur mit pixeln
+constexpr double COST_FIXED_NS = 150000.0;             // open/mmap/rename/stat
+constexpr double COST_COPY_NS_PER_BYTE = 0.3;          // skip: copy_file
+constexpr double COST_DECODE_JPEG_NS_PER_PX = 8.0;
+constexpr double COST_DECODE_JPEG_NS_PER_BYTE = 18.0;  // huffman
+constexpr double COST_DECODE_PNG_NS_PER_PX = 6.0;
+constexpr double COST_INFLATE_NS_PER_BYTE = 2.0;       // png zlib
+constexpr double COST_DECODE_RAW_NS_PER_PX = 4.0;      // bmp/tga/gif
+constexpr double COST_RESIZE_NS_PER_PX = 1.5;          // pro quellpixel
+constexpr double COST_ROTATE_NS_PER_PX = 1.0;          // nur wenn nicht fused
+constexpr double COST_ENCODE_JPEG_NS_PER_PX = 12.0;
+constexpr double COST_ENCODE_JPEG_NS_PER_BYTE = 15.0;  // viel detail rein = viel huffman raus
+constexpr double COST_TYPICAL_JPEG_BYTES_PER_PX = 0.5;
+constexpr double COST_ENCODE_FPNG_NS_PER_PX = 4.0;
+constexpr double COST_ENCODE_STB_PNG_NS_PER_PX = 100.0;  // grau/grau+alpha, stb zlib + mutex
+
+// cpu zeit des aktuellen threads und wie lang er lauffähig auf eine cpu gewartet hat.
+// wall - cpu - runqueue = zeit in der der job wirklich blockiert war (io, page faults)
+struct ThreadTimes {
+    double cpu_ms = 0;
+    double runqueue_ms = 0;
+};
+
+static ThreadTimes thread_times() {
+    ThreadTimes t;
+#ifdef _WIN32
+    FILETIME creation, exited, kernel, user;
+    if (GetThreadTimes(GetCurrentThread(), &creation, &exited, &kernel, &user)) {
+        auto ticks = [](const FILETIME& ft) {
+            return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+        };
+        t.cpu_ms = static_cast<double>(ticks(kernel) + ticks(user)) / 10000.0;  // 100 ns einheiten
+    }
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        t.cpu_ms = ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+    }
+#endif
+#ifdef __linux__
+    // "laufzeit_ns runqueue_ns timeslices", fehlt ohne CONFIG_SCHEDSTATS -> 0
+    std::ifstream schedstat("/proc/thread-self/schedstat");
+    uint64_t run_ns = 0, wait_ns = 0;
+    if (schedstat >> run_ns >> wait_ns) t.runqueue_ms = wait_ns / 1e6;
+#endif
+    return t;
+}
+
+static double ms_between(std::chrono::high_resolution_clock::time_point a,
+                         std::chrono::high_resolution_clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+// wieviel speicher ein job braucht, nur aus den header maßen. zwei spitzen:
+// beim dekodieren (stbi hält jpeg komponenten / png zeilen + die ausgabe gleichzeitig)
+// und danach dekodiertes bild + gedrehte kopie + resize ziel + encoder puffer
+constexpr uint64_t MEM_DECODE_COPIES = 2;
+constexpr double MEM_GUESS_PX_PER_BYTE = 10.0;  // header unbekannt: wie ein normales jpeg
+constexpr uint64_t MEM_GUESS_CHANNELS = 4;
+
+static uint64_t job_footprint(const imgprobe::Header& h, size_t file_size, bool is_png,
+                              const ProcessingOptions& options) {
+    uint64_t w, hgt, ch;
+    int ow, oh;
+    if (h.ok()) {
+        w = static_cast<uint64_t>(h.width);
+        hgt = static_cast<uint64_t>(h.height);
+        ch = static_cast<uint64_t>(h.channels);
+        bool swap = exif::swaps_dimensions(h.orientation);
+        ow = swap ? h.height : h.width;
+        oh = swap ? h.width : h.height;
+    } else {
+        w = hgt = static_cast<uint64_t>(std::sqrt(static_cast<double>(file_size) * MEM_GUESS_PX_PER_BYTE)) + 1;
+        ch = MEM_GUESS_CHANNELS;
+        ow = oh = static_cast<int>(std::min<uint64_t>(w, 65535));
+    }
+    const uint64_t src = w * hgt * ch;
+    const uint64_t decode = src * MEM_DECODE_COPIES + (h.format == imgprobe::Format::PNG ? file_size : 0);
+    
+    auto [new_width, new_height] = target_dimensions(std::max(ow, 1), std::max(oh, 1), options);
+    const uint64_t out_px = static_cast<uint64_t>(new_width) * static_cast<uint64_t>(new_height);
+    uint64_t pipeline = src;
+    if (h.orientation != 1) pipeline += src;  // falls die drehung nicht fused werden kann
+    if (new_width != ow || new_height != oh) pipeline += out_px * ch;
+    if (is_png) {
+        pipeline += out_px * ch * 2;  // fpng: gepackte kopie + ausgabe
+    } else if (ch == 3) {
+        // ausgabe buffer (hängt bis zum schreiben am job) + restart segmente
+        pipeline += out_px / 2 + 65536 + fastjpeg::MemEncoder::scratch_bytes(new_width, new_height);
+    } else {
+        pipeline += out_px * ch;  // stb: gepackte kopie
+    }
+    return std::max(decode, pipeline);
+}
+
+JobEstimate ImageProcessor::estimate(const std::filesystem::path& input, const ProcessingOptions& options) {
+    JobEstimate est;
+    
+    auto ext = input.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    bool is_jpeg = (ext == ".jpg" || ext == ".jpeg");
+    bool is_png = (ext == ".png");
+    
+    // mappen kostet fast nix, gelesen werden nur die header pages
+    mmapfile::MappedFile mapped;
+    if (mapped.open(input.string().c_str())) {
+        est.file_size = mapped.size();
+        est.header = imgprobe::probe(mapped.data(), mapped.size());
+        if (options.order == InputOrder::Inode || options.order == InputOrder::Disk) {
+            est.location = mapped.location(options.order == InputOrder::Disk);
+        }
+    } else {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(input, ec);
+        est.file_size = ec ? 0 : static_cast<size_t>(size);
+    }
+    
+    double ns = COST_FIXED_NS;
+    if (already_compressed(is_jpeg, is_png, est.header, est.file_size, options)) {
+        est.cost_ms = (ns + est.file_size * COST_COPY_NS_PER_BYTE) / 1e6;
+        return est;
+    }
+    
+    const imgprobe::Header& h = est.header;
+    double src_px;
+    int ow, oh;
+    if (h.ok()) {
+        src_px = static_cast<double>(h.width) * h.height;
+        bool swap = exif::swaps_dimensions(h.orientation);
+        ow = swap ? h.height : h.width;
+        oh = swap ? h.width : h.height;
+    } else {
+        // header kaputt/unbekannt: ~1 byte pro 10 pixel wie ein normales jpeg
+        src_px = static_cast<double>(est.file_size) * 10.0;
+        ow = oh = static_cast<int>(std::sqrt(src_px));
+    }
+    
+    switch (h.format) {
+        case imgprobe::Format::JPEG:
+            ns += src_px * COST_DECODE_JPEG_NS_PER_PX + est.file_size * COST_DECODE_JPEG_NS_PER_BYTE;
+            break;
+        case imgprobe::Format::PNG:
+            ns += src_px * COST_DECODE_PNG_NS_PER_PX + est.file_size * COST_INFLATE_NS_PER_BYTE;
+            break;
+        default:
+            ns += src_px * COST_DECODE_RAW_NS_PER_PX;
+            break;
+    }
+    
+    auto [new_width, new_height] = target_dimensions(std::max(ow, 1), std::max(oh, 1), options);
+    bool needs_resize = new_width != ow || new_height != oh;
+    if (needs_resize) ns += src_px * COST_RESIZE_NS_PER_PX;
+    if (h.orientation != 1 && !needs_resize && !is_jpeg) ns += src_px * COST_ROTATE_NS_PER_PX;
+    
+    est.memory_bytes = job_footprint(h, est.file_size, is_png, options);
+    
+    double out_px = static_cast<double>(new_width) * new_height;
+    if (is_png) {
+        ns += out_px * ((h.channels == 3 || h.channels == 4) ? COST_ENCODE_FPNG_NS_PER_PX : COST_ENCODE_STB_PNG_NS_PER_PX);
+    } else {
+        ns += out_px * COST_ENCODE_JPEG_NS_PER_PX;
+        // detail pro pixel: bei jpeg quellen aus der dateigröße, sonst ~ein normales foto
+        double bytes_per_px = h.format == imgprobe::Format::JPEG
+            ? est.file_size / std::max(src_px, 1.0)
+            : COST_TYPICAL_JPEG_BYTES_PER_PX;
+        ns += out_px * bytes_per_px * COST_ENCODE_JPEG_NS_PER_BYTE;
+    }
+    
+    est.cost_ms = ns / 1e6;
+    return est;
+}
+
 ProcessingResult ImageProcessor::process(
     const std::filesystem::path& input,
     const std::filesystem::path& output_dir,
-    const ProcessingOptions& options
+    const ProcessingOptions& options,
+    const FileOverrides* overrides
 ) {
-    ProcessingResult result;
-    result.input_path = input;
-    
-    auto start = std::chrono::high_resolution_clock::now();
+    PipelineJob job;
+    job.overrides = overrides;
+    read(job, input, options);
+    compute(job, output_dir, options);
+    write(job, output_dir, options);
+    settle(job, options);
+    return std::move(job.result);
+}
+
+ProcessingOptions ImageProcessor::with_overrides(const ProcessingOptions& options, const FileOverrides& overrides) {
+    ProcessingOptions own = options;
+    if (overrides.quality > 0) own.quality = overrides.quality;
+    if (overrides.max_width >= 0) own.max_width = overrides.max_width;
+    if (overrides.max_height >= 0) own.max_height = overrides.max_height;
+    return own;
+}
+
+// optionen für diesen job: die vom lauf, oder eine kopie mit denen seiner --files-from zeile
+static const ProcessingOptions& job_options(const PipelineJob& job, const ProcessingOptions& options,
+                                            ProcessingOptions& own) {
+    if (!job.overrides) return options;
+    own = ImageProcessor::with_overrides(options, *job.overrides);
+    return own;
+}
+
+// output unter -o mit dem namen vom input, außer die --files-from zeile gibt einen vor
+static std::filesystem::path output_for(const PipelineJob& job, const std::filesystem::path& output_dir,
+                                        const std::filesystem::path& filename) {
+    if (job.overrides && !job.overrides->output.empty()) return job.overrides->output;
+    return output_dir / filename;
+}
+
+// input ist da (gemappt oder gelesen): header lesen und entscheiden ob nur kopiert wird
+static void classify_input(PipelineJob& job, const ProcessingOptions& run_options) {
+    ProcessingOptions own;
+    const ProcessingOptions& options = job_options(job, run_options, own);
+    ProcessingResult& result = job.result;
+    if (job.has_input()) {
+        job.header = imgprobe::probe(job.input_data(), job.input_size());
+    }
     
-    // extension früh holen
-    auto ext = input.extension().string();
+    auto ext = result.input_path.extension().string();
     std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
     bool is_jpeg = (ext == ".jpg" || ext == ".jpeg");
     bool is_png = (ext == ".png");
     
-    // original größe für stats
-    try {
-        result.original_size = std::filesystem::file_size(input);
-    } catch (...) {
-        result.success = false;
-        result.error_message = "Cannot read input file";
-        return result;
+    // wenn schon gut komprimiert einfach kopieren (macht write), spart zeit
+    if (!job.done && already_compressed(is_jpeg, is_png, job.header, result.original_size, options)) {
+        job.copy = true;
+        job.release_input();
     }
+}
+
+void ImageProcessor::read(PipelineJob& job, const std::filesystem::path& input, const ProcessingOptions& options) {
+    ProcessingResult& result = job.result;
+    result.input_path = input;
+    auto start = std::chrono::high_resolution_clock::now();
     
-    // wenn schon gut komprimiert einfach kopieren, spart zeit
-    if ((is_jpeg || is_png) && options.max_width == 0 && options.max_height == 0) {
-        int width, height, channels;
-        // THREAD SAFETY FIX: stbi_info uses global state, needs mutex
-        bool info_ok;
-        {
-            std::lock_guard<std::mutex> lock(stb_operations_mutex);
-            info_ok = stbi_info(input.string().c_str(), &width, &height, &channels);
+    // datei genau einmal öffnen: fstat + mmap, header/exif aus den ersten bytes,
+    // decoder liest danach aus demselben mapping. spart auf netzwerk-fs die
+    // ganzen extra opens/stats von file_size + stbi_info + exif
+    if (job.mapped.open(input.string().c_str())) {
+        result.original_size = job.mapped.size();
+    } else {
+        // leere datei oder fs ohne mmap - stbi liest dann später selber
+        try {
+            result.original_size = std::filesystem::file_size(input);
+        } catch (...) {
+            result.success = false;
+            result.error_message = "Cannot read input file";
+            job.done = true;
         }
-        if (info_ok) {
-            size_t raw_size = static_cast<size_t>(width) * height * channels;
-            double compression_ratio = static_cast<double>(result.original_size) / raw_size;
-            
-            bool skip = (is_jpeg && compression_ratio < 0.10) ||  // unter 10% raw size = gut genug
-                        (is_png && compression_ratio < 0.50);      // png braucht mehr
-            
-            if (skip) {
-                result.output_path = output_dir / input.filename();
-                std::filesystem::copy_file(input, result.output_path, std::filesystem::copy_options::overwrite_existing);
-                result.compressed_size = result.original_size;
-                result.success = true;
-                auto end = std::chrono::high_resolution_clock::now();
-                result.processing_time_ms = std::chrono::duration<double, std::milli>(end - start).count();
-                return result;
+    }
+    
+    classify_input(job, options);
+    // jetzt lesen, hier im io thread - nicht später als page faults im decoder
+    job.mapped.prefault();
+    result.read_ms = ms_between(start, std::chrono::high_resolution_clock::now());
+}
+
+// io_uring reads lohnen sich für kleine files (syscalls pro file sind da das teure),
+// große werden gemappt wie immer - da kostet ein read in einen buffer nur eine kopie mehr
+constexpr uint64_t URING_READ_MAX = 1024 * 1024;
+
+void ImageProcessor::read_batch(const std::vector<PipelineJob*>& jobs, ioring::Ring& ring,
+                                const ProcessingOptions& options) {
+#if IORING_AVAILABLE
+    auto start = std::chrono::high_resolution_clock::now();
+    const size_t count = jobs.size();
+    struct File {
+        std::string path;
+        int fd = -1;
+        int open_res = 0;
+        int stat_res = 0;
+        int read_res = 0;
+        struct statx st;
+        bool reading = false;
+        unsigned inflight = 0;  // abgeschickte ops ohne cqe
+    };
+    // auf dem heap: bleibt bei kaputtem ring liegen, der kernel schreibt evtl. noch in st
+    auto owner = std::make_unique<std::vector<File>>(count);
+    std::vector<File>& files = *owner;
+    
+    // runde 1: open + statx für alle (user_data: file * 2 + op)
+    unsigned expected = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (ring.space() < 2) break;  // passt nicht mehr, die restlichen laufen unten über read()
+        files[i].path = jobs[i]->result.input_path.string();
+        io_uring_sqe* open_sqe = ring.next_sqe(i * 2);
+        io_uring_sqe* stat_sqe = ring.next_sqe(i * 2 + 1);
+        ioring::Ring::prep_openat(open_sqe, files[i].path.c_str(), O_RDONLY);
+        ioring::Ring::prep_statx(stat_sqe, files[i].path.c_str(), &files[i].st);
+        files[i].open_res = files[i].stat_res = -EAGAIN;
+        files[i].inflight = 2;
+        expected += 2;
+    }
+    bool ok = ring.complete(expected, [&](uint64_t user_data, int res) {
+        File& f = files[user_data / 2];
+        f.inflight--;
+        if (user_data % 2 == 0) {
+            f.open_res = res;
+            f.fd = res >= 0 ? res : -1;
+        } else {
+            f.stat_res = res;
+        }
+    });
+    
+    // runde 2: kleine files in einen fixed buffer (oder den pool) lesen, danach gleich
+    // close hinterher (hardlink: close läuft auch wenn der read kurz war)
+    expected = 0;
+    for (size_t i = 0; i < count && ok; ++i) {
+        File& f = files[i];
+        PipelineJob& job = *jobs[i];
+        if (f.fd < 0) continue;
+        // read + close immer als paar, sonst hängt ein gelinkter read am nächsten file
+        if (ring.space() < 2) break;
+        uint64_t size = f.stat_res == 0 ? f.st.stx_size : 0;
+        if (size > 0 && size <= URING_READ_MAX) {
+            if (size <= ring.buffer_size()) job.fixed = ring.acquire();
+            if (!job.fixed) job.buffer = bufpool::Buffer(static_cast<size_t>(size));
+        }
+        if (job.fixed || job.buffer) {
+            io_uring_sqe* read_sqe = ring.next_sqe(i * 2);
+            if (job.fixed) {
+                ioring::Ring::prep_read_fixed(read_sqe, f.fd, job.fixed, static_cast<unsigned>(size), 0);
+            } else {
+                ioring::Ring::prep_read(read_sqe, f.fd, job.buffer.data(), static_cast<unsigned>(size), 0);
+            }
+            ioring::Ring::link(read_sqe);
+            f.reading = true;
+            f.read_res = -EAGAIN;
+            f.inflight++;
+            expected++;
+        }
+        // der fd bleibt bis das close durch ist, sonst leckt er wenn es nie läuft
+        ioring::Ring::prep_close(ring.next_sqe(i * 2 + 1), f.fd);
+        f.inflight++;
+        expected++;
+    }
+    if (ok) {
+        ok = ring.complete(expected, [&](uint64_t user_data, int res) {
+            File& f = files[user_data / 2];
+            f.inflight--;
+            if (user_data % 2 == 0) {
+                f.read_res = res;
+            } else {
+                f.fd = -1;  // auch ein fehlgeschlagenes close gibt den fd frei
             }
+        });
+    }
+    
+    const double share = ms_between(start, std::chrono::high_resolution_clock::now()) / std::max<size_t>(count, 1);
+    bool abandoned = false;
+    for (size_t i = 0; i < count; ++i) {
+        File& f = files[i];
+        PipelineJob& job = *jobs[i];
+        if (f.inflight) {
+            // ring kaputt und der kernel ist mit dem file noch nicht durch: buffer und fd
+            // gehören weiter ihm. lieber liegen lassen als dass er in fremde bilder liest
+            // oder ein close den fd von wem anders trifft
+            if (job.fixed) new ioring::FixedBuffer(std::move(job.fixed));
+            if (job.buffer) new bufpool::Buffer(std::move(job.buffer));
+            f.fd = -1;
+            abandoned = true;
+        }
+        if (f.fd >= 0) ::close(f.fd);
+        uint64_t size = f.stat_res == 0 ? f.st.stx_size : 0;
+        if (ok && f.reading && f.read_res >= 0 && static_cast<uint64_t>(f.read_res) == size) {
+            job.buffered = static_cast<size_t>(size);
+            job.result.original_size = job.buffered;
+            classify_input(job, options);
+            job.result.read_ms = share;
+        } else {
+            // groß, leer, weg, kurz gelesen: der normale weg weiß was zu tun ist
+            job.release_input();
+            read(job, job.result.input_path, options);
+            job.result.read_ms += share;
         }
     }
+    if (abandoned) owner.release();
+#else
+    (void)ring;
+    for (PipelineJob* job : jobs) read(*job, job->result.input_path, options);
+#endif
+}
+
+void ImageProcessor::compute(PipelineJob& job, const std::filesystem::path& output_dir,
+                             const ProcessingOptions& run_options) {
+    if (job.done || job.copy) {
+        job.reservation.reset();  // kopieren braucht keine pixel buffer
+        return;
+    }
+    ProcessingOptions own;
+    const ProcessingOptions& options = job_options(job, run_options, own);
+    ProcessingResult& result = job.result;
+    const std::filesystem::path& input = result.input_path;
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    ThreadTimes times_start = thread_times();
+    auto finish = [&](std::chrono::high_resolution_clock::time_point decoded,
+                      std::chrono::high_resolution_clock::time_point transformed) {
+        auto end = std::chrono::high_resolution_clock::now();
+        result.decode_ms = ms_between(start, decoded);
+        result.transform_ms = ms_between(decoded, transformed);
+        result.encode_ms = ms_between(transformed, end);
+        ThreadTimes times_end = thread_times();
+        result.cpu_ms = times_end.cpu_ms - times_start.cpu_ms;
+        result.runqueue_ms = times_end.runqueue_ms - times_start.runqueue_ms;
+    };
+    
+    auto ext = input.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    bool is_png = (ext == ".png");
+    
+    // speicher für den ganzen job reservieren bevor dekodiert wird.
+    // budget voll -> warten bis andere jobs fertig sind, nicht abbrechen.
+    // in der pipeline hat das schon der reader gemacht (inklusive input bytes)
+    MemoryBudget::Reservation reservation = std::move(job.reservation);
+    const uint64_t input_reserved = reservation.held() ? job.input_size() : 0;
+    if (options.memory_budget && !reservation.held()) {
+        auto wait_start = std::chrono::high_resolution_clock::now();
+        reservation = options.memory_budget->reserve(
+            job_footprint(job.header, result.original_size, is_png, options));
+        // warten ist keine arbeit, sonst passt das kostenmodell nicht mehr
+        start += std::chrono::high_resolution_clock::now() - wait_start;
+    }
     
     // jetzt wirklich laden
-    auto image_opt = load_image(input);
+    auto image_opt = job.has_input()
+        ? decode_image(job.input_data(), job.input_size(), job.header)
+        : load_image(input);
+    // input wird ab hier nicht mehr gebraucht
+    job.release_input();
+    reservation.shrink(reservation.bytes() - std::min(reservation.bytes(), input_reserved));
     if (!image_opt) {
         result.success = false;
+        job.done = true;
         // Lock to safely read stbi_failure_reason() (global error string)
-        std::lock_guard<std::mutex> lock(stb_operations_mutex);
-        result.error_message = "Failed to decode image: " + std::string(stbi_failure_reason());
-        return result;
+        {
+            std::lock_guard<std::mutex> lock(stb_operations_mutex);
+            const char* reason = stbi_failure_reason();
+            result.error_message = "Failed to decode image: " + std::string(reason ? reason : "unknown");
+        }
+        auto now = std::chrono::high_resolution_clock::now();
+        finish(now, now);
+        return;
     }
     
     ImageData image = std::move(*image_opt);
-    
-    // resize wenn gewünscht
-    if (options.max_width > 0 || options.max_height > 0) {
-        int new_width = image.width;
-        int new_height = image.height;
-        
-        if (options.preserve_aspect) {
-            double ratio = static_cast<double>(image.width) / image.height;
-            
-            if (options.max_width > 0 && new_width > options.max_width) {
-                new_width = options.max_width;
-                new_height = static_cast<int>(new_width / ratio);
-            }
-            if (options.max_height > 0 && new_height > options.max_height) {
-                new_height = options.max_height;
-                new_width = static_cast<int>(new_height * ratio);
-            }
-        } else {
-            if (options.max_width > 0) new_width = options.max_width;
-            if (options.max_height > 0) new_height = options.max_height;
-        }
-        
-        if (new_width != image.width || new_height != image.height) {
-            image = resize(image, new_width, new_height);
-        }
-    }
+    auto decoded = std::chrono::high_resolution_clock::now();
     
     // output path bauen
     auto output_filename = input.filename();
@@ -451,10 +970,7 @@ ProcessingResult ImageProcessor::process(
     
     // auto format auswählen
     if (format == OutputFormat::AUTO) {
-        auto ext = input.extension().string();
-        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-        
-        if (ext == ".png") {
+        if (is_png) {
             format = OutputFormat::PNG;
         } else {
             // alles außer png wird jpeg, macht am meisten sinn
@@ -469,62 +985,300 @@ ProcessingResult ImageProcessor::process(
         format = OutputFormat::JPEG;
     }
     
-    result.output_path = output_dir / output_filename;
+    result.output_path = output_for(job, output_dir, output_filename);
     
+    // resize wenn gewünscht (maße nach exif drehung)
+    auto [new_width, new_height] = target_dimensions(image.oriented_width(), image.oriented_height(), options);
+    bool needs_resize = new_width != image.oriented_width() || new_height != image.oriented_height();
+    
+    // exif drehung: fastresize bzw. der eigene jpeg encoder lesen die quelle gedreht,
+    // dann gibts keinen extra pass und keinen extra buffer. alles andere (stbir,
+    // png, alpha) kann das nicht - da einmal vorher mit den simd kernels drehen
+    if (image.orientation != 1) {
+        bool fused = needs_resize
+            ? use_fast_resize(image.oriented(), new_width, new_height)
+            : (format == OutputFormat::JPEG && image.channels == 3 && !image.view().planar());
+        if (!fused) {
+            image = apply_orientation(image.view(), image.orientation);
+        }
+    }
+    
+    if (needs_resize) {
+        image = resize(image.oriented(), new_width, new_height);
+    }
+    auto transformed = std::chrono::high_resolution_clock::now();
+    
+    // nur in speicher kodieren, das file macht die write stufe (compute blockiert
+    // so nie auf writeback oder dem dateisystem)
+    if (!save_image(image.oriented(), result.output_path, job.encoded, format, options.quality, options.use_gpu)) {
+        job.encoded.reset();
+        result.success = false;
+        result.error_message = "Failed to save image";
+        job.done = true;
+    } else {
+        // compressed size für stats und ob write lieber das original nimmt
+        result.compressed_size = job.encoded.size;
+        // vom budget bleibt nur der output buffer bis er geschrieben ist
+        reservation.shrink(job.encoded.data.size());
+        job.reservation = std::move(reservation);
+    }
+    finish(decoded, transformed);
+}
+
+// O_DIRECT: ganze blöcke über einen aligned bounce buffer (pool blöcke sind nur
+// 64 byte aligned), der rest normal gepuffert hinten dran. geht O_DIRECT auf dem
+// fs nicht (tmpfs, fuse ...) wird einfach alles normal geschrieben
+constexpr size_t DIRECT_IO_CHUNK = 1 << 20;
+
+static bool write_direct(atomicfile::File& out, const uint8_t* data, size_t size) {
+    constexpr size_t align = atomicfile::File::DIRECT_ALIGN;
+    const size_t whole = size / align * align;
+    if (whole == 0 || !out.set_direct(true)) return out.write(data, size);
+    struct Bounce {
+        uint8_t* p = static_cast<uint8_t*>(::operator new(DIRECT_IO_CHUNK, std::align_val_t(align)));
+        ~Bounce() { ::operator delete(p, std::align_val_t(align)); }
+    };
+    thread_local Bounce bounce;
+    for (size_t off = 0; off < whole; off += DIRECT_IO_CHUNK) {
+        size_t n = std::min(DIRECT_IO_CHUNK, whole - off);
+        std::memcpy(bounce.p, data + off, n);
+        if (!out.write(bounce.p, n)) {
+            // EINVAL = fs mag kein O_DIRECT (oder andere alignment regeln), nochmal gepuffert
+            out.set_direct(false);
+            return out.rewind() && out.write(data, size);
+        }
+    }
+    out.set_direct(false);
+    return out.write(data + whole, size - whole);
+}
+
+// job.encoded in ein frisches output file (O_TMPFILE, noch ohne namen).
+// false = job ist kaputt, fehler steht im result
+static bool flush_output(PipelineJob& job, const ProcessingOptions& options) {
+    ProcessingResult& result = job.result;
     // ATOMIC WRITE FIX: Write to temp file, then rename on success
     // This prevents partial/corrupt output files on crash or disk-full
-    auto temp_path = result.output_path;
-    temp_path += ".tmp";
-    
-    if (!save_image(image, temp_path, format, options.quality, options.use_gpu)) {
+    // (linux: anonymes O_TMPFILE, write hängt es per linkat ein - siehe atomic_file.hpp)
+    if (!job.output.open(result.output_path.string())) {
+        result.success = false;
+        result.error_message = "Failed to create output file";
+        job.done = true;
+    } else if (!(options.direct_io ? write_direct(job.output, job.encoded.data.data(), job.encoded.size)
+                                   : job.output.write(job.encoded.data.data(), job.encoded.size))) {
         // Cleanup temp file on failure
-        std::error_code rm_ec;
-        std::filesystem::remove(temp_path, rm_ec);
+        std::error_code ec(errno, std::generic_category());
+        job.output.discard();
         result.success = false;
-        result.error_message = "Failed to save image";
-        return result;
+        result.error_message = "Failed to write output: " + ec.message();
+        job.done = true;
+    }
+    job.encoded.reset();
+    job.reservation.reset();
+    return !job.done;
+}
+
+// original unverändert als output: hardlink (--hardlink, gleiches fs), sonst in ein
+// frisches output file klonen/kopieren und das atomar einhängen.
+// --fsync: die kopie (bzw. beim hardlink nur das verzeichnis) geht an den group commit
+static atomicfile::CopyMethod keep_original(PipelineJob& job, const ProcessingOptions& options) {
+    const std::filesystem::path& input = job.result.input_path;
+    const std::filesystem::path& output = job.result.output_path;
+    std::error_code ec;
+    if (options.hardlink_unchanged && atomicfile::File::hardlink(input.string(), output.string(), ec)) {
+        if (options.group_commit) job.ticket = options.group_commit->stage(atomicfile::File(), output);
+        return atomicfile::CopyMethod::Hardlink;
+    }
+    atomicfile::File out;
+    if (!out.open(output.string())) {
+        throw std::filesystem::filesystem_error("cannot create output", output,
+                                                std::error_code(errno, std::generic_category()));
+    }
+    atomicfile::CopyMethod method = out.copy_from(input.string(), ec);
+    if (method == atomicfile::CopyMethod::None) {
+        throw std::filesystem::filesystem_error("cannot copy original", input, output, ec);
+    }
+    if (options.group_commit) {
+        job.ticket = options.group_commit->stage(std::move(out), output);
+    } else if (!out.publish(ec)) {
+        throw std::filesystem::filesystem_error("cannot copy original", input, output, ec);
+    }
+    return method;
+}
+
+void ImageProcessor::write(PipelineJob& job, const std::filesystem::path& output_dir,
+                           const ProcessingOptions& options) {
+    ProcessingResult& result = job.result;
+    auto start = std::chrono::high_resolution_clock::now();
+    auto total = [&] {
+        result.write_ms += ms_between(start, std::chrono::high_resolution_clock::now());
+        result.processing_time_ms = result.read_ms + result.compute_ms() + result.write_ms;
+    };
+    if (job.done) {
+        total();
+        return;
     }
     
-    // Atomically replace output with completed temp file
-    try {
-        std::filesystem::rename(temp_path, result.output_path);
-    } catch (const std::exception&) {
-        // rename failed (cross-device?), try copy+delete
-        try {
-            std::filesystem::copy_file(temp_path, result.output_path, std::filesystem::copy_options::overwrite_existing);
-            std::filesystem::remove(temp_path);
-        } catch (const std::exception& e) {
-            std::error_code rm_ec;
-            std::filesystem::remove(temp_path, rm_ec);
-            result.success = false;
-            result.error_message = std::string("Failed to finalize output: ") + e.what();
-            return result;
-        }
+    if (job.copy) {
+        result.output_path = output_for(job, output_dir, result.input_path.filename());
+        result.kept = keep_original(job, options);
+        result.compressed_size = result.original_size;
+        result.success = true;
+        total();
+        return;
     }
     
-    // compressed size für stats
-    try {
-        result.compressed_size = std::filesystem::file_size(result.output_path);
-    } catch (...) {
-        result.compressed_size = 0;
-    }
-
-    // wenn größer geworden einfach original kopieren, passiert bei manchen jpegs
-    if (result.compressed_size >= result.original_size) {
-        // FIX: Use atomic copy with overwrite to avoid TOCTOU race
-        std::filesystem::copy_file(
-            input, 
-            result.output_path,
-            std::filesystem::copy_options::overwrite_existing
-        );
+    // wenn größer geworden einfach original nehmen, passiert bei manchen jpegs.
+    // compute hat die größe schon, das kodierte wird gar nicht erst geschrieben
+    // (flush_batch/publish_batch lassen solche jobs liegen)
+    if (!job.published && result.compressed_size >= result.original_size) {
+        job.encoded.reset();
+        job.reservation.reset();
+        job.output.discard();
+        result.kept = keep_original(job, options);
         result.compressed_size = result.original_size;
+        result.success = true;
+        total();
+        return;
+    }
+    
+    // noch im speicher (kein ring, oder flush_batch hat es nicht geschafft)
+    if (!job.output.is_open() && !job.published && !flush_output(job, options)) {
+        total();
+        return;
+    }
+    
+    // Atomically replace output with completed temp file
+    // (publish_batch hat das evtl. schon erledigt, mit --fsync macht es der group commit)
+    if (options.group_commit) {
+        job.ticket = options.group_commit->stage(std::move(job.output), result.output_path);
+        result.success = true;
+        total();
+        return;
+    }
+    std::error_code ec;
+    if (!job.published && !job.output.publish(ec)) {
+        job.output.discard();
+        result.success = false;
+        result.error_message = "Failed to finalize output: " + ec.message();
+        total();
+        return;
     }
     
-    auto end = std::chrono::high_resolution_clock::now();
-    result.processing_time_ms = std::chrono::duration<double, std::milli>(end - start).count();
     result.success = true;
+    total();
+}
+
+void ImageProcessor::settle(PipelineJob& job, const ProcessingOptions& options) {
+    if (!job.ticket || !options.group_commit) return;
+    ProcessingResult& result = job.result;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::error_code ec = options.group_commit->wait(job.ticket);
+    job.ticket = 0;
+    if (ec) {
+        result.success = false;
+        result.error_message = "Failed to sync output: " + ec.message();
+    }
+    result.write_ms += ms_between(start, std::chrono::high_resolution_clock::now());
+    result.processing_time_ms = result.read_ms + result.compute_ms() + result.write_ms;
+}
+
+void ImageProcessor::flush_batch(const std::vector<PipelineJob*>& jobs, ioring::Ring& ring,
+                                 const ProcessingOptions& options) {
+#if IORING_AVAILABLE
+    // O_DIRECT braucht den bounce buffer, das macht write() einzeln
+    if (options.direct_io) return;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<int> res(jobs.size(), -EAGAIN);
+    unsigned expected = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        PipelineJob& job = *jobs[i];
+        if (job.done || job.copy || job.published || job.output.is_open() || job.encoded.size == 0) continue;
+        if (job.result.compressed_size >= job.result.original_size) continue;  // write() nimmt das original
+        if (job.encoded.size > (1u << 30) || ring.space() == 0) continue;
+        // anlegen ist ein normaler syscall (O_TMPFILE), nur die writes gehen gesammelt raus
+        if (!job.output.open(job.result.output_path.string())) continue;
+        ioring::Ring::prep_write(ring.next_sqe(i), job.output.fd(), job.encoded.data.data(),
+                                 static_cast<unsigned>(job.encoded.size), 0);
+        expected++;
+    }
+    if (expected == 0) return;
     
-    return result;
+    if (!ring.complete(expected, [&](uint64_t user_data, int n) { res[user_data] = n; })) {
+        // ring kaputt, nicht wissen was geschrieben ist: write() fängt die files neu an
+        for (PipelineJob* job : jobs) {
+            if (!job->published && job->encoded.size) job->output.discard();
+        }
+        return;
+    }
+    
+    const double share = ms_between(start, std::chrono::high_resolution_clock::now()) / expected;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        PipelineJob& job = *jobs[i];
+        if (!job.output.is_open() || job.encoded.size == 0) continue;
+        if (res[i] != static_cast<int>(job.encoded.size)) {
+            job.output.discard();  // kurz/fehler: write() schreibt nochmal normal
+            continue;
+        }
+        job.encoded.reset();
+        job.reservation.reset();
+        job.result.write_ms += share;
+    }
+#else
+    (void)jobs;
+    (void)ring;
+    (void)options;
+#endif
+}
+
+void ImageProcessor::publish_batch(const std::vector<PipelineJob*>& jobs, ioring::Ring& ring) {
+#if IORING_AVAILABLE
+    auto start = std::chrono::high_resolution_clock::now();
+    struct Publish {
+        std::string from, to;
+        int res = -EAGAIN;
+    };
+    std::vector<Publish> items(jobs.size());
+    unsigned expected = 0;
+    size_t batched = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        PipelineJob& job = *jobs[i];
+        if (job.done || job.copy || job.published || !job.output.is_open()) continue;
+        if (job.result.compressed_size >= job.result.original_size) continue;  // write() nimmt das original
+        // anonymes O_TMPFILE braucht linkat (5.15), sonst macht das write() einzeln
+        bool anonymous = job.output.anonymous();
+        if (anonymous && !ring.supports(IORING_OP_LINKAT)) continue;
+        items[i].from = anonymous ? atomicfile::File::proc_path(job.output.fd()) : job.output.temp_path();
+        items[i].to = job.result.output_path.string();
+        // die größe kennt compute schon, also nur noch linkat/rename.
+        // linkat ersetzt nix: EEXIST -> write() macht das über temp namen + rename
+        io_uring_sqe* sqe = ring.next_sqe(i);
+        if (!sqe) break;
+        if (anonymous) {
+            ioring::Ring::prep_linkat(sqe, items[i].from.c_str(), items[i].to.c_str(), AT_SYMLINK_FOLLOW);
+        } else {
+            ioring::Ring::prep_renameat(sqe, items[i].from.c_str(), items[i].to.c_str());
+        }
+        expected++;
+        batched++;
+    }
+    if (expected == 0) return;
+    
+    if (!ring.complete(expected, [&](uint64_t user_data, int res) { items[user_data].res = res; })) {
+        return;  // ring kaputt, write() macht alles wie gehabt
+    }
+    
+    const double share = ms_between(start, std::chrono::high_resolution_clock::now()) / batched;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        PipelineJob& job = *jobs[i];
+        if (items[i].res != 0) continue;  // z.b. EXDEV: write() kopiert dann
+        job.output.published();
+        job.published = true;
+        job.result.write_ms += share;
+    }
+#else
+    (void)jobs;
+    (void)ring;
+#endif
 }
 
 } // namespace squish
@@ -0,0 +1,97 @@
+#include "input_queue.hpp"
+#include "image_processor.hpp"
+#include <algorithm>
+
+namespace squish {
+
+// heap ordnung: teurer zuerst, gleich teure in der reihenfolge wie gefunden
+static bool runs_later(const InputQueue::Item& a, const InputQueue::Item& b) {
+    if (a.estimate->cost_ms != b.estimate->cost_ms) return a.estimate->cost_ms < b.estimate->cost_ms;
+    return a.index > b.index;
+}
+
+void InputQueue::push(const std::vector<Item>& items) {
+    if (items.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const Item& item : items) {
+            if (largest_first_) {
+                heap_.push_back(item);
+                std::push_heap(heap_.begin(), heap_.end(), runs_later);
+            } else {
+                fixed_.push_back(item);
+            }
+        }
+        pushed_ += items.size();
+    }
+    changed_.notify_all();
+}
+
+void InputQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    changed_.notify_all();
+}
+
+void InputQueue::interrupt() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        interrupted_ = true;
+    }
+    changed_.notify_all();
+}
+
+void InputQueue::fix_next() {
+    std::pop_heap(heap_.begin(), heap_.end(), runs_later);
+    fixed_.push_back(heap_.back());
+    heap_.pop_back();
+}
+
+bool InputQueue::take(Item& item, size_t& position) {
+    if (fixed_.empty()) {
+        if (heap_.empty()) return false;
+        fix_next();
+    }
+    item = fixed_.front();
+    fixed_.pop_front();
+    position = taken_++;
+    return true;
+}
+
+bool InputQueue::pop(Item& item, size_t& position) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!take(item, position)) {
+        if (closed_) return false;
+        changed_.wait(lock);
+    }
+    return true;
+}
+
+bool InputQueue::try_pop(Item& item, size_t& position) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return take(item, position);
+}
+
+bool InputQueue::peek(size_t& position, Item& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (interrupted_) return false;
+        position = std::max(position, taken_);
+        while (position - taken_ >= fixed_.size() && !heap_.empty()) fix_next();
+        if (position - taken_ < fixed_.size()) {
+            item = fixed_[position - taken_];
+            return true;
+        }
+        if (closed_) return false;
+        changed_.wait(lock);
+    }
+}
+
+size_t InputQueue::pushed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pushed_;
+}
+
+} // namespace squish
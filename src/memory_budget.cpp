@@ -0,0 +1,122 @@
+#include "memory_budget.hpp"
+#include "cgroup_limits.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace squish {
+
+MemoryBudget::MemoryBudget(uint64_t capacity) : capacity_(std::max<uint64_t>(capacity, 1)) {}
+
+MemoryBudget::Reservation& MemoryBudget::Reservation::operator=(Reservation&& other) noexcept {
+    if (this != &other) {
+        reset();
+        budget_ = other.budget_;
+        bytes_ = other.bytes_;
+        other.budget_ = nullptr;
+        other.bytes_ = 0;
+    }
+    return *this;
+}
+
+void MemoryBudget::Reservation::reset() {
+    if (budget_) budget_->release(bytes_);
+    budget_ = nullptr;
+    bytes_ = 0;
+}
+
+void MemoryBudget::Reservation::shrink(uint64_t bytes) {
+    if (!budget_ || bytes >= bytes_) return;
+    budget_->release(bytes_ - bytes);
+    bytes_ = bytes;
+}
+
+MemoryBudget::Reservation MemoryBudget::reserve(uint64_t bytes) {
+    bytes = std::min(bytes, capacity_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    const uint64_t ticket = next_ticket_++;
+    auto fits = [&] { return ticket == serving_ && bytes <= capacity_ - in_use_; };
+    if (!fits()) {
+        waits_++;
+        cv_.wait(lock, fits);
+    }
+    serving_++;
+    in_use_ += bytes;
+    peak_ = std::max(peak_, in_use_);
+    // der nächste in der schlange passt vielleicht auch noch rein
+    cv_.notify_all();
+    return Reservation(this, bytes);
+}
+
+bool MemoryBudget::try_reserve(uint64_t bytes, Reservation& out) {
+    bytes = std::min(bytes, capacity_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (next_ticket_ != serving_ || bytes > capacity_ - in_use_) return false;
+        in_use_ += bytes;
+        peak_ = std::max(peak_, in_use_);
+    }
+    out = Reservation(this, bytes);
+    return true;
+}
+
+void MemoryBudget::release(uint64_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_use_ -= bytes;
+    }
+    cv_.notify_all();
+}
+
+uint64_t MemoryBudget::in_use() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return in_use_;
+}
+
+uint64_t MemoryBudget::peak() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return peak_;
+}
+
+uint64_t MemoryBudget::waits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return waits_;
+}
+
+uint64_t MemoryBudget::system_available() {
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status)) return UNLIMITED;
+    return status.ullAvailPhys;
+#else
+    // Linux: parse /proc/meminfo MemAvailable
+    uint64_t bytes_available = UNLIMITED;
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+    while (meminfo && std::getline(meminfo, line)) {
+        if (line.find("MemAvailable:") == 0) {
+            size_t kb_available = 0;
+            if (sscanf(line.c_str(), "MemAvailable: %zu kB", &kb_available) == 1) {
+                bytes_available = static_cast<uint64_t>(kb_available) * 1024;
+            }
+            break;
+        }
+    }
+    // im container zählt memory.max - memory.current, nicht was der host noch frei hat
+    cgroup::MemoryLimits limits = cgroup::memory_limits();
+    if (limits.limited()) {
+        bytes_available = std::min(bytes_available, limits.available());
+    }
+    return bytes_available;
+#endif
+}
+
+} // namespace squish
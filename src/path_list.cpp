@@ -0,0 +1,58 @@
+#include "path_list.hpp"
+#include <cstring>
+
+namespace squish {
+
+// arena block in zeichen. ein name ist höchstens NAME_MAX (255) lang, passt immer rein
+constexpr size_t PATH_ARENA_BLOCK = 1 << 20;
+
+uint32_t PathList::intern_dir(const String& dir) {
+    if (last_dir_ != UINT32_MAX && *dirs_[last_dir_] == dir) return last_dir_;
+    auto [it, fresh] = dir_index_.try_emplace(dir, static_cast<uint32_t>(dirs_.size()));
+    if (fresh) dirs_.push_back(&it->first);
+    last_dir_ = it->second;
+    return last_dir_;
+}
+
+size_t PathList::add(const std::filesystem::path& file) {
+    const String& full = file.native();
+    String name = file.filename().native();
+    // verzeichnis inklusive trenner, dann ist path() nur noch zusammenkleben
+    String dir = full.substr(0, full.size() - name.size());
+
+    size_t length = name.size();
+    std::unique_lock lock(mutex_);
+    if (blocks_.empty() || block_used_ + length > PATH_ARENA_BLOCK) {
+        blocks_.push_back(std::make_unique<Char[]>(PATH_ARENA_BLOCK));
+        block_used_ = 0;
+    }
+    std::memcpy(blocks_.back().get() + block_used_, name.data(), length * sizeof(Char));
+
+    Entry e;
+    e.dir = intern_dir(dir);
+    e.block = static_cast<uint32_t>(blocks_.size() - 1);
+    e.offset = static_cast<uint32_t>(block_used_);
+    e.length = static_cast<uint32_t>(length);
+    entries_.push_back(e);
+    block_used_ += length;
+    return entries_.size() - 1;
+}
+
+std::filesystem::path PathList::path(size_t i) const {
+    std::shared_lock lock(mutex_);
+    const String& dir = *dirs_[entries_[i].dir];
+    auto n = name_locked(i);
+    String full;
+    full.reserve(dir.size() + n.size());
+    full.append(dir).append(n);
+    return std::filesystem::path(std::move(full));
+}
+
+size_t PathList::bytes() const {
+    std::shared_lock lock(mutex_);
+    size_t total = blocks_.size() * PATH_ARENA_BLOCK * sizeof(Char) + entries_.capacity() * sizeof(Entry);
+    for (const String* d : dirs_) total += d->size() * sizeof(Char) + sizeof(*d) + 2 * sizeof(void*);
+    return total;
+}
+
+} // namespace squish
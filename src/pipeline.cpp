@@ -0,0 +1,281 @@
+#include "pipeline.hpp"
+#include "prefetcher.hpp"
+#include "group_commit.hpp"
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <string>
+
+namespace squish {
+
+// io_uring: so viele files pro schub (zwei sqes pro file und runde), registrierte
+// buffer pro reader ring. thumbnails passen in einen fixed buffer, größere bis 1 MB
+// gehen in pool buffer, alles drüber wird gemappt
+constexpr size_t URING_BATCH = 16;
+constexpr unsigned URING_ENTRIES = 64;
+constexpr unsigned URING_BUFFERS = 32;
+constexpr size_t URING_BUFFER_SIZE = 128 * 1024;
+
+// eine stufe ist mit einer exception rausgeflogen (bad_alloc, copy_file ...):
+// nur dieses bild ist kaputt, es läuft trotzdem durch die restlichen stufen
+// damit die queues ihre zählung behalten
+static void fail(PipelineJob& job, std::exception_ptr error) {
+    try {
+        std::rethrow_exception(error);
+    } catch (const std::exception& e) {
+        job.result.error_message = e.what();
+    } catch (...) {
+        job.result.error_message = "unknown error";
+    }
+    job.result.success = false;
+    job.done = true;
+}
+
+Pipeline::Pipeline(ThreadPool& pool, size_t readers, size_t writers, size_t depth, bool io_uring)
+    : pool_(pool),
+      readers_(std::max<size_t>(readers, 1)),
+      writers_(std::max<size_t>(writers, 1)),
+      depth_(std::max<size_t>(depth, 1)),
+      io_uring_(io_uring),
+      to_compute_(depth_),
+      to_write_(depth_) {}
+
+Pipeline::~Pipeline() {
+    try {
+        wait();
+    } catch (...) {}
+}
+
+void Pipeline::start(const PathList& inputs, InputQueue& queue, const std::filesystem::path& output_dir,
+                     const ProcessingOptions& options, Done done) {
+    done_ = std::move(done);
+    joined_ = false;
+
+    // ein ring pro io thread. die fixed buffer der reader hängen noch an jobs in den
+    // queues wenn der reader schon fertig ist - deshalb gehören die ringe der pipeline
+    rings_.resize(readers_ + writers_);
+    for (size_t i = 0; io_uring_ && i < rings_.size(); ++i) {
+        auto ring = std::make_unique<ioring::Ring>();
+        if (!ring->init(URING_ENTRIES)) break;  // kein io_uring hier, dann für keinen
+        if (i < readers_) ring->register_buffers(URING_BUFFERS, URING_BUFFER_SIZE);
+        rings_[i] = std::move(ring);
+    }
+
+    read_.add(readers_);
+    threads_.reserve(readers_ + writers_);
+    for (size_t i = 0; i < readers_; ++i) {
+        ioring::Ring* ring = rings_[i].get();
+        threads_.emplace_back([this, &inputs, &queue, &output_dir, &options, ring] {
+            // wirft nur wenn nicht mal ein leerer job angelegt werden kann, dann ist noch
+            // kein item genommen. die anderen reader machen weiter, wait() wirft es
+            try {
+                read_loop(inputs, queue, output_dir, options, ring);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex_);
+                if (!read_error_) read_error_ = std::current_exception();
+            }
+            read_.count_down();
+        });
+    }
+    for (size_t i = 0; i < writers_; ++i) {
+        ioring::Ring* ring = rings_[readers_ + i].get();
+        threads_.emplace_back([this, &output_dir, &options, ring] { write_loop(output_dir, options, done_, ring); });
+    }
+}
+
+size_t Pipeline::rings() const noexcept {
+    return static_cast<size_t>(std::count_if(rings_.begin(), rings_.end(), [](const auto& r) { return r != nullptr; }));
+}
+
+uint64_t Pipeline::uring_submits() const noexcept {
+    uint64_t total = 0;
+    for (const auto& ring : rings_) {
+        if (ring) total += ring->submits();
+    }
+    return total;
+}
+
+void Pipeline::hand_off(JobPtr job, const std::filesystem::path& output_dir, const ProcessingOptions& options) {
+    if (queued_.fetch_add(1, std::memory_order_relaxed) == 0) starved_.fetch_add(1, std::memory_order_relaxed);
+    to_compute_.push(std::move(job));  // voll -> warten bis compute nachkommt
+    // der task holt sich irgendein gelesenes bild, es liegt schon mindestens eins drin.
+    // exceptions bleiben beim bild, sonst fehlt es dem writer
+    pool_.enqueue_bulk(0, 1, 1, [this, &output_dir, &options](size_t, size_t) {
+        JobPtr job = to_compute_.pop();
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        try {
+            ImageProcessor processor;
+            processor.compute(*job, output_dir, options);
+        } catch (...) {
+            fail(*job, std::current_exception());
+        }
+        to_write_.push(std::move(job));
+    }, computed_);
+}
+
+void Pipeline::read_loop(const PathList& inputs, InputQueue& queue, const std::filesystem::path& output_dir,
+                         const ProcessingOptions& options, ioring::Ring* ring) {
+    // schub nicht größer als die queue, sonst liest ein reader weit über das limit vor
+    const size_t batch = ring ? std::min(URING_BATCH, depth_) : 1;
+    std::vector<JobPtr> jobs;
+    std::vector<PipelineJob*> raw;
+    jobs.reserve(batch);
+    raw.reserve(batch);
+    InputQueue::Item item;
+    size_t k;
+    bool held = false;  // item ist noch vom letzten schub übrig (budget war voll)
+    // job wird vor dem pop angelegt: was aus der queue genommen ist hat immer einen job,
+    // der bis zum writer kommt - sonst fehlt das bild im ergebnis und written_ stimmt nicht
+    JobPtr spare;
+    while (true) {
+        jobs.clear();
+        raw.clear();
+        if (!spare) spare = std::make_unique<PipelineJob>();  // held -> spare ist noch da
+        if (!held && !queue.pop(item, k)) return;  // blockiert bis der scan was liefert
+        held = false;
+        while (true) {
+            JobPtr job = std::move(spare);
+            job->index = item.index;
+            job->estimate = item.estimate;
+            try {
+                // budget vor dem lesen: input + was compute braucht. warten nur solange wir
+                // noch nix halten - wer schon reservierte jobs in der hand hat und blockiert,
+                // wartet evtl. auf sich selber. dann eben das nächste im nächsten schub
+                if (options.memory_budget) {
+                    uint64_t need = item.estimate->memory_bytes + item.estimate->file_size;
+                    if (jobs.empty()) {
+                        job->reservation = options.memory_budget->reserve(need);
+                    } else if (!options.memory_budget->try_reserve(need, job->reservation)) {
+                        spare = std::move(job);
+                        held = true;
+                        break;
+                    }
+                }
+                if (options.prefetcher) options.prefetcher->claim(k);
+                job->overrides = inputs.overrides(job->index);
+                job->result.input_path = inputs.path(job->index);
+            } catch (...) {
+                fail(*job, std::current_exception());
+            }
+            written_.add(1);
+            if (!job->done) raw.push_back(job.get());
+            jobs.push_back(std::move(job));
+            if (jobs.size() >= batch) break;
+            // kein platz für den nächsten job: erst mal abgeben was da ist
+            try {
+                spare = std::make_unique<PipelineJob>();
+            } catch (...) {
+                break;
+            }
+            if (!queue.try_pop(item, k)) break;
+        }
+        try {
+            if (ring && ring->ok()) {
+                ImageProcessor::read_batch(raw, *ring, options);
+                uring_files_.fetch_add(raw.size(), std::memory_order_relaxed);
+            } else {
+                // ohne ring (oder ring unterwegs kaputt gegangen) einzeln
+                for (PipelineJob* job : raw) ImageProcessor::read(*job, job->result.input_path, options);
+            }
+        } catch (...) {
+            for (PipelineJob* job : raw) fail(*job, std::current_exception());
+        }
+        for (auto& job : jobs) hand_off(std::move(job), output_dir, options);
+    }
+}
+
+void Pipeline::write_loop(const std::filesystem::path& output_dir, const ProcessingOptions& options, const Done& done,
+                          ioring::Ring* ring) {
+    std::vector<JobPtr> jobs;
+    std::vector<PipelineJob*> raw;
+    std::deque<JobPtr> staged;  // --fsync: beim group commit abgegeben, noch nicht durch
+    auto finish = [&](JobPtr& j) {
+        ImageProcessor::settle(*j, options);
+        done(j->index, *j->estimate, std::move(j->result));
+        written_.count_down();
+    };
+    auto settle_front = [&] {
+        finish(staged.front());
+        staged.pop_front();
+    };
+    bool stop = false;
+    while (!stop) {
+        // einen blockierend holen, dann mitnehmen was sonst schon fertig rumliegt.
+        // nullptr = ende, danach nix mehr nehmen (die anderen sind für die anderen writer).
+        // hängen noch abgegebene jobs: nicht an der queue warten sondern auf den ältesten
+        // commit, was solange reinkommt geht in die nächste gruppe
+        jobs.clear();
+        raw.clear();
+        JobPtr job;
+        if (staged.empty()) {
+            job = to_write_.pop();
+        } else if (!to_write_.try_pop(job)) {
+            settle_front();
+            continue;
+        }
+        while (true) {
+            if (!job) {
+                stop = true;
+                break;
+            }
+            raw.push_back(job.get());
+            jobs.push_back(std::move(job));
+            if (!ring || jobs.size() >= URING_BATCH || !to_write_.try_pop(job)) break;
+        }
+        // kodierte bilder in einem submit raus, dann die namen drauf.
+        // mit --fsync hängt der group commit ein, erst nach dem sync
+        if (ring && ring->ok() && !raw.empty()) {
+            try {
+                ImageProcessor::flush_batch(raw, *ring, options);
+                if (!options.group_commit) ImageProcessor::publish_batch(raw, *ring);
+            } catch (...) {
+                // egal, write() macht dann writes und renames selber
+            }
+        }
+        for (auto& j : jobs) {
+            try {
+                ImageProcessor::write(*j, output_dir, options);
+            } catch (...) {
+                fail(*j, std::current_exception());
+            }
+            if (j->ticket) {
+                staged.push_back(std::move(j));
+            } else {
+                finish(j);
+            }
+        }
+        // schon committete vorne abholen, warten nur wenn zu viele hängen
+        while (!staged.empty() &&
+               (staged.size() > depth_ || options.group_commit->committed(staged.front()->ticket))) {
+            settle_front();
+        }
+    }
+    while (!staged.empty()) settle_front();
+}
+
+bool Pipeline::wait_for(std::chrono::milliseconds timeout) {
+    // written_ ist zwischendurch auch mal 0, fertig erst wenn kein reader mehr nachlegt
+    return read_.wait_for(timeout) && written_.wait_for(timeout);
+}
+
+void Pipeline::wait() {
+    if (joined_) return;
+    joined_ = true;
+    // reader hören auf sobald die queue zu und leer ist, danach kommt kein compute mehr dazu
+    for (size_t i = 0; i < readers_; ++i) threads_[i].join();
+    std::exception_ptr error = read_error_;
+    try {
+        pool_.wait(computed_);
+    } catch (...) {
+        if (!error) error = std::current_exception();
+    }
+    // alles ist durch compute durch, writer bekommen je ein ende-zeichen hinten dran
+    for (size_t i = 0; i < writers_; ++i) to_write_.push(nullptr);
+    for (auto& t : threads_) {
+        if (t.joinable()) t.join();
+    }
+    threads_.clear();
+    if (error) std::rethrow_exception(error);
+}
+
+} // namespace squish
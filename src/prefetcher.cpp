@@ -0,0 +1,119 @@
+#include "prefetcher.hpp"
+#include "image_processor.hpp"
+#include "mmap_file.hpp"
+#include <algorithm>
+
+namespace squish {
+
+// auch bei winzigen files nicht tausende opens vorauslaufen
+constexpr size_t PREFETCH_MAX_FILES = 256;
+
+Prefetcher::Prefetcher(const PathList& inputs, InputQueue& queue, uint64_t budget)
+    : inputs_(inputs), queue_(queue), budget_(budget) {}
+
+Prefetcher::~Prefetcher() {
+    stop();
+}
+
+void Prefetcher::start() {
+    if (thread_.joinable()) return;
+    thread_ = std::thread([this] { run(); });
+}
+
+void Prefetcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    changed_.notify_all();
+    queue_.interrupt();
+    if (thread_.joinable()) thread_.join();
+}
+
+Prefetcher::Slot& Prefetcher::slot(size_t k) {
+    if (k - base_ >= slots_.size()) slots_.resize(k - base_ + 1);
+    return slots_[k - base_];
+}
+
+void Prefetcher::claim(size_t k) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (k < base_) return;
+        Slot& s = slot(k);
+        if (s.state == ISSUED) issued_ahead_++;
+        else not_ahead_++;
+        if (s.state == WARMING || s.state == ISSUED) {
+            ahead_bytes_ -= s.size;
+            ahead_files_--;
+        }
+        s.state = CLAIMED;
+        front_ = std::max(front_, k + 1);
+        while (!slots_.empty() && slots_.front().state == CLAIMED) {
+            slots_.pop_front();
+            base_++;
+        }
+    }
+    changed_.notify_one();
+}
+
+void Prefetcher::run() {
+    size_t next = 0;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) return;
+            next = std::max(next, front_);
+        }
+        // was an next kommt, legt die reihenfolge bis dahin fest. wartet solange der
+        // scan noch nix geliefert hat, false = alles durch oder stop
+        InputQueue::Item item;
+        if (!queue_.peek(next, item)) return;
+        const size_t k = next++;
+        uint64_t size = item.estimate->file_size;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // warten bis es ins budget passt. eine einzelne datei größer als das budget
+            // darf trotzdem wenn sonst nix vorgeholt ist. wer es inzwischen schon liest
+            // braucht es nicht mehr
+            bool warm = false;
+            while (!stop_ && k >= base_ && slot(k).state == QUEUED) {
+                if (ahead_files_ == 0 || (ahead_bytes_ + size <= budget_ && ahead_files_ < PREFETCH_MAX_FILES)) {
+                    warm = true;
+                    break;
+                }
+                changed_.wait(lock);
+            }
+            if (stop_) return;
+            if (!warm) continue;
+            Slot& s = slot(k);
+            s.state = WARMING;
+            s.size = size;
+            ahead_bytes_ += size;
+            ahead_files_++;
+            bytes_ += size;
+        }
+        // der syscall selber außerhalb vom lock, claim soll nie auf io warten
+        mmapfile::prefetch(inputs_.path(item.index).string().c_str(), static_cast<size_t>(size));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (k >= base_ && slot(k).state == WARMING) slot(k).state = ISSUED;
+        }
+    }
+}
+
+uint64_t Prefetcher::issued_ahead() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return issued_ahead_;
+}
+
+uint64_t Prefetcher::not_ahead() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return not_ahead_;
+}
+
+uint64_t Prefetcher::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+} // namespace squish
@@ -1,54 +1,269 @@
 #include "thread_pool.hpp"
+#include "buffer_pool.hpp"
+#include "cgroup_limits.hpp"
+#include "cpu_topology.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define SQUISH_CPU_RELAX() _mm_pause()
+#else
+#define SQUISH_CPU_RELAX() std::this_thread::yield()
+#endif
 
 namespace squish {
 
-ThreadPool::ThreadPool(size_t num_threads) {
-    // hardware_concurrency als default, 4 wenn das fehlschlägt
+// so oft schaut ein worker nochmal nach arbeit bevor er sich schlafen legt
+// (~ein paar µs, kürzer als ein futex wake + context switch)
+constexpr int SPIN_ROUNDS = 64;
+constexpr int PAUSES_PER_ROUND = 16;
+// so lange nix zu tun -> gecachte buffer ans system zurück, sonst hält jeder
+// schlafende worker seine blöcke bis zum ende vom lauf
+constexpr auto IDLE_TRIM_AFTER = std::chrono::milliseconds(50);
+
+// in welchem pool/worker läuft der aktuelle thread - subtasks gehen dann in die eigene deque
+static thread_local ThreadPool* tls_pool = nullptr;
+static thread_local size_t tls_worker = 0;
+static thread_local int tls_depth = 0;  // wie tief in wait() verschachtelt
+
+// ============================================================================
+// Latch
+// ============================================================================
+
+// runterzählen unter dem mutex: wer ready() sieht und danach wait() ruft,
+// kommt erst rein wenn count_down fertig ist -> latch darf dann weg (steht oft auf dem stack)
+void Latch::count_down(size_t n) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_.fetch_sub(n, std::memory_order_acq_rel) == n) {
+        cv_.notify_all();
+    }
+}
+
+void Latch::set_error(std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) error_ = std::move(error);
+}
+
+void Latch::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return ready(); });
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+bool Latch::wait_for(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, timeout, [this] { return ready(); });
+}
+
+namespace detail {
+
+// ============================================================================
+// RangeJob
+// ============================================================================
+
+bool RangeJob::work() {
+    try {
+        while (true) {
+            // worker wurde abgeschaltet (set_active): zwischen zwei stücken aufhören,
+            // der rest geht als neuer helfer an die aktiven worker. verschachtelte jobs
+            // (bänder eines bildes) laufen fertig, die sind eh gleich durch
+            if (!nested && next.load(std::memory_order_relaxed) < end && worker_switched_off()) return false;
+            size_t lo = next.fetch_add(grain, std::memory_order_relaxed);
+            if (lo >= end) break;
+            run_range(lo, std::min(lo + grain, end));
+        }
+    } catch (...) {
+        latch->set_error(std::current_exception());
+        next.store(end, std::memory_order_relaxed);  // rest abbrechen
+    }
+    return true;
+}
+
+void RangeTask::run() {
+    if (job->work()) {
+        job->release();
+    } else {
+        requeue(job);
+    }
+}
+
+// nur auf oberster ebene: wer in wait() an den bändern seines bildes hängt, macht die fertig
+bool worker_switched_off() {
+    return tls_pool && tls_depth == 0 && tls_worker >= tls_pool->active();
+}
+
+void requeue(RangeJob* job) {
+    tls_pool->submit_injected(new RangeTask(job));
+}
+
+void RangeJob::release() {
+    if (helpers.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        Latch* l = latch;
+        delete this;
+        l->count_down();
+    }
+}
+
+// ============================================================================
+// WorkDeque
+// ============================================================================
+
+WorkDeque::WorkDeque() {
+    rings_.emplace_back(std::make_unique<Ring>(1024));
+    ring_.store(rings_.back().get(), std::memory_order_relaxed);
+}
+
+WorkDeque::~WorkDeque() = default;
+
+WorkDeque::Ring* WorkDeque::grow(Ring* old, int64_t bottom, int64_t top) {
+    auto bigger = std::make_unique<Ring>(old->capacity * 2);
+    for (int64_t i = top; i < bottom; i++) {
+        bigger->put(i, old->get(i));
+    }
+    Ring* r = bigger.get();
+    rings_.push_back(std::move(bigger));
+    ring_.store(r, std::memory_order_release);
+    return r;
+}
+
+void WorkDeque::push(Task* task) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    Ring* r = ring_.load(std::memory_order_relaxed);
+    if (b - t > r->capacity - 1) {
+        r = grow(r, b, t);
+    }
+    r->put(b, task);
+    // release store statt fence + relaxed: gleich teuer auf x86, und tsan versteht es
+    bottom_.store(b + 1, std::memory_order_release);
+}
+
+Task* WorkDeque::pop() {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Ring* r = ring_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // leer
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Task* task = r->get(b);
+    if (t == b) {
+        // letztes element - gegen thieves um top rennen
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            task = nullptr;
+        }
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+Task* WorkDeque::steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+
+    Ring* r = ring_.load(std::memory_order_acquire);
+    Task* task = r->get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;  // anderer thief (oder der besitzer) war schneller
+    }
+    return task;
+}
+
+// ============================================================================
+// InjectionQueue
+// ============================================================================
+
+void InjectionQueue::push(Task* task) {
+    count_.fetch_add(1, std::memory_order_relaxed);
+    task->next.store(nullptr, std::memory_order_relaxed);
+    Task* prev = head_.exchange(task, std::memory_order_acq_rel);
+    prev->next.store(task, std::memory_order_release);
+}
+
+Task* InjectionQueue::try_pop() {
+    if (consumer_lock_.test_and_set(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    Task* task = pop_locked();
+    consumer_lock_.clear(std::memory_order_release);
+    if (task) count_.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+Task* InjectionQueue::pop_locked() {
+    Task* tail = tail_;
+    Task* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+        if (!next) return nullptr;
+        tail_ = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        tail_ = next;
+        return tail;
+    }
+    // tail ist das letzte element. producer noch mitten im push -> später nochmal
+    if (tail != head_.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    // stub wieder hinten dran damit tail ausgehängt werden kann
+    push(&stub_);
+    count_.fetch_sub(1, std::memory_order_relaxed);  // stub zählt nicht
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        tail_ = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+bool InjectionQueue::empty() const {
+    return count_.load(std::memory_order_relaxed) <= 0;
+}
+
+} // namespace detail
+
+// ============================================================================
+// ThreadPool
+// ============================================================================
+
+ThreadPool::ThreadPool(size_t num_threads, std::vector<int> pin_cpus) : pin_cpus_(std::move(pin_cpus)) {
+    // default: cpus die der prozess wirklich hat (affinity/cgroup), 4 wenn das fehlschlägt
     if (num_threads == 0) {
-        num_threads = std::thread::hardware_concurrency();
-        if (num_threads == 0) num_threads = 4;  // fallback
+        num_threads = cgroup::cpu_limits().effective;
+    }
+
+    active_.store(num_threads, std::memory_order_relaxed);
+
+    // deques zuerst komplett anlegen, worker klauen ab dem ersten moment bei allen
+    queues_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+        queues_.push_back(std::make_unique<Worker>());
     }
 
     workers_.reserve(num_threads);
     for (size_t i = 0; i < num_threads; ++i) {
-        workers_.emplace_back([this] {
-            while (true) {
-                std::function<void()> task;
-                
-                {
-                    std::unique_lock<std::mutex> lock(queue_mutex_);
-                    condition_.wait(lock, [this] {
-                        return stop_ || !tasks_.empty();
-                    });
-                    
-                    if (stop_ && tasks_.empty()) {
-                        return;
-                    }
-                    
-                    task = std::move(tasks_.front());
-                    tasks_.pop();
-                }
-                
-                task();
-                
-                // FIX: Decrement pending_tasks_ inside lock to prevent race with wait_all()
-                {
-                    std::lock_guard<std::mutex> lock(queue_mutex_);
-                    pending_tasks_--;
-                }
-                done_condition_.notify_all();
-            }
-        });
+        workers_.emplace_back([this, i] { worker_loop(i); });
     }
 }
 
 ThreadPool::~ThreadPool() {
+    stop_.store(true);
     {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        stop_ = true;
+        std::lock_guard<std::mutex> lock(park_mutex_);
+        epoch_.fetch_add(1);
     }
-    condition_.notify_all();
-    
+    park_cv_.notify_all();
+    inactive_cv_.notify_all();
+
     for (std::thread& worker : workers_) {
         if (worker.joinable()) {
             worker.join();
@@ -56,14 +271,202 @@ ThreadPool::~ThreadPool() {
     }
 }
 
+// an allen deques vorbei in die injection queue, damit ihn ein aktiver worker nimmt
+void ThreadPool::submit_injected(detail::Task* task) {
+    pending_tasks_.fetch_add(1);
+    injection_.push(task);
+    wake_one();
+}
+
+void ThreadPool::submit(detail::Task* task) {
+    pending_tasks_.fetch_add(1);
+    if (tls_pool == this) {
+        // aus einem worker heraus: eigene deque, andere können klauen
+        queues_[tls_worker]->deque.push(task);
+    } else {
+        injection_.push(task);
+    }
+    wake_one();
+}
+
+// ein helfer pro worker reicht, mehr als stücke da sind braucht es nicht
+void ThreadPool::submit_range(detail::RangeJob* job) {
+    size_t chunks = (job->end - job->next.load(std::memory_order_relaxed) + job->grain - 1) / job->grain;
+    size_t helpers = std::max<size_t>(1, std::min(chunks, queues_.size()));
+    job->helpers.store(helpers, std::memory_order_relaxed);
+    for (size_t i = 0; i < helpers; i++) {
+        submit(new detail::RangeTask(job));
+    }
+}
+
+void ThreadPool::set_active(size_t n) {
+    n = std::clamp<size_t>(n, 1, workers_.size());
+    {
+        std::lock_guard<std::mutex> lock(park_mutex_);
+        active_.store(n, std::memory_order_relaxed);
+    }
+    inactive_cv_.notify_all();
+}
+
+ThreadPool* ThreadPool::current() noexcept {
+    return tls_pool;
+}
+
+detail::Task* ThreadPool::find_task(size_t index, uint64_t& rng, bool take_injected) {
+    if (detail::Task* task = queues_[index]->deque.pop()) return task;
+    if (take_injected) {
+        if (detail::Task* task = injection_.try_pop()) return task;
+    }
+
+    // zufälliges opfer, dann reihum
+    const size_t n = queues_.size();
+    if (n > 1) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        size_t start = static_cast<size_t>(rng % n);
+        for (size_t k = 0; k < n; k++) {
+            size_t victim = (start + k) % n;
+            if (victim == index) continue;
+            if (detail::Task* task = queues_[victim]->deque.steal()) {
+                steals_.fetch_add(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+    }
+    return nullptr;
+}
+
+bool ThreadPool::has_work() const {
+    if (!injection_.empty()) return true;
+    for (const auto& q : queues_) {
+        if (!q->deque.empty()) return true;
+    }
+    return false;
+}
+
+// eventcount: epoch merken, als schläfer eintragen, NOCHMAL nach arbeit schauen,
+// erst dann warten. submit zählt epoch hoch bevor es auf schläfer schaut -> kein lost wakeup
+void ThreadPool::park() {
+    uint64_t epoch = epoch_.load(std::memory_order_acquire);
+    sleepers_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (has_work() || stop_.load()) {
+        sleepers_.fetch_sub(1);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(park_mutex_);
+    auto woken = [this, epoch] {
+        return epoch_.load(std::memory_order_acquire) != epoch || stop_.load();
+    };
+    if (!park_cv_.wait_for(lock, IDLE_TRIM_AFTER, woken)) {
+        lock.unlock();
+        bufpool::trim_thread_cache();
+        lock.lock();
+        park_cv_.wait(lock, woken);
+    }
+    sleepers_.fetch_sub(1);
+}
+
+void ThreadPool::wake_one() {
+    epoch_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load() > 0) {
+        std::lock_guard<std::mutex> lock(park_mutex_);
+        park_cv_.notify_one();
+    }
+}
+
+// ohne lock zählen, nur der letzte task weckt wait_all
+void ThreadPool::finish_task() {
+    if (pending_tasks_.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(done_mutex_);
+        done_condition_.notify_all();
+    }
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    tls_pool = this;
+    tls_worker = index;
+    if (!pin_cpus_.empty() && cputopo::pin_current_thread(pin_cpus_[index % pin_cpus_.size()])) {
+        pinned_.fetch_add(1, std::memory_order_relaxed);
+    }
+    uint64_t rng = 0x9E3779B97F4A7C15ull * (index + 1);
+
+    while (true) {
+        // abgeschaltet: schlafen bis der controller uns wieder will. die eigene deque ist
+        // hier leer, subtasks sind alle fertig bevor der task zurückkommt
+        if (index >= active_.load(std::memory_order_relaxed)) {
+            // evtl. hat uns grad das wake_one für neue arbeit aus park() geholt: weitergeben,
+            // sonst schläft der aktive worker weiter und keiner fasst sie an
+            if (has_work()) wake_one();
+            bufpool::trim_thread_cache();  // kann länger dauern bis wir wieder dran sind
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            inactive_cv_.wait(lock, [this, index] {
+                return index < active_.load(std::memory_order_relaxed) || stop_.load();
+            });
+            if (index >= active_.load(std::memory_order_relaxed)) return;  // stop
+            continue;
+        }
+
+        detail::Task* task = find_task(index, rng);
+
+        // kurz spinnen bevor wir schlafen gehen
+        for (int round = 0; !task && round < SPIN_ROUNDS; round++) {
+            for (int i = 0; i < PAUSES_PER_ROUND; i++) SQUISH_CPU_RELAX();
+            if (has_work()) task = find_task(index, rng);
+        }
+
+        if (!task) {
+            if (stop_.load() && !has_work()) {
+                return;
+            }
+            park();
+            continue;
+        }
+
+        task->run();
+        delete task;
+        finish_task();
+    }
+}
+
+void ThreadPool::wait(Latch& latch) {
+    if (tls_pool != this) {
+        latch.wait();
+        return;
+    }
+    // im worker nicht blockieren: sonst liegen die helfer evtl. in unserer eigenen deque
+    // und keiner macht sie. also selber mitarbeiten (erst die eigenen, dann klauen).
+    // nur subtasks aus den deques, keine neuen bilder aus der injection queue - sonst
+    // hängt das fast fertige bild an einem ganz anderen job der grad dazwischen kam
+    uint64_t rng = 0xD1B54A32D192ED03ull * (tls_worker + 1);
+    int idle = 0;
+    tls_depth++;
+    struct DepthGuard { ~DepthGuard() { tls_depth--; } } depth_guard;
+    while (!latch.ready()) {
+        if (detail::Task* task = find_task(tls_worker, rng, false)) {
+            task->run();
+            delete task;
+            finish_task();
+            idle = 0;
+        } else if (++idle < SPIN_ROUNDS) {
+            for (int i = 0; i < PAUSES_PER_ROUND; i++) SQUISH_CPU_RELAX();
+        } else {
+            std::this_thread::yield();  // andere worker sind noch an unseren stücken dran
+        }
+    }
+    latch.wait();  // sync mit count_down + exception weiterwerfen
+}
+
 void ThreadPool::wait_all() {
-    std::unique_lock<std::mutex> lock(queue_mutex_);
+    std::unique_lock<std::mutex> lock(done_mutex_);
     // DEADLOCK FIX: Add 5-minute timeout to prevent infinite hang on OOM/slow I/O
     auto timeout = std::chrono::minutes(5);
     bool completed = done_condition_.wait_for(lock, timeout, [this] {
         return pending_tasks_ == 0;
     });
-    
+
     if (!completed) {
         // Timeout occurred - likely deadlock from memory pressure or slow disk I/O
         throw std::runtime_error(
@@ -108,5 +108,103 @@ else
     exit 1
 fi
 
+pass() { echo -e "${GREEN}PASS${NC}"; }
+fail() { echo -e "${RED}FAIL ($1)${NC}"; exit 1; }
+
+# batch zum vergleichen: 64x64 bmp (wird jpeg), png und jpeg, unter mehreren namen
+{
+    printf 'BM\x36\x30\x00\x00\x00\x00\x00\x00\x36\x00\x00\x00'
+    printf '\x28\x00\x00\x00\x40\x00\x00\x00\x40\x00\x00\x00\x01\x00\x18\x00'
+    printf '\x00\x00\x00\x00\x00\x30\x00\x00\x13\x0b\x00\x00\x13\x0b\x00\x00'
+    printf '\x00\x00\x00\x00\x00\x00\x00\x00'
+    for i in $(seq 1 4096); do
+        printf '\x20\x80\xe0'
+    done
+} > "$TEMP_DIR/test.bmp"
+$SQUISH "$TEMP_DIR/test.bmp" -o "$TEMP_DIR/seed" >/dev/null 2>&1 || fail "seed jpeg"
+mkdir -p "$TEMP_DIR/batch/sub"
+for n in 1 2 3 4; do
+    cp "$TEMP_DIR/test.bmp" "$TEMP_DIR/batch/b$n.bmp"
+    cp "$TEMP_DIR/test.png" "$TEMP_DIR/batch/sub/p$n.png"
+    cp "$TEMP_DIR/seed/test.jpg" "$TEMP_DIR/batch/j$n.jpg"
+done
+count_outputs() { find "$1" -type f | wc -l; }
+$SQUISH "$TEMP_DIR/batch" -o "$TEMP_DIR/ref" >/dev/null 2>&1 || fail "reference run"
+
+# Test 8: --files-from list parsing
+echo -n "Test 8: --files-from (tabs, CRLF, bad lines) ... "
+B="$TEMP_DIR/batch"
+printf '%s\n' "$B/b1.bmp" > "$TEMP_DIR/list.txt"
+printf '%s\r\n' "$B/b2.bmp" >> "$TEMP_DIR/list.txt"
+printf '%s\tnamed/p.png\t-w 1 -q 50\n' "$B/sub/p1.png" >> "$TEMP_DIR/list.txt"
+printf '%s\t\t-q 40\n' "$B/j1.jpg" >> "$TEMP_DIR/list.txt"
+printf '%s\t%s\n' "$B/j2.jpg" "$TEMP_DIR/abs/j2.jpeg" >> "$TEMP_DIR/list.txt"
+printf '%s\t../escape.jpg\n' "$B/j3.jpg" >> "$TEMP_DIR/list.txt"
+printf '%s\t\t-q abc\n' "$B/j4.jpg" >> "$TEMP_DIR/list.txt"
+printf '%s\tnamed/p2.jpg\n' "$B/sub/p2.png" >> "$TEMP_DIR/list.txt"
+printf '%s\n' "$B/missing.bmp" >> "$TEMP_DIR/list.txt"
+$SQUISH --files-from "$TEMP_DIR/list.txt" -o "$TEMP_DIR/list" >/dev/null 2>"$TEMP_DIR/list.err" || true
+[ -f "$TEMP_DIR/list/b1.jpg" ] || fail "plain line"
+[ -f "$TEMP_DIR/list/b2.jpg" ] || fail "CRLF line"
+[ -f "$TEMP_DIR/list/named/p.png" ] || fail "own output"
+[ -f "$TEMP_DIR/list/j1.jpg" ] || fail "options only"
+[ -f "$TEMP_DIR/abs/j2.jpeg" ] || fail "absolute output"
+[ ! -e "$TEMP_DIR/escape.jpg" ] || fail "'..' escaped -o"
+[ ! -e "$TEMP_DIR/list/j4.jpg" ] || fail "bad options not skipped"
+[ ! -e "$TEMP_DIR/list/named/p2.jpg" ] || fail "format mismatch not skipped"
+[ "$(grep -c '^Warning' "$TEMP_DIR/list.err")" = 3 ] || fail "expected 3 warnings"
+grep -q "missing.bmp" "$TEMP_DIR/list.err" || fail "missing file not reported"
+[ "$(count_outputs "$TEMP_DIR/list")" = 4 ] || fail "output count"
+pass
+
+# Test 9: --files-from - with -0
+echo -n "Test 9: --files-from - -0 ... "
+find "$TEMP_DIR/batch" -type f -print0 | $SQUISH --files-from - -0 -o "$TEMP_DIR/nul" >/dev/null 2>&1 || fail "exit code"
+for f in b1.jpg b4.jpg p3.png j2.jpg; do
+    [ -f "$TEMP_DIR/nul/$f" ] || fail "no $f"
+done
+pass
+
+# Test 10: --order
+echo -n "Test 10: --order stream/cost/inode/disk ... "
+[ "$(count_outputs "$TEMP_DIR/ref")" = 12 ] || fail "reference output count"
+for order in stream cost inode disk; do
+    $SQUISH "$TEMP_DIR/batch" -o "$TEMP_DIR/order_$order" --order $order >/dev/null 2>&1 || fail "$order exit code"
+    diff -r "$TEMP_DIR/ref" "$TEMP_DIR/order_$order" >/dev/null || fail "$order outputs differ"
+done
+if $SQUISH "$TEMP_DIR/batch" -o "$TEMP_DIR/order_bad" --order sideways >/dev/null 2>&1; then
+    fail "bad order accepted"
+fi
+pass
+
+# Test 11: --fsync / --syncfs
+echo -n "Test 11: --fsync / --syncfs ... "
+$SQUISH "$TEMP_DIR/batch" -o "$TEMP_DIR/fsync" --fsync >/dev/null 2>&1 || fail "--fsync exit code"
+diff -r "$TEMP_DIR/ref" "$TEMP_DIR/fsync" >/dev/null || fail "--fsync outputs differ"
+$SQUISH "$TEMP_DIR/batch" -o "$TEMP_DIR/syncfs" --syncfs >/dev/null 2>&1 || fail "--syncfs exit code"
+diff -r "$TEMP_DIR/ref" "$TEMP_DIR/syncfs" >/dev/null || fail "--syncfs outputs differ"
+pass
+
+# Test 12: --io-threads 0 (worker machen io selber)
+echo -n "Test 12: --io-threads 0 ... "
+$SQUISH "$TEMP_DIR/batch" -o "$TEMP_DIR/noio" --io-threads 0 >/dev/null 2>&1 || fail "exit code"
+diff -r "$TEMP_DIR/ref" "$TEMP_DIR/noio" >/dev/null || fail "outputs differ"
+pass
+
+# Test 13: --max-memory (winzig: jobs laufen einzeln durch, nix hängt)
+echo -n "Test 13: --max-memory ... "
+$SQUISH "$TEMP_DIR/batch" -o "$TEMP_DIR/mem" --max-memory 1M --threads 4 >/dev/null 2>&1 || fail "exit code"
+diff -r "$TEMP_DIR/ref" "$TEMP_DIR/mem" >/dev/null || fail "outputs differ"
+if $SQUISH "$TEMP_DIR/batch" -o "$TEMP_DIR/mem_bad" --max-memory lots >/dev/null 2>&1; then
+    fail "bad size accepted"
+fi
+pass
+
+# Test 14: --direct-io (fällt zurück wo das fs kein O_DIRECT kann)
+echo -n "Test 14: --direct-io ... "
+$SQUISH "$TEMP_DIR/batch" -o "$TEMP_DIR/direct" --direct-io >/dev/null 2>&1 || fail "exit code"
+diff -r "$TEMP_DIR/ref" "$TEMP_DIR/direct" >/dev/null || fail "outputs differ"
+pass
+
 echo ""
 echo -e "${GREEN}All tests passed!${NC}"
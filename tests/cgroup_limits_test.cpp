@@ -0,0 +1,156 @@
+// cgroup parser: cpu listen, cpu.max, u64/max dateien und wie der cgroup pfad unter
+// den mountpoint gehängt wird. echte cgroups braucht das nicht, dateien kommen in ein
+// temp verzeichnis
+#include "cgroup_limits.hpp"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using namespace cgroup;
+
+static int cpu_lists() {
+    struct Case { const char* list; unsigned expected; };
+    const Case cases[] = {
+        {"0-3,8,10-11", 7},
+        {"0", 1},
+        {"0-63", 64},
+        {"1,3,5", 3},
+        {"0,,2", 2},      // leere teile zählen nicht
+        {"", 0},
+        {"5-2", 0},       // rückwärts = nix
+        {"0-3,x", 0},     // kaputt = gar nix, nicht halb
+        {"-1", 0},
+    };
+    int failed = 0;
+    for (const Case& c : cases) {
+        unsigned n = detail::count_cpu_list(c.list);
+        if (n != c.expected) {
+            std::fprintf(stderr, "FAIL: count_cpu_list(\"%s\") = %u, erwartet %u\n", c.list, n, c.expected);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+static int cpu_max() {
+    struct Case { const char* line; bool ok; double cpus; };
+    const Case cases[] = {
+        {"max 100000", false, 0},
+        {"200000 100000", true, 2.0},
+        {"150000 100000\n", true, 1.5},
+        {"50000 100000", true, 0.5},
+        {"100000 0", false, 0},
+        {"100000", false, 0},
+        {"abc 100000", false, 0},
+        {"", false, 0},
+    };
+    int failed = 0;
+    for (const Case& c : cases) {
+        double cpus = 0;
+        bool ok = detail::parse_cpu_max(c.line, cpus);
+        if (ok != c.ok || (ok && std::fabs(cpus - c.cpus) > 1e-9)) {
+            std::fprintf(stderr, "FAIL: parse_cpu_max(\"%s\") = %d/%.3f, erwartet %d/%.3f\n", c.line, ok, cpus,
+                         c.ok, c.cpus);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+static int u64_files(const fs::path& dir) {
+    struct Case { const char* content; bool ok; uint64_t value; };
+    const Case cases[] = {
+        {"max\n", true, UNLIMITED},
+        {"max 100000\n", true, UNLIMITED},
+        {"536870912\n", true, 536870912ull},
+        {"9223372036854771712", true, 9223372036854771712ull},  // v1 "kein limit"
+        {"abc\n", false, 0},
+        {"", false, 0},
+    };
+    int failed = 0;
+    for (const Case& c : cases) {
+        fs::path file = dir / "value";
+        std::ofstream(file) << c.content;
+        uint64_t v = 0;
+        bool ok = detail::read_u64(file.string(), v);
+        if (ok != c.ok || (ok && v != c.value)) {
+            std::fprintf(stderr, "FAIL: read_u64(\"%s\") = %d/%llu\n", c.content, ok,
+                         static_cast<unsigned long long>(v));
+            failed++;
+        }
+    }
+    uint64_t v = 0;
+    if (detail::read_u64((dir / "missing").string(), v)) {
+        std::fprintf(stderr, "FAIL: read_u64 auf fehlende datei\n");
+        failed++;
+    }
+
+    std::ofstream(dir / "memory.stat") << "anon 4096\nfile 8192\ninactive_file 12288\nactive_file 0\n";
+    uint64_t stat = 0;
+    if (!detail::read_stat((dir / "memory.stat").string(), "inactive_file", stat) || stat != 12288) {
+        std::fprintf(stderr, "FAIL: read_stat inactive_file = %llu\n", static_cast<unsigned long long>(stat));
+        failed++;
+    }
+    if (detail::read_stat((dir / "memory.stat").string(), "total_inactive_file", stat)) {
+        std::fprintf(stderr, "FAIL: read_stat findet key der nicht drin ist\n");
+        failed++;
+    }
+    return failed;
+}
+
+static int join(const fs::path& dir) {
+    // mountpoint mit einer verschachtelten cgroup die es wirklich gibt
+    const std::string mount = (dir / "cgroup").string();
+    fs::create_directories(mount + "/kubepods/pod1/ctr");
+    fs::create_directories(mount + "/pod1/ctr");
+    std::ofstream(mount + "/cgroup.procs");
+    std::ofstream(mount + "/kubepods/pod1/cgroup.procs");
+    std::ofstream(mount + "/kubepods/pod1/ctr/cgroup.procs");
+    std::ofstream(mount + "/pod1/ctr/cgroup.procs");
+
+    struct Case { const char* name; const char* root; const char* path; std::string expected; };
+    const Case cases[] = {
+        {"namespace wurzel", "/", "/", mount},
+        {"eigene cgroup", "/", "/kubepods/pod1/ctr", mount + "/kubepods/pod1/ctr"},
+        // ohne cgroup namespace: host pfad, den gibt's unter dem mount nicht
+        {"host pfad ohne namespace", "/", "/system.slice/docker-0123abcd.scope", mount},
+        // v1 bind mount: mount root ist schon der container pfad
+        {"bind mount root", "/kubepods/pod1", "/kubepods/pod1", mount},
+        {"bind mount unter root", "/kubepods", "/kubepods/pod1/ctr", mount + "/pod1/ctr"},
+        {"bind mount fremder pfad", "/kubepods", "/other/ctr", mount},
+    };
+    int failed = 0;
+    for (const Case& c : cases) {
+        std::string got = detail::join_cgroup(c.root, mount, c.path);
+        if (got != c.expected) {
+            std::fprintf(stderr, "FAIL: join_cgroup %s: %s, erwartet %s\n", c.name, got.c_str(), c.expected.c_str());
+            failed++;
+        }
+    }
+    return failed;
+}
+
+int main() {
+    std::string tmpl = (fs::temp_directory_path() / "cgroup_test.XXXXXX").string();
+    if (!mkdtemp(tmpl.data())) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    const fs::path dir = tmpl;
+
+    int failed = 0;
+    failed += cpu_lists();
+    failed += cpu_max();
+    failed += u64_files(dir);
+    failed += join(dir);
+
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    if (failed) return 1;
+    std::printf("cgroup_limits_test: ok\n");
+    return 0;
+}
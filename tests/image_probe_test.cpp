@@ -0,0 +1,203 @@
+// header probe: pro format ein paar gültige header und was abgeschnitten/unbekannt ist.
+// gültig muss dieselben maße/kanäle liefern wie stbi_info, alles andere Unknown
+// (dann schaut stbi selber) - und nie über len hinaus lesen
+#include "image_probe.hpp"
+#include <cstdio>
+#include <initializer_list>
+#include <vector>
+
+using namespace imgprobe;
+
+using Bytes = std::vector<uint8_t>;
+
+static void put_be16(Bytes& b, unsigned v) { b.insert(b.end(), {uint8_t(v >> 8), uint8_t(v)}); }
+static void put_le16(Bytes& b, unsigned v) { b.insert(b.end(), {uint8_t(v), uint8_t(v >> 8)}); }
+static void put_be32(Bytes& b, uint32_t v) {
+    b.insert(b.end(), {uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v)});
+}
+static void put_le32(Bytes& b, uint32_t v) {
+    b.insert(b.end(), {uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24)});
+}
+static Bytes cat(std::initializer_list<Bytes> parts) {
+    Bytes out;
+    for (const Bytes& p : parts) out.insert(out.end(), p.begin(), p.end());
+    return out;
+}
+static Bytes cut(Bytes b, size_t n) {
+    b.resize(n);
+    return b;
+}
+
+// ---- jpeg ----
+
+static const Bytes SOI = {0xFF, 0xD8};
+static const Bytes SOS = {0xFF, 0xDA, 0x00, 0x02};
+
+static Bytes segment(uint8_t marker, const Bytes& payload) {
+    Bytes b = {0xFF, marker};
+    put_be16(b, static_cast<unsigned>(payload.size() + 2));
+    b.insert(b.end(), payload.begin(), payload.end());
+    return b;
+}
+static Bytes app0() { return segment(0xE0, {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0}); }
+static Bytes sof(uint8_t marker, unsigned w, unsigned h, uint8_t comps) {
+    Bytes p = {8};
+    put_be16(p, h);
+    put_be16(p, w);
+    p.push_back(comps);
+    for (uint8_t c = 0; c < comps; ++c) p.insert(p.end(), {uint8_t(c + 1), 0x11, 0});
+    return segment(marker, p);
+}
+// APP1 mit genau einem IFD eintrag: orientation
+static Bytes app1_exif(uint16_t orientation) {
+    Bytes p = {'E', 'x', 'i', 'f', 0, 0, 'M', 'M', 0, 0x2A};
+    put_be32(p, 8);
+    put_be16(p, 1);
+    put_be16(p, 0x0112);
+    put_be16(p, 3);
+    put_be32(p, 1);
+    put_be16(p, orientation);
+    put_be16(p, 0);
+    put_be32(p, 0);
+    return segment(0xE1, p);
+}
+
+// ---- png ----
+
+static Bytes chunk(const char* type, const Bytes& data) {
+    Bytes b;
+    put_be32(b, static_cast<uint32_t>(data.size()));
+    b.insert(b.end(), type, type + 4);
+    b.insert(b.end(), data.begin(), data.end());
+    put_be32(b, 0);  // crc liest die probe nicht
+    return b;
+}
+static Bytes png(uint32_t w, uint32_t h, uint8_t color, std::initializer_list<Bytes> after = {}) {
+    Bytes b = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    Bytes ihdr;
+    put_be32(ihdr, w);
+    put_be32(ihdr, h);
+    ihdr.insert(ihdr.end(), {8, color, 0, 0, 0});
+    b = cat({b, chunk("IHDR", ihdr)});
+    for (const Bytes& c : after) b = cat({b, c});
+    return b;
+}
+
+// ---- gif / bmp / tga ----
+
+static Bytes gif(unsigned w, unsigned h) {
+    Bytes b = {'G', 'I', 'F', '8', '9', 'a'};
+    put_le16(b, w);
+    put_le16(b, h);
+    b.insert(b.end(), {0, 0, 0});
+    return b;
+}
+static Bytes bmp(int32_t w, int32_t h, unsigned bpp, uint32_t compress = 0, uint32_t header = 40) {
+    Bytes b = {'B', 'M'};
+    put_le32(b, 0);
+    put_le32(b, 0);
+    put_le32(b, 14 + header);
+    put_le32(b, header);
+    if (header == 12) {
+        put_le16(b, static_cast<unsigned>(w));
+        put_le16(b, static_cast<unsigned>(h));
+        put_le16(b, 1);
+        put_le16(b, bpp);
+        return b;
+    }
+    put_le32(b, static_cast<uint32_t>(w));
+    put_le32(b, static_cast<uint32_t>(h));
+    put_le16(b, 1);
+    put_le16(b, bpp);
+    put_le32(b, compress);
+    b.resize(14 + header, 0);
+    return b;
+}
+static Bytes tga(uint8_t colormap, uint8_t type, unsigned w, unsigned h, uint8_t bits, uint8_t colormap_bits = 0) {
+    Bytes b = {0, colormap, type, 0, 0, 0, 0, colormap_bits, 0, 0, 0, 0};
+    put_le16(b, w);
+    put_le16(b, h);
+    b.insert(b.end(), {bits, 0});
+    return b;
+}
+
+struct Case {
+    const char* name;
+    Bytes bytes;
+    Format format;  // Unknown = probe soll aufgeben (maße dann alle 0)
+    int width, height, channels;
+    int orientation = 1;
+};
+
+int main() {
+    const Bytes baseline = cat({SOI, app0(), sof(0xC0, 512, 256, 3), SOS});
+    const Case cases[] = {
+        // jpeg: SOF varianten die stbi kann, und die es nicht kann
+        {"jpeg baseline", baseline, Format::JPEG, 512, 256, 3},
+        {"jpeg extended grey", cat({SOI, sof(0xC1, 64, 48, 1), SOS}), Format::JPEG, 64, 48, 1},
+        {"jpeg progressive cmyk", cat({SOI, sof(0xC2, 10, 20, 4), SOS}), Format::JPEG, 10, 20, 3},
+        {"jpeg dht before sof", cat({SOI, segment(0xC4, Bytes(20, 0)), sof(0xC0, 8, 8, 3)}), Format::JPEG, 8, 8, 3},
+        {"jpeg fill bytes", cat({SOI, {0xFF, 0xFF}, sof(0xC0, 8, 8, 3)}), Format::JPEG, 8, 8, 3},
+        {"jpeg exif orientation", cat({SOI, app1_exif(6), sof(0xC0, 40, 30, 3), SOS}), Format::JPEG, 40, 30, 3, 6},
+        {"jpeg lossless sof3", cat({SOI, sof(0xC3, 8, 8, 3), SOS}), Format::Unknown, 0, 0, 0},
+        {"jpeg arithmetic sof9", cat({SOI, sof(0xC9, 8, 8, 3), SOS}), Format::Unknown, 0, 0, 0},
+        {"jpeg two components", cat({SOI, sof(0xC0, 8, 8, 2), SOS}), Format::Unknown, 0, 0, 0},
+        {"jpeg sos before sof", cat({SOI, app0(), SOS, sof(0xC0, 8, 8, 3)}), Format::Unknown, 0, 0, 0},
+        {"jpeg sof too short", cat({SOI, segment(0xC0, {8, 0, 8, 0})}), Format::Unknown, 0, 0, 0},
+        {"jpeg segment length 0", cat({SOI, {0xFF, 0xE0, 0x00, 0x00}, sof(0xC0, 8, 8, 3)}), Format::Unknown, 0, 0, 0},
+        {"jpeg truncated app0", cut(cat({SOI, app0()}), 10), Format::Unknown, 0, 0, 0},
+        {"jpeg truncated sof", cut(baseline, 2 + app0().size() + 8), Format::Unknown, 0, 0, 0},
+        {"jpeg soi only", {0xFF, 0xD8, 0xFF, 0xD9}, Format::Unknown, 0, 0, 0},
+        // png: kanäle nach farbtyp, palette hängt an tRNS vor IDAT
+        {"png rgb", png(300, 200, 2, {chunk("IDAT", {})}), Format::PNG, 300, 200, 3},
+        {"png rgba", png(1, 1, 6), Format::PNG, 1, 1, 4},
+        {"png grey", png(7, 9, 0), Format::PNG, 7, 9, 1},
+        {"png grey alpha", png(7, 9, 4), Format::PNG, 7, 9, 2},
+        {"png palette trns", png(5, 5, 3, {chunk("PLTE", Bytes(6, 0)), chunk("tRNS", {0}), chunk("IDAT", {})}),
+         Format::PNG, 5, 5, 4},
+        {"png palette opaque", png(5, 5, 3, {chunk("PLTE", Bytes(6, 0)), chunk("IDAT", {})}), Format::PNG, 5, 5, 3},
+        {"png palette truncated", cut(png(5, 5, 3, {chunk("PLTE", Bytes(30, 0))}), 50), Format::Unknown, 0, 0, 0},
+        {"png bad color type", png(5, 5, 5), Format::Unknown, 0, 0, 0},
+        {"png zero width", png(0, 5, 2), Format::Unknown, 0, 0, 0},
+        {"png truncated ihdr", cut(png(5, 5, 2), 30), Format::Unknown, 0, 0, 0},
+        // gif ist immer rgba
+        {"gif", gif(320, 240), Format::GIF, 320, 240, 4},
+        {"gif truncated", cut(gif(320, 240), 9), Format::Unknown, 0, 0, 0},
+        // bmp: header größen, alpha aus bpp, top-down, komprimiert
+        {"bmp 24 bit", bmp(64, 32, 24), Format::BMP, 64, 32, 3},
+        {"bmp 32 bit", bmp(64, 32, 32), Format::BMP, 64, 32, 4},
+        {"bmp top-down", bmp(64, -32, 24), Format::BMP, 64, 32, 3},
+        {"bmp os/2 header", bmp(16, 8, 24, 0, 12), Format::BMP, 16, 8, 3},
+        {"bmp v5 header", bmp(16, 8, 24, 0, 124), Format::BMP, 16, 8, 3},
+        {"bmp rle", bmp(16, 8, 8, 1), Format::Unknown, 0, 0, 0},
+        {"bmp bitfields 24 bit", bmp(16, 8, 24, 3), Format::Unknown, 0, 0, 0},
+        {"bmp bad header size", bmp(16, 8, 24, 0, 20), Format::Unknown, 0, 0, 0},
+        {"bmp truncated header", cut(bmp(16, 8, 24), 40), Format::Unknown, 0, 0, 0},
+        // tga: keine magic, nur plausibel oder nicht
+        {"tga truecolor", tga(0, 2, 100, 50, 24), Format::TGA, 100, 50, 3},
+        {"tga rle rgba", tga(0, 10, 100, 50, 32), Format::TGA, 100, 50, 4},
+        {"tga grey", tga(0, 3, 8, 8, 8), Format::TGA, 8, 8, 1},
+        {"tga colormapped", tga(1, 1, 8, 8, 8, 24), Format::TGA, 8, 8, 3},
+        {"tga bad image type", tga(0, 5, 8, 8, 24), Format::Unknown, 0, 0, 0},
+        {"tga zero height", tga(0, 2, 8, 0, 24), Format::Unknown, 0, 0, 0},
+        {"tga truncated", cut(tga(0, 2, 8, 8, 24), 17), Format::Unknown, 0, 0, 0},
+        {"too short", {0xFF, 0xD8}, Format::Unknown, 0, 0, 0},
+    };
+
+    int failed = 0;
+    for (const Case& c : cases) {
+        // eigene kopie genau in der länge, dann fällt ein lesen dahinter unter asan auf
+        std::vector<uint8_t> buf(c.bytes);
+        Header h = probe(buf.data(), buf.size());
+        if (h.format != c.format || h.width != c.width || h.height != c.height || h.channels != c.channels ||
+            h.orientation != c.orientation) {
+            std::fprintf(stderr, "FAIL: %s: format %d %dx%d ch %d orient %d, erwartet format %d %dx%d ch %d orient %d\n",
+                         c.name, static_cast<int>(h.format), h.width, h.height, h.channels, h.orientation,
+                         static_cast<int>(c.format), c.width, c.height, c.channels, c.orientation);
+            failed++;
+        }
+    }
+    if (failed) return 1;
+    std::printf("image_probe_test: ok (%zu cases)\n", sizeof(cases) / sizeof(cases[0]));
+    return 0;
+}
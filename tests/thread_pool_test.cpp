@@ -0,0 +1,88 @@
+// thread pool: set_active(1) während ein verschachteltes parallel_for helfer an
+// andere worker verloren hat. die helfer dürfen nicht in der injection queue landen,
+// der wartende worker holt da nix raus -> würde für immer hängen.
+// und ein bulk job den ein worker nur abschickt bleibt abschaltbar
+#include "thread_pool.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace squish;
+using namespace std::chrono_literals;
+
+static int nested_helpers_survive_switch_off() {
+    constexpr size_t WORKERS = 4;
+    constexpr size_t CHUNKS = 64;
+    ThreadPool pool(WORKERS);
+
+    // erst nur worker 0, dann landet der äußere task sicher dort
+    pool.set_active(1);
+    std::this_thread::sleep_for(50ms);
+
+    std::atomic<size_t> done{0};
+    auto outer = pool.enqueue([&] {
+        pool.set_active(WORKERS);  // die anderen wachen auf und klauen helfer aus unserer deque
+        pool.parallel_for(0, CHUNKS, 1, [&](size_t lo, size_t hi) {
+            if (lo == CHUNKS / 8) pool.set_active(1);
+            std::this_thread::sleep_for(1ms);
+            done.fetch_add(hi - lo);
+        });
+    });
+
+    if (outer.wait_for(10s) != std::future_status::ready) {
+        std::fprintf(stderr, "FAIL: nested parallel_for hängt nach set_active(1) (%zu/%zu)\n", done.load(), CHUNKS);
+        std::fflush(stderr);
+        std::_Exit(1);  // pool kann nicht mehr sauber runter
+    }
+    outer.get();
+    if (done.load() != CHUNKS) {
+        std::fprintf(stderr, "FAIL: %zu von %zu stücken gelaufen\n", done.load(), CHUNKS);
+        return 1;
+    }
+    return 0;
+}
+
+// enqueue_bulk aus einem worker ohne wait() (z.b. jobs die nach dem proben losgehen):
+// die helfer dürfen abgeschaltet werden, der rest muss trotzdem durchlaufen
+static int worker_bulk_survives_switch_off() {
+    constexpr size_t WORKERS = 4;
+    constexpr size_t CHUNKS = 64;
+    ThreadPool pool(WORKERS);
+    pool.set_active(1);
+    std::this_thread::sleep_for(50ms);
+
+    std::atomic<size_t> done{0};
+    Latch latch;
+    auto outer = pool.enqueue([&] {
+        pool.set_active(WORKERS);
+        pool.enqueue_bulk(0, CHUNKS, 1, [&](size_t lo, size_t hi) {
+            if (lo == CHUNKS / 8) pool.set_active(1);
+            std::this_thread::sleep_for(1ms);
+            done.fetch_add(hi - lo);
+        }, latch);
+    });
+    outer.get();
+
+    if (!latch.wait_for(10s)) {
+        std::fprintf(stderr, "FAIL: bulk job aus dem worker hängt nach set_active(1) (%zu/%zu)\n", done.load(), CHUNKS);
+        std::fflush(stderr);
+        std::_Exit(1);
+    }
+    if (done.load() != CHUNKS) {
+        std::fprintf(stderr, "FAIL: %zu von %zu stücken gelaufen\n", done.load(), CHUNKS);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    int failed = 0;
+    for (int round = 0; round < 20; round++) {
+        failed += nested_helpers_survive_switch_off();
+        failed += worker_bulk_survives_switch_off();
+    }
+    if (failed) return 1;
+    std::printf("thread_pool_test: ok\n");
+    return 0;
+}